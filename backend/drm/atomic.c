@@ -1,5 +1,7 @@
 #include <gbm.h>
+#include <inttypes.h>
 #include <stdlib.h>
+#include <wlr/types/wlr_box.h>
 #include <wlr/util/log.h>
 #include <xf86drm.h>
 #include <xf86drmMode.h>
@@ -28,14 +30,17 @@ static void atomic_begin(struct wlr_drm_crtc *crtc, struct atomic *atom) {
 	atom->failed = false;
 }
 
-static bool atomic_end(int drm_fd, struct atomic *atom) {
+/**
+ * Checks whether the kernel accepts the new changes, and rolls them back if it
+ * doesn't. On success they are kept for the next commit.
+ */
+static bool atomic_test(int drm_fd, struct atomic *atom) {
 	if (atom->failed) {
 		return false;
 	}
 
 	uint32_t flags = DRM_MODE_ATOMIC_TEST_ONLY | DRM_MODE_ATOMIC_NONBLOCK;
 	if (drmModeAtomicCommit(drm_fd, atom->req, flags, NULL)) {
-		wlr_log_errno(L_ERROR, "Atomic test failed");
 		drmModeAtomicSetCursor(atom->req, atom->cursor);
 		return false;
 	}
@@ -43,6 +48,17 @@ static bool atomic_end(int drm_fd, struct atomic *atom) {
 	return true;
 }
 
+static bool atomic_end(int drm_fd, struct atomic *atom) {
+	if (!atomic_test(drm_fd, atom)) {
+		if (!atom->failed) {
+			wlr_log_errno(L_ERROR, "Atomic test failed");
+		}
+		return false;
+	}
+
+	return true;
+}
+
 static bool atomic_commit(int drm_fd, struct atomic *atom,
 		struct wlr_drm_connector *conn, uint32_t flags, bool modeset) {
 	if (atom->failed) {
@@ -173,6 +189,51 @@ static bool atomic_crtc_set_cursor(struct wlr_drm_backend *drm,
 	return atomic_end(drm->fd, &atom);
 }
 
+static bool atomic_crtc_set_overlay(struct wlr_drm_backend *drm,
+		struct wlr_drm_crtc *crtc, struct gbm_bo *bo,
+		const struct wlr_box *box) {
+	struct wlr_drm_plane *plane = crtc->overlay;
+	if (!plane || plane->id == 0) {
+		return bo == NULL;
+	}
+
+	struct atomic atom;
+	atomic_begin(crtc, &atom);
+
+	uint32_t id = plane->id;
+	const union wlr_drm_plane_props *props = &plane->props;
+	if (bo) {
+		uint32_t fb_id = get_fb_for_bo(bo);
+		if (!fb_id) {
+			return false;
+		}
+
+		atomic_add(&atom, id, props->src_x, 0);
+		atomic_add(&atom, id, props->src_y, 0);
+		atomic_add(&atom, id, props->src_w, gbm_bo_get_width(bo) << 16);
+		atomic_add(&atom, id, props->src_h, gbm_bo_get_height(bo) << 16);
+		atomic_add(&atom, id, props->crtc_x, box->x);
+		atomic_add(&atom, id, props->crtc_y, box->y);
+		atomic_add(&atom, id, props->crtc_w, box->width);
+		atomic_add(&atom, id, props->crtc_h, box->height);
+		atomic_add(&atom, id, props->fb_id, fb_id);
+		atomic_add(&atom, id, props->crtc_id, crtc->id);
+	} else {
+		atomic_add(&atom, id, props->fb_id, 0);
+		atomic_add(&atom, id, props->crtc_id, 0);
+	}
+
+	// Formats, scaling and positions supported by the plane are up to the
+	// driver: failing the test is expected, and not an error. Disabling the
+	// plane should always pass though.
+	if (!atomic_test(drm->fd, &atom)) {
+		wlr_log_errno(bo ? L_DEBUG : L_ERROR, "Overlay plane %"PRIu32
+			" %s by the driver", id, bo ? "rejected" : "can't be disabled");
+		return false;
+	}
+	return true;
+}
+
 bool legacy_crtc_move_cursor(struct wlr_drm_backend *drm,
 		struct wlr_drm_crtc *crtc, int x, int y);
 
@@ -250,6 +311,7 @@ const struct wlr_drm_interface atomic_iface = {
 	.conn_enable = atomic_conn_enable,
 	.crtc_pageflip = atomic_crtc_pageflip,
 	.crtc_set_cursor = atomic_crtc_set_cursor,
+	.crtc_set_overlay = atomic_crtc_set_overlay,
 	.crtc_move_cursor = atomic_crtc_move_cursor,
 	.crtc_set_gamma = atomic_crtc_set_gamma,
 	.crtc_get_gamma_size = atomic_crtc_get_gamma_size,
@@ -137,6 +137,7 @@ struct wlr_backend *wlr_drm_backend_create(struct wl_display *display,
 
 	drm->session = session;
 	wl_list_init(&drm->outputs);
+	wl_list_init(&drm->client_buffers);
 
 	drm->fd = gpu_fd;
 	drm->parent = (struct wlr_drm_backend *)parent;
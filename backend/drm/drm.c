@@ -18,6 +18,7 @@
 #include <wlr/render.h>
 #include <wlr/render/gles2.h>
 #include <wlr/render/matrix.h>
+#include <wlr/types/wlr_surface.h>
 #include <wlr/util/log.h>
 #include <xf86drm.h>
 #include <xf86drmMode.h>
@@ -160,6 +161,110 @@ error_res:
 	return false;
 }
 
+static void client_buffer_destroy(struct wlr_drm_client_buffer *client_buffer) {
+	wl_list_remove(&client_buffer->link);
+	if (client_buffer->buffer != NULL) {
+		wl_list_remove(&client_buffer->buffer_destroy.link);
+	}
+	wlr_surface_unlock_buffer(client_buffer->lock);
+	gbm_bo_destroy(client_buffer->bo);
+	free(client_buffer);
+}
+
+static void client_buffer_handle_buffer_destroy(struct wl_listener *listener,
+		void *data) {
+	struct wlr_drm_client_buffer *client_buffer =
+		wl_container_of(listener, client_buffer, buffer_destroy);
+	wl_list_remove(&client_buffer->buffer_destroy.link);
+	client_buffer->buffer = NULL;
+	if (client_buffer->n_refs == 0) {
+		client_buffer_destroy(client_buffer);
+	}
+}
+
+/**
+ * Imports a client buffer for scanout, or returns the previous import of the
+ * same buffer. Returns NULL if it can't be imported.
+ */
+static struct wlr_drm_client_buffer *client_buffer_get(
+		struct wlr_drm_backend *drm, struct wl_resource *buffer) {
+	struct wlr_drm_client_buffer *client_buffer;
+	wl_list_for_each(client_buffer, &drm->client_buffers, link) {
+		if (client_buffer->buffer == buffer) {
+			return client_buffer;
+		}
+	}
+
+	struct gbm_bo *bo = gbm_bo_import(drm->renderer.gbm,
+		GBM_BO_IMPORT_WL_BUFFER, buffer, GBM_BO_USE_SCANOUT);
+	if (!bo) {
+		return NULL;
+	}
+	client_buffer = calloc(1, sizeof(struct wlr_drm_client_buffer));
+	if (client_buffer == NULL) {
+		wlr_log(L_ERROR, "Allocation failed");
+		gbm_bo_destroy(bo);
+		return NULL;
+	}
+	client_buffer->buffer = buffer;
+	client_buffer->bo = bo;
+	client_buffer->buffer_destroy.notify = client_buffer_handle_buffer_destroy;
+	wl_resource_add_destroy_listener(buffer, &client_buffer->buffer_destroy);
+	wl_list_insert(&drm->client_buffers, &client_buffer->link);
+	return client_buffer;
+}
+
+static void client_buffer_ref(struct wlr_drm_client_buffer *client_buffer) {
+	if (client_buffer->n_refs++ == 0 && client_buffer->buffer != NULL) {
+		// The client must not reuse the buffer while it may be displayed
+		client_buffer->lock = wlr_surface_lock_buffer(client_buffer->buffer);
+	}
+}
+
+static void client_buffer_unref(struct wlr_drm_client_buffer *client_buffer) {
+	if (client_buffer == NULL) {
+		return;
+	}
+	assert(client_buffer->n_refs > 0);
+	if (--client_buffer->n_refs > 0) {
+		return;
+	}
+	wlr_surface_unlock_buffer(client_buffer->lock);
+	client_buffer->lock = NULL;
+	if (client_buffer->buffer == NULL) {
+		client_buffer_destroy(client_buffer);
+	}
+}
+
+static void plane_set_pending_scanout(struct wlr_drm_plane *plane,
+		struct wlr_drm_client_buffer *client_buffer) {
+	if (client_buffer != NULL) {
+		client_buffer_ref(client_buffer);
+	}
+	client_buffer_unref(plane->pending_scanout);
+	plane->pending_scanout = client_buffer;
+	plane->scanout_pending = true;
+}
+
+static void plane_present_scanout(struct wlr_drm_plane *plane) {
+	if (!plane->scanout_pending) {
+		return;
+	}
+	// The previously displayed client buffer, if any, isn't used anymore
+	client_buffer_unref(plane->scanout);
+	plane->scanout = plane->pending_scanout;
+	plane->pending_scanout = NULL;
+	plane->scanout_pending = false;
+}
+
+static void plane_finish_scanout(struct wlr_drm_plane *plane) {
+	client_buffer_unref(plane->pending_scanout);
+	client_buffer_unref(plane->scanout);
+	plane->pending_scanout = NULL;
+	plane->scanout = NULL;
+	plane->scanout_pending = false;
+}
+
 void wlr_drm_resources_free(struct wlr_drm_backend *drm) {
 	if (!drm) {
 		return;
@@ -184,6 +289,12 @@ void wlr_drm_resources_free(struct wlr_drm_backend *drm) {
 		if (plane->wlr_tex) {
 			wlr_texture_destroy(plane->wlr_tex);
 		}
+		plane_finish_scanout(plane);
+	}
+
+	struct wlr_drm_client_buffer *client_buffer, *tmp;
+	wl_list_for_each_safe(client_buffer, tmp, &drm->client_buffers, link) {
+		client_buffer_destroy(client_buffer);
 	}
 
 	free(drm->crtcs);
@@ -212,7 +323,7 @@ static bool wlr_drm_connector_swap_buffers(struct wlr_output *output,
 
 	struct gbm_bo *bo = wlr_drm_surface_swap_buffers(&plane->surf, damage);
 	if (drm->parent) {
-		bo = wlr_drm_surface_mgpu_copy(&plane->mgpu_surf, bo);
+		bo = wlr_drm_surface_mgpu_copy(&plane->mgpu_surf, bo, damage);
 	}
 	uint32_t fb_id = get_fb_for_bo(bo);
 
@@ -225,11 +336,96 @@ static bool wlr_drm_connector_swap_buffers(struct wlr_output *output,
 		return false;
 	}
 
+	// The composited frame replaces the client buffer, if any
+	plane_set_pending_scanout(plane, NULL);
+	conn->pageflip_pending = true;
+	wlr_output_update_enabled(output, true);
+	return true;
+}
+
+bool wlr_drm_connector_scanout_buffer(struct wlr_output *output,
+		struct wl_resource *buffer) {
+	struct wlr_drm_connector *conn = (struct wlr_drm_connector *)output;
+	struct wlr_drm_backend *drm = (struct wlr_drm_backend *)output->backend;
+	if (!drm->session->active || drm->parent) {
+		// Client buffers are allocated on the parent GPU
+		return false;
+	}
+
+	struct wlr_drm_crtc *crtc = conn->crtc;
+	if (!crtc || !crtc->primary || conn->pageflip_pending) {
+		return false;
+	}
+	struct wlr_drm_plane *plane = crtc->primary;
+
+	struct wlr_drm_client_buffer *client_buffer =
+		client_buffer_get(drm, buffer);
+	if (client_buffer == NULL) {
+		return false;
+	}
+	struct gbm_bo *bo = client_buffer->bo;
+
+	uint32_t format = gbm_bo_get_format(bo);
+	if (gbm_bo_get_width(bo) != (uint32_t)output->width ||
+			gbm_bo_get_height(bo) != (uint32_t)output->height ||
+			(format != GBM_FORMAT_XRGB8888 && format != GBM_FORMAT_ARGB8888)) {
+		return false;
+	}
+
+	// The framebuffer is kept with the bo, see get_fb_for_bo
+	uint32_t fb_id = get_fb_for_bo(bo);
+	if (!fb_id || !drm->iface->crtc_pageflip(drm, conn, crtc, fb_id, NULL)) {
+		return false;
+	}
+
+	plane_set_pending_scanout(plane, client_buffer);
 	conn->pageflip_pending = true;
 	wlr_output_update_enabled(output, true);
 	return true;
 }
 
+static bool wlr_drm_connector_set_overlay(struct wlr_output *output,
+		struct wl_resource *buffer, const struct wlr_box *box) {
+	struct wlr_drm_connector *conn = (struct wlr_drm_connector *)output;
+	struct wlr_drm_backend *drm = (struct wlr_drm_backend *)output->backend;
+	if (!drm->session->active || drm->iface->crtc_set_overlay == NULL) {
+		return false;
+	}
+
+	struct wlr_drm_crtc *crtc = conn->crtc;
+	if (!crtc || !crtc->overlay || conn->pageflip_pending) {
+		return false;
+	}
+	struct wlr_drm_plane *plane = crtc->overlay;
+
+	if (buffer == NULL) {
+		if (!drm->iface->crtc_set_overlay(drm, crtc, NULL, NULL)) {
+			return false;
+		}
+		plane_set_pending_scanout(plane, NULL);
+		return true;
+	}
+
+	if (drm->parent) {
+		// Client buffers are allocated on the parent GPU
+		return false;
+	}
+
+	struct wlr_drm_client_buffer *client_buffer =
+		client_buffer_get(drm, buffer);
+	if (client_buffer == NULL) {
+		return false;
+	}
+
+	// The driver checks the format and scaling with a test commit
+	if (!drm->iface->crtc_set_overlay(drm, crtc, client_buffer->bo, box)) {
+		return false;
+	}
+
+	plane_set_pending_scanout(plane, client_buffer);
+	return true;
+}
+
 static void wlr_drm_connector_set_gamma(struct wlr_output *output,
 		uint32_t size, uint16_t *r, uint16_t *g, uint16_t *b) {
 	struct wlr_drm_connector *conn = (struct wlr_drm_connector *)output;
@@ -726,6 +922,8 @@ static struct wlr_output_impl output_impl = {
 	.swap_buffers = wlr_drm_connector_swap_buffers,
 	.set_gamma = wlr_drm_connector_set_gamma,
 	.get_gamma_size = wlr_drm_connector_get_gamma_size,
+	.scanout_buffer = wlr_drm_connector_scanout_buffer,
+	.set_overlay = wlr_drm_connector_set_overlay,
 };
 
 bool wlr_output_is_drm(struct wlr_output *output) {
@@ -915,11 +1113,26 @@ static void page_flip_handler(int fd, unsigned seq,
 		return;
 	}
 
-	wlr_drm_surface_post(&conn->crtc->primary->surf);
+	struct wlr_drm_plane *primary = conn->crtc->primary;
+	wlr_drm_surface_post(&primary->surf);
 	if (drm->parent) {
-		wlr_drm_surface_post(&conn->crtc->primary->mgpu_surf);
+		wlr_drm_surface_post(&primary->mgpu_surf);
+	}
+
+	plane_present_scanout(primary);
+	if (conn->crtc->overlay) {
+		plane_present_scanout(conn->crtc->overlay);
 	}
 
+	// The kernel reports CLOCK_MONOTONIC timestamps
+	struct timespec present_time = {
+		.tv_sec = tv_sec,
+		.tv_nsec = tv_usec * 1000,
+	};
+	uint32_t present_flags = WLR_OUTPUT_PRESENT_VSYNC |
+		WLR_OUTPUT_PRESENT_HW_CLOCK | WLR_OUTPUT_PRESENT_HW_COMPLETION;
+	wlr_output_send_present(&conn->output, &present_time, seq, present_flags);
+
 	if (drm->session->active) {
 		wlr_output_send_frame(&conn->output);
 	}
@@ -991,6 +1204,7 @@ void wlr_drm_connector_cleanup(struct wlr_drm_connector *conn) {
 
 			wlr_drm_surface_finish(&crtc->planes[i]->surf);
 			wlr_drm_surface_finish(&crtc->planes[i]->mgpu_surf);
+			plane_finish_scanout(crtc->planes[i]);
 			if (crtc->planes[i]->id == 0) {
 				free(crtc->planes[i]);
 				crtc->planes[i] = NULL;
@@ -4,6 +4,7 @@
 #include <GLES2/gl2.h>
 #include <stdbool.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 #include <wayland-util.h>
 #include <wlr/render.h>
@@ -63,6 +64,7 @@ bool wlr_drm_surface_init(struct wlr_drm_surface *surf,
 	surf->renderer = renderer;
 	surf->width = width;
 	surf->height = height;
+	surf->previous_damage_len = 0;
 
 	if (surf->gbm) {
 		if (surf->front) {
@@ -149,6 +151,9 @@ struct gbm_bo *wlr_drm_surface_get_front(struct wlr_drm_surface *surf) {
 		return surf->front;
 	}
 
+	// This frame isn't part of the damage history
+	surf->previous_damage_len = 0;
+
 	wlr_drm_surface_make_current(surf, NULL);
 	glViewport(0, 0, surf->width, surf->height);
 	glClearColor(0.0, 0.0, 0.0, 1.0);
@@ -192,6 +197,11 @@ static struct wlr_texture *get_tex_for_bo(struct wlr_drm_renderer *renderer, str
 	tex->egl = &renderer->egl;
 
 	int dmabuf_fd = gbm_bo_get_fd(bo);
+	if (dmabuf_fd < 0) {
+		wlr_log_errno(L_ERROR, "Failed to export bo");
+		free(tex);
+		return NULL;
+	}
 	uint32_t width = gbm_bo_get_width(bo);
 	uint32_t height = gbm_bo_get_height(bo);
 
@@ -208,9 +218,12 @@ static struct wlr_texture *get_tex_for_bo(struct wlr_drm_renderer *renderer, str
 
 	tex->img = eglCreateImageKHR(renderer->egl.display, EGL_NO_CONTEXT,
 		EGL_LINUX_DMA_BUF_EXT, NULL, attribs);
+	// The EGL image holds its own reference to the dma-buf
+	close(dmabuf_fd);
 	if (!tex->img) {
 		wlr_log(L_ERROR, "Failed to create EGL image: %s", egl_error());
-		abort();
+		free(tex);
+		return NULL;
 	}
 
 	tex->tex = wlr_render_texture_create(renderer->wlr_rend);
@@ -221,10 +234,50 @@ static struct wlr_texture *get_tex_for_bo(struct wlr_drm_renderer *renderer, str
 	return tex->tex;
 }
 
+/**
+ * Computes the area of the current back buffer of surf that needs to be
+ * copied, given the damage of this frame and the age of the buffer, and
+ * records the frame damage.
+ */
+static void surface_get_copy_damage(struct wlr_drm_surface *surf,
+		pixman_region32_t *damage, int buffer_age,
+		pixman_region32_t *copy_damage) {
+	pixman_box32_t full = {
+		.x2 = surf->width,
+		.y2 = surf->height,
+	};
+	pixman_box32_t extents = full;
+	if (damage != NULL) {
+		extents = *pixman_region32_extents(damage);
+	}
+
+	if (damage == NULL || buffer_age <= 0 ||
+			(size_t)buffer_age - 1 > surf->previous_damage_len) {
+		pixman_region32_union_rect(copy_damage, copy_damage, 0, 0,
+			surf->width, surf->height);
+	} else {
+		pixman_region32_copy(copy_damage, damage);
+		for (int i = 0; i < buffer_age - 1; ++i) {
+			pixman_box32_t *box = &surf->previous_damage[i];
+			pixman_region32_union_rect(copy_damage, copy_damage, box->x1,
+				box->y1, box->x2 - box->x1, box->y2 - box->y1);
+		}
+	}
+
+	memmove(&surf->previous_damage[1], &surf->previous_damage[0],
+		(WLR_DRM_SURFACE_DAMAGE_LEN - 1) * sizeof(pixman_box32_t));
+	surf->previous_damage[0] = extents;
+	if (surf->previous_damage_len < WLR_DRM_SURFACE_DAMAGE_LEN) {
+		++surf->previous_damage_len;
+	}
+}
+
 struct gbm_bo *wlr_drm_surface_mgpu_copy(struct wlr_drm_surface *dest,
-		struct gbm_bo *src) {
-	wlr_drm_surface_make_current(dest, NULL);
+		struct gbm_bo *src, pixman_region32_t *damage) {
+	int buffer_age = -1;
+	wlr_drm_surface_make_current(dest, &buffer_age);
 
+	struct wlr_renderer *renderer = dest->renderer->wlr_rend;
 	struct wlr_texture *tex = get_tex_for_bo(dest->renderer, src);
 
 	static const float matrix[16] = {
@@ -236,12 +289,34 @@ struct gbm_bo *wlr_drm_surface_mgpu_copy(struct wlr_drm_surface *dest,
 		[15] = 1.0f,
 	};
 
+	// The source and destination buffers have the same size and orientation,
+	// so the damage applies to both as is
+	pixman_region32_t copy_damage;
+	pixman_region32_init(&copy_damage);
+	surface_get_copy_damage(dest, damage, buffer_age, &copy_damage);
+
 	glViewport(0, 0, dest->width, dest->height);
-	glClearColor(0.0, 0.0, 0.0, 1.0);
-	glClear(GL_COLOR_BUFFER_BIT);
-	wlr_render_with_matrix(dest->renderer->wlr_rend, tex, &matrix, 1.0f);
+	int nrects;
+	pixman_box32_t *rects = pixman_region32_rectangles(&copy_damage, &nrects);
+	for (int i = 0; i < nrects; ++i) {
+		struct wlr_box box = {
+			.x = rects[i].x1,
+			.y = rects[i].y1,
+			.width = rects[i].x2 - rects[i].x1,
+			.height = rects[i].y2 - rects[i].y1,
+		};
+		wlr_renderer_scissor(renderer, &box);
+		wlr_renderer_clear(renderer, &(float[]){ 0.0, 0.0, 0.0, 1.0 });
+		if (tex) {
+			wlr_render_with_matrix(renderer, tex, &matrix, 1.0f);
+		}
+	}
+	wlr_renderer_scissor(renderer, NULL);
 
-	return wlr_drm_surface_swap_buffers(dest, NULL);
+	struct gbm_bo *bo = wlr_drm_surface_swap_buffers(dest,
+		damage != NULL ? &copy_damage : NULL);
+	pixman_region32_fini(&copy_damage);
+	return bo;
 }
 
 bool wlr_drm_plane_surfaces_init(struct wlr_drm_plane *plane, struct wlr_drm_backend *drm,
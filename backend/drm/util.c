@@ -1,6 +1,7 @@
 #include <drm_mode.h>
 #include <drm.h>
 #include <gbm.h>
+#include <limits.h>
 #include <stdio.h>
 #include <string.h>
 #include <wlr/util/log.h>
@@ -182,135 +183,145 @@ uint32_t get_fb_for_bo(struct gbm_bo *bo) {
 	return id;
 }
 
-static inline bool is_taken(size_t n, const uint32_t arr[static n], uint32_t key) {
-	for (size_t i = 0; i < n; ++i) {
-		if (arr[i] == key) {
-			return true;
-		}
-	}
-	return false;
-}
-
 /*
- * Store all of the non-recursive state in a struct, so we aren't literally
- * passing 12 arguments to a function.
+ * The matching is computed as a min-cost maximum bipartite matching, using
+ * successive shortest augmenting paths, which is polynomial in the number of
+ * objects and resources. Keeping a resource on its original object costs 0,
+ * any other match costs 1: among the maximum matchings, the cheapest one keeps
+ * the most resources in place, i.e. is the closest to the original solution.
  */
+#define MATCH_INF INT_MAX
+
 struct match_state {
 	const size_t num_objs;
 	const uint32_t *restrict objs;
 	const size_t num_res;
-	size_t score;
-	size_t replaced;
-	uint32_t *restrict res;
-	uint32_t *restrict best;
 	const uint32_t *restrict orig;
-	bool exit_early;
+	uint32_t *restrict res_match; // Object of each resource
+	uint32_t *restrict obj_match; // Resource of each object
+	int *restrict res_dist;
+	int *restrict obj_dist;
+	uint32_t *restrict obj_prev; // Resource an object was reached from
 };
 
 /*
- * skips: The number of SKIP elements encountered so far.
- * score: The number of resources we've matched so far.
- * replaced: The number of changes from the original solution.
- * i: The index of the current element.
- *
- * This tries to match a solution as close to st->orig as it can.
- *
- * Returns whether we've set a new best element with this solution.
+ * Returns the cost of matching resource i with object j, or -1 if they
+ * can't be matched.
  */
-static bool match_obj_(struct match_state *st, size_t skips, size_t score, size_t replaced, size_t i) {
-	// Finished
-	if (i >= st->num_res) {
-		if (score > st->score || (score == st->score && replaced < st->replaced)) {
-			st->score = score;
-			st->replaced = replaced;
-			memcpy(st->best, st->res, sizeof(st->best[0]) * st->num_res);
-
-			if (st->score == st->num_objs && st->replaced == 0) {
-				st->exit_early = true;
-			}
-			st->exit_early = (st->score == st->num_res - skips
-					|| st->score == st->num_objs)
-					&& st->replaced == 0;
-
-			return true;
-		} else {
-			return false;
-		}
+static int match_cost(const struct match_state *st, size_t i, size_t j) {
+	if (st->orig[i] == j) {
+		// The current solution is always preferred
+		return 0;
 	}
-
-	if (st->orig[i] == SKIP) {
-		st->res[i] = SKIP;
-		return match_obj_(st, skips + 1, score, replaced, i + 1);
+	if (i >= 32 || !(st->objs[j] & (UINT32_C(1) << i))) {
+		return -1;
 	}
+	return 1;
+}
 
-	/*
-	 * Attempt to use the current solution first, to try and avoid
-	 * recalculating everything
-	 */
-
-	if (st->orig[i] != UNMATCHED && !is_taken(i, st->res, st->orig[i])) {
-		st->res[i] = st->orig[i];
-		if (match_obj_(st, skips, score + 1, replaced, i + 1)) {
-			return true;
-		}
+/*
+ * Finds the cheapest augmenting path from an unmatched resource to an
+ * unmatched object, with Bellman-Ford since reversed matched edges have
+ * negative costs. Returns the object at the end of the path, or UNMATCHED.
+ */
+static uint32_t match_find_path(struct match_state *st) {
+	for (size_t i = 0; i < st->num_res; ++i) {
+		bool unmatched = st->res_match[i] == UNMATCHED &&
+			st->orig[i] != SKIP;
+		st->res_dist[i] = unmatched ? 0 : MATCH_INF;
 	}
-
-	if (st->orig[i] != UNMATCHED) {
-		++replaced;
+	for (size_t j = 0; j < st->num_objs; ++j) {
+		st->obj_dist[j] = MATCH_INF;
+		st->obj_prev[j] = UNMATCHED;
 	}
 
-	bool is_best = false;
-	for (st->res[i] = 0; st->res[i] < st->num_objs; ++st->res[i]) {
-		// We tried this earlier
-		if (st->res[i] == st->orig[i]) {
-			continue;
-		}
-
-		// Not compatable
-		if (!(st->objs[st->res[i]] & (1 << i))) {
-			continue;
-		}
-
-		// Already taken
-		if (is_taken(i, st->res, st->res[i])) {
-			continue;
+	// Each round extends paths by one edge, there are no negative cycles
+	bool changed = true;
+	for (size_t round = 0; changed && round <= st->num_res + st->num_objs;
+			++round) {
+		changed = false;
+		for (size_t i = 0; i < st->num_res; ++i) {
+			if (st->res_dist[i] == MATCH_INF) {
+				continue;
+			}
+			for (size_t j = 0; j < st->num_objs; ++j) {
+				int cost = match_cost(st, i, j);
+				if (cost < 0 || st->res_match[i] == j) {
+					continue;
+				}
+				if (st->res_dist[i] + cost < st->obj_dist[j]) {
+					st->obj_dist[j] = st->res_dist[i] + cost;
+					st->obj_prev[j] = i;
+					changed = true;
+				}
+			}
 		}
-
-		if (match_obj_(st, skips, score + 1, replaced, i + 1)) {
-			is_best = true;
+		for (size_t j = 0; j < st->num_objs; ++j) {
+			uint32_t i = st->obj_match[j];
+			if (st->obj_dist[j] == MATCH_INF || i == UNMATCHED) {
+				continue;
+			}
+			int dist = st->obj_dist[j] - match_cost(st, i, j);
+			if (dist < st->res_dist[i]) {
+				st->res_dist[i] = dist;
+				changed = true;
+			}
 		}
+	}
 
-		if (st->exit_early) {
-			return true;
+	uint32_t best = UNMATCHED;
+	for (size_t j = 0; j < st->num_objs; ++j) {
+		if (st->obj_match[j] == UNMATCHED && st->obj_dist[j] != MATCH_INF &&
+				(best == UNMATCHED || st->obj_dist[j] < st->obj_dist[best])) {
+			best = j;
 		}
 	}
+	return best;
+}
 
-	if (is_best) {
-		return true;
+static void match_augment(struct match_state *st, uint32_t j) {
+	while (j != UNMATCHED) {
+		uint32_t i = st->obj_prev[j];
+		uint32_t prev = st->res_match[i];
+		st->res_match[i] = j;
+		st->obj_match[j] = i;
+		j = prev;
 	}
-
-	// Maybe this resource can't be matched
-	st->res[i] = UNMATCHED;
-	return match_obj_(st, skips, score, replaced, i + 1);
 }
 
 size_t match_obj(size_t num_objs, const uint32_t objs[static restrict num_objs],
 		size_t num_res, const uint32_t res[static restrict num_res],
 		uint32_t out[static restrict num_res]) {
-	uint32_t solution[num_res];
+	uint32_t obj_match[num_objs];
+	int res_dist[num_res], obj_dist[num_objs];
+	uint32_t obj_prev[num_objs];
 
 	struct match_state st = {
 		.num_objs = num_objs,
-		.num_res = num_res,
-		.score = 0,
-		.replaced = SIZE_MAX,
 		.objs = objs,
-		.res = solution,
-		.best = out,
+		.num_res = num_res,
 		.orig = res,
-		.exit_early = false,
+		.res_match = out,
+		.obj_match = obj_match,
+		.res_dist = res_dist,
+		.obj_dist = obj_dist,
+		.obj_prev = obj_prev,
 	};
 
-	match_obj_(&st, 0, 0, 0, 0);
-	return st.score;
+	for (size_t i = 0; i < num_res; ++i) {
+		out[i] = res[i] == SKIP ? SKIP : UNMATCHED;
+	}
+	for (size_t j = 0; j < num_objs; ++j) {
+		obj_match[j] = UNMATCHED;
+	}
+
+	// Each augmentation matches one more resource, at the lowest cost
+	size_t score = 0;
+	uint32_t j;
+	while ((j = match_find_path(&st)) != UNMATCHED) {
+		match_augment(&st, j);
+		++score;
+	}
+
+	return score;
 }
@@ -4,6 +4,7 @@
 #include <wlr/interfaces/wlr_output.h>
 #include <wlr/render/egl.h>
 #include <wlr/render/gles2.h>
+#include <wlr/render/pixman.h>
 #include <wlr/util/log.h>
 #include "backend/headless.h"
 #include "glapi.h"
@@ -54,14 +55,17 @@ static void backend_destroy(struct wlr_backend *wlr_backend) {
 
 	wlr_signal_emit_safe(&wlr_backend->events.destroy, backend);
 
-	wlr_egl_finish(&backend->egl);
+	wlr_renderer_destroy(backend->renderer);
+	if (backend->has_egl) {
+		wlr_egl_finish(&backend->egl);
+	}
 	free(backend);
 }
 
 static struct wlr_egl *backend_get_egl(struct wlr_backend *wlr_backend) {
 	struct wlr_headless_backend *backend =
 		(struct wlr_headless_backend *)wlr_backend;
-	return &backend->egl;
+	return backend->has_egl ? &backend->egl : NULL;
 }
 
 static struct wlr_renderer *backend_get_renderer(
@@ -84,6 +88,20 @@ static void handle_display_destroy(struct wl_listener *listener, void *data) {
 	backend_destroy(&backend->backend);
 }
 
+static bool headless_egl_init(struct wlr_headless_backend *backend) {
+	static const EGLint config_attribs[] = {
+		EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+		EGL_ALPHA_SIZE, 0,
+		EGL_BLUE_SIZE, 8,
+		EGL_GREEN_SIZE, 8,
+		EGL_RED_SIZE, 8,
+		EGL_RENDERABLE_TYPE, EGL_OPENGL_ES2_BIT,
+		EGL_NONE,
+	};
+	return wlr_egl_init(&backend->egl, EGL_PLATFORM_SURFACELESS_MESA, NULL,
+		(EGLint *)config_attribs, 0);
+}
+
 struct wlr_backend *wlr_headless_backend_create(struct wl_display *display) {
 	wlr_log(L_INFO, "Creating headless backend");
 
@@ -98,25 +116,27 @@ struct wlr_backend *wlr_headless_backend_create(struct wl_display *display) {
 	wl_list_init(&backend->outputs);
 	wl_list_init(&backend->input_devices);
 
-	static const EGLint config_attribs[] = {
-		EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
-		EGL_ALPHA_SIZE, 0,
-		EGL_BLUE_SIZE, 8,
-		EGL_GREEN_SIZE, 8,
-		EGL_RED_SIZE, 8,
-		EGL_RENDERABLE_TYPE, EGL_OPENGL_ES2_BIT,
-		EGL_NONE,
-	};
-	bool ok = wlr_egl_init(&backend->egl, EGL_PLATFORM_SURFACELESS_MESA, NULL,
-		(EGLint *)config_attribs, 0);
-	if (!ok) {
-		free(backend);
-		return NULL;
+	// Rendering with pixman into memory avoids EGL setup costs on machines
+	// without a GPU
+	if (getenv("WLR_HEADLESS_PIXMAN") == NULL) {
+		backend->has_egl = headless_egl_init(backend);
+		if (!backend->has_egl) {
+			wlr_log(L_INFO, "Falling back to memory-backed outputs");
+		}
 	}
 
-	backend->renderer = wlr_gles2_renderer_create(&backend->backend);
+	if (backend->has_egl) {
+		backend->renderer = wlr_gles2_renderer_create(&backend->backend);
+	} else {
+		backend->renderer = wlr_pixman_renderer_create();
+	}
 	if (backend->renderer == NULL) {
 		wlr_log(L_ERROR, "Failed to create renderer");
+		if (backend->has_egl) {
+			wlr_egl_finish(&backend->egl);
+		}
+		free(backend);
+		return NULL;
 	}
 
 	backend->display_destroy.notify = handle_display_destroy;
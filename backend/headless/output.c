@@ -3,6 +3,7 @@
 #include <GLES2/gl2.h>
 #include <stdlib.h>
 #include <wlr/interfaces/wlr_output.h>
+#include <wlr/render/pixman.h>
 #include <wlr/util/log.h>
 #include "backend/headless.h"
 #include "util/signal.h"
@@ -19,21 +20,43 @@ static EGLSurface egl_create_surface(struct wlr_egl *egl, unsigned int width,
 	return surf;
 }
 
+static pixman_image_t *image_create(unsigned int width, unsigned int height) {
+	pixman_image_t *image = pixman_image_create_bits(PIXMAN_x8r8g8b8,
+		width, height, NULL, 0);
+	if (image == NULL) {
+		wlr_log(L_ERROR, "Failed to allocate output image");
+	}
+	return image;
+}
+
 static bool output_set_custom_mode(struct wlr_output *wlr_output, int32_t width,
 		int32_t height, int32_t refresh) {
 	struct wlr_headless_output *output =
 		(struct wlr_headless_output *)wlr_output;
 	struct wlr_headless_backend *backend = output->backend;
 
-	if (output->egl_surface) {
-		eglDestroySurface(backend->egl.display, output->egl_surface);
-	}
-
-	output->egl_surface = egl_create_surface(&backend->egl, width, height);
-	if (output->egl_surface == EGL_NO_SURFACE) {
-		wlr_log(L_ERROR, "Failed to recreate EGL surface");
-		wlr_output_destroy(wlr_output);
-		return false;
+	if (!backend->has_egl) {
+		pixman_image_t *image = image_create(width, height);
+		if (image == NULL) {
+			wlr_output_destroy(wlr_output);
+			return false;
+		}
+		if (output->image) {
+			pixman_image_unref(output->image);
+		}
+		output->image = image;
+		output->image_rendered = false;
+	} else {
+		if (output->egl_surface) {
+			eglDestroySurface(backend->egl.display, output->egl_surface);
+		}
+
+		output->egl_surface = egl_create_surface(&backend->egl, width, height);
+		if (output->egl_surface == EGL_NO_SURFACE) {
+			wlr_log(L_ERROR, "Failed to recreate EGL surface");
+			wlr_output_destroy(wlr_output);
+			return false;
+		}
 	}
 
 	output->frame_delay = 1000000 / refresh;
@@ -52,13 +75,25 @@ static void output_transform(struct wlr_output *wlr_output,
 static bool output_make_current(struct wlr_output *wlr_output, int *buffer_age) {
 	struct wlr_headless_output *output =
 		(struct wlr_headless_output *)wlr_output;
+	struct wlr_headless_backend *backend = output->backend;
+	if (!backend->has_egl) {
+		// There is a single buffer, which keeps its contents between frames
+		if (buffer_age != NULL) {
+			*buffer_age = output->image_rendered ? 1 : 0;
+		}
+		wlr_pixman_renderer_bind_image(backend->renderer, output->image);
+		return true;
+	}
 	return wlr_egl_make_current(&output->backend->egl, output->egl_surface,
 		buffer_age);
 }
 
 static bool output_swap_buffers(struct wlr_output *wlr_output,
 		pixman_region32_t *damage) {
-	return true; // No-op
+	struct wlr_headless_output *output =
+		(struct wlr_headless_output *)wlr_output;
+	output->image_rendered = true;
+	return true;
 }
 
 static void output_destroy(struct wlr_output *wlr_output) {
@@ -69,7 +104,12 @@ static void output_destroy(struct wlr_output *wlr_output) {
 
 	wl_event_source_remove(output->frame_timer);
 
-	eglDestroySurface(output->backend->egl.display, output->egl_surface);
+	if (output->image) {
+		pixman_image_unref(output->image);
+	}
+	if (output->egl_surface) {
+		eglDestroySurface(output->backend->egl.display, output->egl_surface);
+	}
 	free(output);
 }
 
@@ -87,6 +127,7 @@ bool wlr_output_is_headless(struct wlr_output *wlr_output) {
 
 static int signal_frame(void *data) {
 	struct wlr_headless_output *output = data;
+	wlr_output_send_present(&output->wlr_output, NULL, 0, 0);
 	wlr_output_send_frame(&output->wlr_output);
 	wl_event_source_timer_update(output->frame_timer, output->frame_delay);
 	return 0;
@@ -108,10 +149,12 @@ struct wlr_output *wlr_headless_add_output(struct wlr_backend *wlr_backend,
 		backend->display);
 	struct wlr_output *wlr_output = &output->wlr_output;
 
-	output->egl_surface = egl_create_surface(&backend->egl, width, height);
-	if (output->egl_surface == EGL_NO_SURFACE) {
-		wlr_log(L_ERROR, "Failed to create EGL surface");
-		goto error;
+	if (backend->has_egl) {
+		output->egl_surface = egl_create_surface(&backend->egl, width, height);
+		if (output->egl_surface == EGL_NO_SURFACE) {
+			wlr_log(L_ERROR, "Failed to create EGL surface");
+			goto error;
+		}
 	}
 
 	output_set_custom_mode(wlr_output, width, height, 60*1000);
@@ -120,17 +163,19 @@ struct wlr_output *wlr_headless_add_output(struct wlr_backend *wlr_backend,
 	snprintf(wlr_output->name, sizeof(wlr_output->name), "HEADLESS-%d",
 		wl_list_length(&backend->outputs) + 1);
 
-	if (!eglMakeCurrent(output->backend->egl.display,
-			output->egl_surface, output->egl_surface,
-			output->backend->egl.context)) {
-		wlr_log(L_ERROR, "eglMakeCurrent failed: %s", egl_error());
-		goto error;
+	if (backend->has_egl) {
+		if (!eglMakeCurrent(output->backend->egl.display,
+				output->egl_surface, output->egl_surface,
+				output->backend->egl.context)) {
+			wlr_log(L_ERROR, "eglMakeCurrent failed: %s", egl_error());
+			goto error;
+		}
+
+		glViewport(0, 0, wlr_output->width, wlr_output->height);
+		glClearColor(1.0, 1.0, 1.0, 1.0);
+		glClear(GL_COLOR_BUFFER_BIT);
 	}
 
-	glViewport(0, 0, wlr_output->width, wlr_output->height);
-	glClearColor(1.0, 1.0, 1.0, 1.0);
-	glClear(GL_COLOR_BUFFER_BIT);
-
 	struct wl_event_loop *ev = wl_display_get_event_loop(backend->display);
 	output->frame_timer = wl_event_loop_add_timer(ev, signal_frame, output);
 
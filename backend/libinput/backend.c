@@ -35,6 +35,7 @@ static int wlr_libinput_readable(int fd, uint32_t mask, void *_backend) {
 		wlr_libinput_event(backend, event);
 		libinput_event_destroy(event);
 	}
+	wlr_libinput_flush_pointer_motion(backend);
 	return 0;
 }
 
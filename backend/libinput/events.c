@@ -195,6 +195,10 @@ void wlr_libinput_event(struct wlr_libinput_backend *backend,
 	assert(backend && event);
 	struct libinput_device *libinput_dev = libinput_event_get_device(event);
 	enum libinput_event_type event_type = libinput_event_get_type(event);
+	if (event_type != LIBINPUT_EVENT_POINTER_MOTION) {
+		// Keep events ordered, e.g. motion must be sent before a button press
+		wlr_libinput_flush_pointer_motion(backend);
+	}
 	switch (event_type) {
 	case LIBINPUT_EVENT_DEVICE_ADDED:
 		handle_device_added(backend, libinput_dev);
@@ -206,7 +210,7 @@ void wlr_libinput_event(struct wlr_libinput_backend *backend,
 		handle_keyboard_key(event, libinput_dev);
 		break;
 	case LIBINPUT_EVENT_POINTER_MOTION:
-		handle_pointer_motion(event, libinput_dev);
+		handle_pointer_motion(backend, event, libinput_dev);
 		break;
 	case LIBINPUT_EVENT_POINTER_MOTION_ABSOLUTE:
 		handle_pointer_motion_abs(event, libinput_dev);
@@ -1,6 +1,7 @@
 #include <assert.h>
 #include <libinput.h>
 #include <stdlib.h>
+#include <string.h>
 #include <wlr/backend/session.h>
 #include <wlr/interfaces/wlr_pointer.h>
 #include <wlr/types/wlr_input_device.h>
@@ -20,8 +21,18 @@ struct wlr_pointer *wlr_libinput_pointer_create(
 	return wlr_pointer;
 }
 
-void handle_pointer_motion(struct libinput_event *event,
-		struct libinput_device *libinput_dev) {
+void wlr_libinput_flush_pointer_motion(struct wlr_libinput_backend *backend) {
+	struct wlr_event_pointer_motion wlr_event = backend->pending_motion;
+	if (wlr_event.device == NULL) {
+		return;
+	}
+	backend->pending_motion.device = NULL;
+	wlr_signal_emit_safe(&wlr_event.device->pointer->events.motion,
+		&wlr_event);
+}
+
+void handle_pointer_motion(struct wlr_libinput_backend *backend,
+		struct libinput_event *event, struct libinput_device *libinput_dev) {
 	struct wlr_input_device *wlr_dev =
 		get_appropriate_device(WLR_INPUT_DEVICE_POINTER, libinput_dev);
 	if (!wlr_dev) {
@@ -30,13 +41,23 @@ void handle_pointer_motion(struct libinput_event *event,
 	}
 	struct libinput_event_pointer *pevent =
 		libinput_event_get_pointer_event(event);
-	struct wlr_event_pointer_motion wlr_event = { 0 };
-	wlr_event.device = wlr_dev;
-	wlr_event.time_msec =
+
+	// High-frequency devices send many motion events per dispatch, merge
+	// consecutive ones to only hit-test and notify clients once
+	struct wlr_event_pointer_motion *pending = &backend->pending_motion;
+	if (pending->device != wlr_dev) {
+		wlr_libinput_flush_pointer_motion(backend);
+		memset(pending, 0, sizeof(struct wlr_event_pointer_motion));
+		pending->device = wlr_dev;
+	}
+	pending->time_msec =
 		usec_to_msec(libinput_event_pointer_get_time_usec(pevent));
-	wlr_event.delta_x = libinput_event_pointer_get_dx(pevent);
-	wlr_event.delta_y = libinput_event_pointer_get_dy(pevent);
-	wlr_signal_emit_safe(&wlr_dev->pointer->events.motion, &wlr_event);
+	pending->delta_x += libinput_event_pointer_get_dx(pevent);
+	pending->delta_y += libinput_event_pointer_get_dy(pevent);
+	pending->unaccel_dx +=
+		libinput_event_pointer_get_dx_unaccelerated(pevent);
+	pending->unaccel_dy +=
+		libinput_event_pointer_get_dy_unaccelerated(pevent);
 }
 
 void handle_pointer_motion_abs(struct libinput_event *event,
@@ -25,6 +25,7 @@ static void surface_frame_callback(void *data, struct wl_callback *cb,
 	wl_callback_destroy(cb);
 	output->frame_callback = NULL;
 
+	wlr_output_send_present(&output->wlr_output, NULL, 0, 0);
 	wlr_output_send_frame(&output->wlr_output);
 }
 
@@ -0,0 +1,894 @@
+/*
+ * Benchmarks the wlroots hot paths: surface commits, output damage tracking
+ * and rendering. Synthetic clients run in the same process and are connected
+ * through socket pairs, so that the whole pipeline is measured without any
+ * external dependency. Results are printed as JSON on stdout.
+ *
+ * Frames are rendered by the minimal loop below (output_handle_frame), not by
+ * rootston: render_output, its occlusion culling and overlay plane selection
+ * are not covered by these numbers.
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <errno.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+#include <wayland-client.h>
+#include <wayland-server.h>
+#include <wlr/backend.h>
+#include <wlr/backend/headless.h>
+#include <wlr/render.h>
+#include <wlr/render/matrix.h>
+#include <wlr/types/wlr_box.h>
+#include <wlr/types/wlr_compositor.h>
+#include <wlr/types/wlr_output.h>
+#include <wlr/types/wlr_output_damage.h>
+#include <wlr/types/wlr_surface.h>
+#include <wlr/util/log.h>
+
+#define CLIENT_WIDTH 256
+#define CLIENT_HEIGHT 256
+#define SUBSURFACE_SIZE 64
+#define SCATTERED_RECTS 8
+
+enum damage_pattern {
+	DAMAGE_FULL,
+	DAMAGE_PARTIAL,
+	DAMAGE_SCATTERED,
+	DAMAGE_NONE,
+};
+
+static const char *damage_pattern_names[] = {
+	[DAMAGE_FULL] = "full",
+	[DAMAGE_PARTIAL] = "partial",
+	[DAMAGE_SCATTERED] = "scattered",
+	[DAMAGE_NONE] = "none",
+};
+
+struct samples {
+	double *values;
+	size_t len, cap;
+};
+
+struct bench_output {
+	struct bench_state *state;
+	struct wlr_output *wlr_output;
+	struct wlr_output_damage *damage;
+	uint64_t frames;
+	struct wl_listener frame;
+};
+
+struct bench_view {
+	struct bench_state *state;
+	struct wlr_surface *surface;
+	struct bench_output *output; // only for root surfaces
+	int x, y;
+	struct wl_list link; // bench_state::views
+	struct wl_listener commit;
+	struct wl_listener destroy;
+};
+
+struct bench_buffer {
+	struct wl_buffer *wl_buffer;
+	uint32_t *data;
+	size_t size;
+	int width, height;
+	bool busy;
+};
+
+struct bench_client_surface {
+	struct wl_surface *wl_surface;
+	struct wl_subsurface *wl_subsurface;
+	struct bench_buffer buffers[2];
+	int width, height;
+};
+
+struct bench_client {
+	struct bench_state *state;
+	size_t index;
+	struct wl_display *display;
+	struct wl_event_source *source;
+	struct wl_compositor *compositor;
+	struct wl_subcompositor *subcompositor;
+	struct wl_shm *shm;
+
+	struct bench_client_surface *surfaces; // the first one is the root
+	size_t surfaces_len;
+	struct wl_callback *frame_callback;
+	struct timespec commit_time;
+	uint64_t commits;
+};
+
+struct bench_state {
+	struct wl_display *display;
+	struct wl_event_loop *loop;
+	struct wlr_backend *backend;
+	struct wlr_renderer *renderer;
+	struct wlr_compositor *compositor;
+
+	size_t outputs_len, clients_len, subsurfaces_len;
+	int output_width, output_height, refresh;
+	uint64_t frames;
+	enum damage_pattern pattern;
+
+	struct bench_output *outputs;
+	struct bench_client *clients;
+	struct wl_list views; // bench_view::link
+	size_t roots;
+
+	struct samples latency, render, dispatch;
+	uint64_t dispatch_iterations;
+	uint64_t render_allocs, total_allocs;
+	bool done;
+	bool failed; // results are incomplete
+
+	struct wl_listener new_surface;
+};
+
+#if defined(__GLIBC__) && !defined(__SANITIZE_ADDRESS__)
+// Count allocations by wrapping the glibc allocator. The executable's
+// definitions take precedence over the ones of libc for the whole process.
+static uint64_t alloc_count = 0;
+static const bool alloc_count_supported = true;
+
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t nmemb, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+
+void *malloc(size_t size) {
+	++alloc_count;
+	return __libc_malloc(size);
+}
+
+void *calloc(size_t nmemb, size_t size) {
+	++alloc_count;
+	return __libc_calloc(nmemb, size);
+}
+
+void *realloc(void *ptr, size_t size) {
+	++alloc_count;
+	return __libc_realloc(ptr, size);
+}
+#else
+static uint64_t alloc_count = 0;
+static const bool alloc_count_supported = false;
+#endif
+
+static int64_t timespec_to_nsec(const struct timespec *t) {
+	return (int64_t)t->tv_sec * 1000000000 + t->tv_nsec;
+}
+
+static int64_t get_elapsed_nsec(const struct timespec *since) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return timespec_to_nsec(&now) - timespec_to_nsec(since);
+}
+
+static void samples_add(struct samples *samples, double value) {
+	if (samples->len == samples->cap) {
+		size_t cap = samples->cap == 0 ? 256 : samples->cap * 2;
+		double *values = realloc(samples->values, cap * sizeof(double));
+		if (values == NULL) {
+			return;
+		}
+		samples->values = values;
+		samples->cap = cap;
+	}
+	samples->values[samples->len++] = value;
+}
+
+static int compare_double(const void *a, const void *b) {
+	double da = *(const double *)a, db = *(const double *)b;
+	return (da > db) - (da < db);
+}
+
+static void samples_print(const char *name, struct samples *samples) {
+	if (samples->len == 0) {
+		printf("\"%s\": null", name);
+		return;
+	}
+
+	qsort(samples->values, samples->len, sizeof(double), compare_double);
+	double sum = 0;
+	for (size_t i = 0; i < samples->len; ++i) {
+		sum += samples->values[i];
+	}
+	printf("\"%s\": {\"count\": %zu, \"avg\": %.3f, \"p50\": %.3f, "
+		"\"p99\": %.3f, \"max\": %.3f}", name, samples->len,
+		sum / samples->len, samples->values[samples->len / 2],
+		samples->values[samples->len * 99 / 100],
+		samples->values[samples->len - 1]);
+}
+
+/* Compositor side */
+
+static void view_get_root(struct bench_view *view, struct wlr_surface **root,
+		int *sx, int *sy) {
+	struct wlr_surface *surface = view->surface;
+	*sx = *sy = 0;
+	while (surface->subsurface != NULL) {
+		*sx += surface->current->subsurface_position.x;
+		*sy += surface->current->subsurface_position.y;
+		surface = surface->subsurface->parent;
+	}
+	*root = surface;
+}
+
+static void view_handle_commit(struct wl_listener *listener, void *data) {
+	struct bench_view *view = wl_container_of(listener, view, commit);
+	struct bench_state *state = view->state;
+
+	struct wlr_surface *root;
+	int sx, sy;
+	view_get_root(view, &root, &sx, &sy);
+	struct bench_view *root_view = root->data;
+	if (root_view == NULL) {
+		return;
+	}
+
+	if (root_view->output == NULL) {
+		// First commit of a root surface, place it
+		size_t index = state->roots++;
+		root_view->output = &state->outputs[index % state->outputs_len];
+		int max_x = state->output_width - CLIENT_WIDTH;
+		int max_y = state->output_height - CLIENT_HEIGHT;
+		root_view->x = max_x > 0 ? (int)(index * 97) % max_x : 0;
+		root_view->y = max_y > 0 ? (int)(index * 61) % max_y : 0;
+	}
+
+	pixman_region32_t damage;
+	pixman_region32_init(&damage);
+	pixman_region32_copy(&damage, &view->surface->current->surface_damage);
+	pixman_region32_translate(&damage, root_view->x + sx, root_view->y + sy);
+	wlr_output_damage_add(root_view->output->damage, &damage);
+	pixman_region32_fini(&damage);
+}
+
+static void view_handle_destroy(struct wl_listener *listener, void *data) {
+	struct bench_view *view = wl_container_of(listener, view, destroy);
+	view->surface->data = NULL;
+	wl_list_remove(&view->commit.link);
+	wl_list_remove(&view->destroy.link);
+	wl_list_remove(&view->link);
+	free(view);
+}
+
+static void handle_new_surface(struct wl_listener *listener, void *data) {
+	struct bench_state *state =
+		wl_container_of(listener, state, new_surface);
+	struct wlr_surface *surface = data;
+
+	struct bench_view *view = calloc(1, sizeof(struct bench_view));
+	if (view == NULL) {
+		wlr_log(L_ERROR, "Allocation failed");
+		return;
+	}
+	view->state = state;
+	view->surface = surface;
+	surface->data = view;
+	wl_list_insert(&state->views, &view->link);
+
+	view->commit.notify = view_handle_commit;
+	wl_signal_add(&surface->events.commit, &view->commit);
+	view->destroy.notify = view_handle_destroy;
+	wl_signal_add(&surface->events.destroy, &view->destroy);
+}
+
+struct render_data {
+	struct bench_output *output;
+	pixman_region32_t *damage;
+};
+
+static void scissor_output(struct wlr_output *wlr_output,
+		struct wlr_renderer *renderer, pixman_box32_t *rect) {
+	struct wlr_box box = {
+		.x = rect->x1,
+		.y = rect->y1,
+		.width = rect->x2 - rect->x1,
+		.height = rect->y2 - rect->y1,
+	};
+
+	int ow, oh;
+	wlr_output_transformed_resolution(wlr_output, &ow, &oh);
+
+	// Scissor is in renderer coordinates, ie. upside down
+	enum wl_output_transform transform = wlr_output_transform_compose(
+		wlr_output_transform_invert(wlr_output->transform),
+		WL_OUTPUT_TRANSFORM_FLIPPED_180);
+	wlr_box_transform(&box, transform, ow, oh, &box);
+
+	wlr_renderer_scissor(renderer, &box);
+}
+
+static void render_surface_tree(struct wlr_surface *surface, int x, int y,
+		struct render_data *data) {
+	struct bench_state *state = data->output->state;
+	struct wlr_output *wlr_output = data->output->wlr_output;
+
+	if (wlr_surface_has_buffer(surface)) {
+		struct wlr_box box = {
+			.x = x,
+			.y = y,
+			.width = surface->current->width,
+			.height = surface->current->height,
+		};
+
+		pixman_region32_t damage;
+		pixman_region32_init_rect(&damage, box.x, box.y, box.width,
+			box.height);
+		pixman_region32_intersect(&damage, &damage, data->damage);
+
+		float matrix[16];
+		wlr_matrix_project_box(&matrix, &box,
+			wlr_output_transform_invert(surface->current->transform), 0,
+			&wlr_output->transform_matrix);
+
+		int nrects;
+		pixman_box32_t *rects = pixman_region32_rectangles(&damage, &nrects);
+		for (int i = 0; i < nrects; ++i) {
+			scissor_output(wlr_output, state->renderer, &rects[i]);
+			wlr_render_with_matrix(state->renderer, surface->texture, &matrix,
+				1.0f);
+		}
+		pixman_region32_fini(&damage);
+	}
+
+	struct wlr_subsurface *subsurface;
+	wl_list_for_each_reverse(subsurface, &surface->subsurface_list,
+			parent_link) {
+		render_surface_tree(subsurface->surface,
+			x + subsurface->surface->current->subsurface_position.x,
+			y + subsurface->surface->current->subsurface_position.y, data);
+	}
+}
+
+static void output_handle_frame(struct wl_listener *listener, void *data) {
+	struct bench_output *output = wl_container_of(listener, output, frame);
+	struct bench_state *state = output->state;
+
+	struct bench_view *view;
+	struct timespec start;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	uint64_t allocs = alloc_count;
+
+	bool needs_swap;
+	pixman_region32_t damage;
+	pixman_region32_init(&damage);
+	if (!wlr_output_damage_make_current(output->damage, &needs_swap,
+			&damage)) {
+		goto damage_finish;
+	}
+	if (!needs_swap) {
+		goto damage_finish;
+	}
+
+	wlr_renderer_begin(state->renderer, output->wlr_output);
+
+	int nrects;
+	pixman_box32_t *rects = pixman_region32_rectangles(&damage, &nrects);
+	for (int i = 0; i < nrects; ++i) {
+		scissor_output(output->wlr_output, state->renderer, &rects[i]);
+		wlr_renderer_clear(state->renderer,
+			&(float[]){ 0.25f, 0.25f, 0.25f, 1.0f });
+	}
+
+	struct render_data render_data = {
+		.output = output,
+		.damage = &damage,
+	};
+	wl_list_for_each_reverse(view, &state->views, link) {
+		if (view->output == output) {
+			render_surface_tree(view->surface, view->x, view->y,
+				&render_data);
+		}
+	}
+
+	wlr_renderer_scissor(state->renderer, NULL);
+	wlr_renderer_end(state->renderer);
+	if (!wlr_output_damage_swap_buffers(output->damage, &start, &damage)) {
+		goto damage_finish;
+	}
+
+	samples_add(&state->render, get_elapsed_nsec(&start) / 1000.0);
+	state->render_allocs += alloc_count - allocs;
+
+damage_finish:
+	pixman_region32_fini(&damage);
+
+	// Surfaces get a frame done event even if nothing has been rendered, so
+	// that clients which don't damage anything keep committing
+	wl_list_for_each(view, &state->views, link) {
+		struct wlr_surface *root;
+		int sx, sy;
+		view_get_root(view, &root, &sx, &sy);
+		struct bench_view *root_view = root->data;
+		if (root_view != NULL && root_view->output == output) {
+			wlr_surface_send_frame_done(view->surface, &start);
+		}
+	}
+
+	++output->frames;
+	state->done = true;
+	for (size_t i = 0; i < state->outputs_len; ++i) {
+		if (state->outputs[i].frames < state->frames) {
+			state->done = false;
+		}
+	}
+}
+
+/* Client side */
+
+static void buffer_handle_release(void *data, struct wl_buffer *wl_buffer) {
+	struct bench_buffer *buffer = data;
+	buffer->busy = false;
+}
+
+static const struct wl_buffer_listener buffer_listener = {
+	.release = buffer_handle_release,
+};
+
+static bool buffer_init(struct bench_buffer *buffer, struct wl_shm *shm,
+		int width, int height) {
+	int stride = width * 4;
+	buffer->size = stride * height;
+	buffer->width = width;
+	buffer->height = height;
+
+	char template[] = "/tmp/wlroots-bench-XXXXXX";
+	int fd = mkstemp(template);
+	if (fd < 0) {
+		return false;
+	}
+	unlink(template);
+	int ret;
+	while ((ret = ftruncate(fd, buffer->size)) == -1 && errno == EINTR) {}
+	if (ret < 0) {
+		close(fd);
+		return false;
+	}
+
+	buffer->data = mmap(NULL, buffer->size, PROT_READ | PROT_WRITE,
+		MAP_SHARED, fd, 0);
+	if (buffer->data == MAP_FAILED) {
+		close(fd);
+		return false;
+	}
+
+	struct wl_shm_pool *pool = wl_shm_create_pool(shm, fd, buffer->size);
+	close(fd);
+	buffer->wl_buffer = wl_shm_pool_create_buffer(pool, 0, width, height,
+		stride, WL_SHM_FORMAT_XRGB8888);
+	wl_shm_pool_destroy(pool);
+	wl_buffer_add_listener(buffer->wl_buffer, &buffer_listener, buffer);
+	return true;
+}
+
+static void buffer_fill(struct bench_buffer *buffer, int x, int y, int width,
+		int height, uint32_t color) {
+	for (int j = y; j < y + height && j < buffer->height; ++j) {
+		uint32_t *row = &buffer->data[j * buffer->width];
+		for (int i = x; i < x + width && i < buffer->width; ++i) {
+			row[i] = color;
+		}
+	}
+}
+
+static void client_surface_update(struct bench_client *client,
+		struct bench_client_surface *surface, bool initial) {
+	struct bench_buffer *buffer = &surface->buffers[0];
+	if (buffer->busy) {
+		buffer = &surface->buffers[1];
+	}
+
+	uint32_t color = 0xFF000000 | (uint32_t)(client->commits * 2654435761u);
+	uint64_t n = client->commits;
+	enum damage_pattern pattern =
+		initial ? DAMAGE_FULL : client->state->pattern;
+	switch (pattern) {
+	case DAMAGE_FULL:
+		buffer_fill(buffer, 0, 0, surface->width, surface->height, color);
+		wl_surface_damage(surface->wl_surface, 0, 0, surface->width,
+			surface->height);
+		break;
+	case DAMAGE_PARTIAL:;
+		// A square moving across the surface
+		int x = (n * 8) % (surface->width - 16);
+		int y = (n * 4) % (surface->height - 16);
+		buffer_fill(buffer, x, y, 16, 16, color);
+		wl_surface_damage(surface->wl_surface, x, y, 16, 16);
+		break;
+	case DAMAGE_SCATTERED:
+		for (int i = 0; i < SCATTERED_RECTS; ++i) {
+			int x = ((n + i) * 37) % (surface->width - 4);
+			int y = ((n + i) * 23 + i * 7) % (surface->height - 4);
+			buffer_fill(buffer, x, y, 4, 4, color);
+			wl_surface_damage(surface->wl_surface, x, y, 4, 4);
+		}
+		break;
+	case DAMAGE_NONE:
+		return;
+	}
+
+	wl_surface_attach(surface->wl_surface, buffer->wl_buffer, 0, 0);
+	buffer->busy = true;
+}
+
+static void client_commit(struct bench_client *client, bool initial);
+
+static void frame_handle_done(void *data, struct wl_callback *callback,
+		uint32_t time) {
+	struct bench_client *client = data;
+	wl_callback_destroy(callback);
+	client->frame_callback = NULL;
+
+	samples_add(&client->state->latency,
+		get_elapsed_nsec(&client->commit_time) / 1000.0);
+	client_commit(client, false);
+}
+
+static const struct wl_callback_listener frame_listener = {
+	.done = frame_handle_done,
+};
+
+static void client_commit(struct bench_client *client, bool initial) {
+	// Subsurfaces are synchronized, their state is applied along with the
+	// root surface
+	for (size_t i = client->surfaces_len; i-- > 0;) {
+		struct bench_client_surface *surface = &client->surfaces[i];
+		client_surface_update(client, surface, initial);
+		if (i == 0) {
+			client->frame_callback = wl_surface_frame(surface->wl_surface);
+			wl_callback_add_listener(client->frame_callback, &frame_listener,
+				client);
+			clock_gettime(CLOCK_MONOTONIC, &client->commit_time);
+		}
+		wl_surface_commit(surface->wl_surface);
+	}
+	++client->commits;
+}
+
+static bool client_create_surfaces(struct bench_client *client) {
+	struct bench_state *state = client->state;
+	client->surfaces_len = 1 + state->subsurfaces_len;
+	client->surfaces = calloc(client->surfaces_len,
+		sizeof(struct bench_client_surface));
+	if (client->surfaces == NULL) {
+		return false;
+	}
+
+	for (size_t i = 0; i < client->surfaces_len; ++i) {
+		struct bench_client_surface *surface = &client->surfaces[i];
+		surface->width = i == 0 ? CLIENT_WIDTH : SUBSURFACE_SIZE;
+		surface->height = i == 0 ? CLIENT_HEIGHT : SUBSURFACE_SIZE;
+		surface->wl_surface = wl_compositor_create_surface(client->compositor);
+		for (size_t j = 0; j < 2; ++j) {
+			if (!buffer_init(&surface->buffers[j], client->shm,
+					surface->width, surface->height)) {
+				return false;
+			}
+		}
+
+		if (i > 0) {
+			// Subsurfaces form a binary tree below the root surface
+			struct bench_client_surface *parent =
+				&client->surfaces[(i - 1) / 2];
+			surface->wl_subsurface = wl_subcompositor_get_subsurface(
+				client->subcompositor, surface->wl_surface,
+				parent->wl_surface);
+			wl_subsurface_set_position(surface->wl_subsurface,
+				(i % 2) * SUBSURFACE_SIZE / 2, SUBSURFACE_SIZE / 4);
+		}
+	}
+	return true;
+}
+
+static void registry_handle_global(void *data, struct wl_registry *registry,
+		uint32_t name, const char *interface, uint32_t version) {
+	struct bench_client *client = data;
+	if (strcmp(interface, wl_compositor_interface.name) == 0) {
+		client->compositor =
+			wl_registry_bind(registry, name, &wl_compositor_interface, 1);
+	} else if (strcmp(interface, wl_subcompositor_interface.name) == 0) {
+		client->subcompositor =
+			wl_registry_bind(registry, name, &wl_subcompositor_interface, 1);
+	} else if (strcmp(interface, wl_shm_interface.name) == 0) {
+		client->shm = wl_registry_bind(registry, name, &wl_shm_interface, 1);
+	}
+}
+
+static void registry_handle_global_remove(void *data,
+		struct wl_registry *registry, uint32_t name) {
+	// Who cares?
+}
+
+static const struct wl_registry_listener registry_listener = {
+	.global = registry_handle_global,
+	.global_remove = registry_handle_global_remove,
+};
+
+static void sync_handle_done(void *data, struct wl_callback *callback,
+		uint32_t serial) {
+	struct bench_client *client = data;
+	wl_callback_destroy(callback);
+
+	if (client->compositor == NULL || client->subcompositor == NULL ||
+			client->shm == NULL || !client_create_surfaces(client)) {
+		wlr_log(L_ERROR, "Failed to set up client %zu", client->index);
+		client->state->failed = true;
+		return;
+	}
+	client_commit(client, true);
+}
+
+static const struct wl_callback_listener sync_listener = {
+	.done = sync_handle_done,
+};
+
+static int client_handle_readable(int fd, uint32_t mask, void *data) {
+	struct bench_client *client = data;
+	if (mask & (WL_EVENT_HANGUP | WL_EVENT_ERROR)) {
+		wlr_log(L_ERROR, "Client %zu disconnected", client->index);
+		client->state->failed = true;
+		return 0;
+	}
+
+	while (wl_display_prepare_read(client->display) != 0) {
+		wl_display_dispatch_pending(client->display);
+	}
+	if (wl_display_read_events(client->display) < 0) {
+		wlr_log_errno(L_ERROR, "Failed to read events of client %zu",
+			client->index);
+		client->state->failed = true;
+		return 0;
+	}
+	wl_display_dispatch_pending(client->display);
+	wl_display_flush(client->display);
+	return 0;
+}
+
+static bool client_init(struct bench_client *client, struct bench_state *state,
+		size_t index) {
+	client->state = state;
+	client->index = index;
+
+	int fds[2];
+	if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) < 0) {
+		wlr_log_errno(L_ERROR, "Failed to create socket pair");
+		return false;
+	}
+	if (wl_client_create(state->display, fds[0]) == NULL) {
+		close(fds[0]);
+		close(fds[1]);
+		return false;
+	}
+	client->display = wl_display_connect_to_fd(fds[1]);
+	if (client->display == NULL) {
+		close(fds[1]);
+		return false;
+	}
+
+	// Client events are dispatched by the compositor event loop
+	client->source = wl_event_loop_add_fd(state->loop, fds[1],
+		WL_EVENT_READABLE, client_handle_readable, client);
+
+	struct wl_registry *registry = wl_display_get_registry(client->display);
+	wl_registry_add_listener(registry, &registry_listener, client);
+	struct wl_callback *callback = wl_display_sync(client->display);
+	wl_callback_add_listener(callback, &sync_listener, client);
+	wl_display_flush(client->display);
+	return true;
+}
+
+static void usage(const char *name) {
+	fprintf(stderr, "usage: %s [-o outputs] [-c clients] [-s subsurfaces] "
+		"[-p full|partial|scattered|none] [-f frames] [-w width] "
+		"[-h height] [-r refresh]\n", name);
+}
+
+static void print_results(struct bench_state *state, uint64_t total_frames) {
+	printf("{\"outputs\": %zu, \"clients\": %zu, \"subsurfaces\": %zu, "
+		"\"pattern\": \"%s\", \"frames\": %" PRIu64 ", ", state->outputs_len,
+		state->clients_len, state->subsurfaces_len,
+		damage_pattern_names[state->pattern], total_frames);
+	samples_print("commit_to_frame_done_us", &state->latency);
+	printf(", ");
+	samples_print("render_us", &state->render);
+	printf(", ");
+	samples_print("dispatch_us", &state->dispatch);
+	printf(", \"dispatch_iterations_per_frame\": %.3f",
+		total_frames > 0 ?
+		(double)state->dispatch_iterations / total_frames : 0);
+	if (alloc_count_supported && total_frames > 0) {
+		printf(", \"allocs_per_frame\": %.3f, "
+			"\"render_allocs_per_frame\": %.3f",
+			(double)state->total_allocs / total_frames,
+			(double)state->render_allocs / total_frames);
+	} else {
+		printf(", \"allocs_per_frame\": null, "
+			"\"render_allocs_per_frame\": null");
+	}
+	printf("}\n");
+}
+
+int main(int argc, char *argv[]) {
+	struct bench_state state = {
+		.outputs_len = 1,
+		.clients_len = 4,
+		.subsurfaces_len = 0,
+		.output_width = 1280,
+		.output_height = 720,
+		.refresh = 60,
+		.frames = 300,
+		.pattern = DAMAGE_PARTIAL,
+	};
+
+	int c;
+	while ((c = getopt(argc, argv, "o:c:s:p:f:w:h:r:")) != -1) {
+		switch (c) {
+		case 'o':
+			state.outputs_len = strtoul(optarg, NULL, 10);
+			break;
+		case 'c':
+			state.clients_len = strtoul(optarg, NULL, 10);
+			break;
+		case 's':
+			state.subsurfaces_len = strtoul(optarg, NULL, 10);
+			break;
+		case 'p':;
+			size_t n = sizeof(damage_pattern_names) / sizeof(char *);
+			size_t i = 0;
+			while (i < n && strcmp(optarg, damage_pattern_names[i]) != 0) {
+				++i;
+			}
+			if (i == n) {
+				usage(argv[0]);
+				return EXIT_FAILURE;
+			}
+			state.pattern = i;
+			break;
+		case 'f':
+			state.frames = strtoull(optarg, NULL, 10);
+			break;
+		case 'w':
+			state.output_width = atoi(optarg);
+			break;
+		case 'h':
+			state.output_height = atoi(optarg);
+			break;
+		case 'r':
+			state.refresh = atoi(optarg);
+			break;
+		default:
+			usage(argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+	if (state.outputs_len == 0 || state.output_width <= 0 ||
+			state.output_height <= 0 || state.refresh <= 0) {
+		usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	wlr_log_init(L_ERROR, NULL);
+
+	state.display = wl_display_create();
+	state.loop = wl_display_get_event_loop(state.display);
+	state.backend = wlr_headless_backend_create(state.display);
+	if (state.backend == NULL) {
+		wlr_log(L_ERROR, "Failed to create headless backend");
+		return EXIT_FAILURE;
+	}
+	state.renderer = wlr_backend_get_renderer(state.backend);
+	wl_display_init_shm(state.display);
+	state.compositor = wlr_compositor_create(state.display, state.renderer);
+	wl_list_init(&state.views);
+	state.new_surface.notify = handle_new_surface;
+	wl_signal_add(&state.compositor->events.new_surface, &state.new_surface);
+
+	state.outputs = calloc(state.outputs_len, sizeof(struct bench_output));
+	state.clients = calloc(state.clients_len, sizeof(struct bench_client));
+	if (state.outputs == NULL ||
+			(state.clients_len > 0 && state.clients == NULL)) {
+		wlr_log(L_ERROR, "Allocation failed");
+		return EXIT_FAILURE;
+	}
+
+	for (size_t i = 0; i < state.outputs_len; ++i) {
+		struct bench_output *output = &state.outputs[i];
+		output->state = &state;
+		output->wlr_output = wlr_headless_add_output(state.backend,
+			state.output_width, state.output_height);
+		if (output->wlr_output == NULL) {
+			wlr_log(L_ERROR, "Failed to create output");
+			return EXIT_FAILURE;
+		}
+		wlr_output_set_custom_mode(output->wlr_output, state.output_width,
+			state.output_height, state.refresh * 1000);
+		output->damage = wlr_output_damage_create(output->wlr_output);
+		output->frame.notify = output_handle_frame;
+		wl_signal_add(&output->damage->events.frame, &output->frame);
+	}
+
+	if (!wlr_backend_start(state.backend)) {
+		wlr_log(L_ERROR, "Failed to start backend");
+		return EXIT_FAILURE;
+	}
+
+	for (size_t i = 0; i < state.clients_len; ++i) {
+		if (!client_init(&state.clients[i], &state, i)) {
+			wlr_log(L_ERROR, "Failed to create client %zu", i);
+			return EXIT_FAILURE;
+		}
+	}
+
+	// Warm up until all clients have committed their first frame
+	uint64_t start_allocs = 0;
+	bool warm = false;
+	struct pollfd pollfd = {
+		.fd = wl_event_loop_get_fd(state.loop),
+		.events = POLLIN,
+	};
+	while (!state.done && !state.failed) {
+		wl_display_flush_clients(state.display);
+
+		// Only measure the dispatch itself, not the time spent idle
+		if (poll(&pollfd, 1, -1) < 0 && errno != EINTR) {
+			wlr_log_errno(L_ERROR, "Failed to poll the event loop");
+			state.failed = true;
+			break;
+		}
+		struct timespec start;
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		if (wl_event_loop_dispatch(state.loop, 0) < 0) {
+			wlr_log_errno(L_ERROR, "Failed to dispatch the event loop");
+			state.failed = true;
+			break;
+		}
+
+		if (!warm) {
+			warm = true;
+			for (size_t i = 0; i < state.clients_len; ++i) {
+				warm = warm && state.clients[i].commits > 1;
+			}
+			if (warm) {
+				// Discard the samples of the setup
+				state.latency.len = state.render.len = 0;
+				state.render_allocs = 0;
+				state.dispatch_iterations = 0;
+				for (size_t i = 0; i < state.outputs_len; ++i) {
+					state.outputs[i].frames = 0;
+				}
+				start_allocs = alloc_count;
+			}
+			continue;
+		}
+
+		samples_add(&state.dispatch, get_elapsed_nsec(&start) / 1000.0);
+		++state.dispatch_iterations;
+	}
+	state.total_allocs = alloc_count - start_allocs;
+
+	uint64_t total_frames = 0;
+	for (size_t i = 0; i < state.outputs_len; ++i) {
+		total_frames += state.outputs[i].frames;
+	}
+	print_results(&state, total_frames);
+
+	for (size_t i = 0; i < state.clients_len; ++i) {
+		struct bench_client *client = &state.clients[i];
+		if (client->display != NULL) {
+			wl_event_source_remove(client->source);
+			wl_display_disconnect(client->display);
+		}
+	}
+	wlr_backend_destroy(state.backend);
+	wl_display_destroy(state.display);
+	return state.failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
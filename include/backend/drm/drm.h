@@ -16,6 +16,21 @@
 #include "properties.h"
 #include "renderer.h"
 
+/**
+ * A client buffer imported for direct scanout. The import and its framebuffer
+ * are reused until the wl_buffer is destroyed and no plane uses it anymore.
+ */
+struct wlr_drm_client_buffer {
+	struct wl_resource *buffer; // NULL if destroyed
+	struct wl_listener buffer_destroy;
+	struct gbm_bo *bo;
+
+	size_t n_refs; // planes displaying it or about to
+	struct wlr_buffer_lock *lock; // keeps the client from reusing it
+
+	struct wl_list link; // wlr_drm_backend::client_buffers
+};
+
 struct wlr_drm_plane {
 	uint32_t type;
 	uint32_t id;
@@ -25,6 +40,13 @@ struct wlr_drm_plane {
 	struct wlr_drm_surface surf;
 	struct wlr_drm_surface mgpu_surf;
 
+	// Only used by primary and overlay, client buffers displayed directly. The
+	// pending one replaces the current one on the next page-flip if
+	// scanout_pending is set.
+	struct wlr_drm_client_buffer *pending_scanout;
+	struct wlr_drm_client_buffer *scanout;
+	bool scanout_pending;
+
 	// Only used by cursor
 	float matrix[16];
 	struct wlr_texture *wlr_tex;
@@ -99,6 +121,7 @@ struct wlr_drm_backend {
 	struct wl_listener drm_invalidated;
 
 	struct wl_list outputs;
+	struct wl_list client_buffers; // wlr_drm_client_buffer::link
 
 	struct wlr_drm_renderer renderer;
 	struct wlr_session *session;
@@ -146,6 +169,10 @@ void wlr_drm_scan_connectors(struct wlr_drm_backend *state);
 int wlr_drm_event(int fd, uint32_t mask, void *data);
 
 void wlr_drm_connector_start_renderer(struct wlr_drm_connector *conn);
+// Flips to a client buffer instead of the composited frame, returns false if
+// it can't be scanned out
+bool wlr_drm_connector_scanout_buffer(struct wlr_output *output,
+	struct wl_resource *buffer);
 
 struct wlr_session *wlr_drm_backend_get_session(struct wlr_backend *backend);
 
@@ -10,6 +10,7 @@
 struct wlr_drm_backend;
 struct wlr_drm_connector;
 struct wlr_drm_crtc;
+struct wlr_box;
 
 // Used to provide atomic or legacy DRM functions
 struct wlr_drm_interface {
@@ -23,6 +24,11 @@ struct wlr_drm_interface {
 	// Enable the cursor buffer on crtc. Set bo to NULL to disable
 	bool (*crtc_set_cursor)(struct wlr_drm_backend *drm,
 		struct wlr_drm_crtc *crtc, struct gbm_bo *bo);
+	// Display bo on the overlay plane of crtc at box with the next pageflip.
+	// Set bo to NULL to disable it. NULL if overlay planes aren't supported
+	bool (*crtc_set_overlay)(struct wlr_drm_backend *drm,
+		struct wlr_drm_crtc *crtc, struct gbm_bo *bo,
+		const struct wlr_box *box);
 	// Move the cursor on crtc
 	bool (*crtc_move_cursor)(struct wlr_drm_backend *drm,
 		struct wlr_drm_crtc *crtc, int x, int y);
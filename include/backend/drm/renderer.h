@@ -3,10 +3,13 @@
 
 #include <EGL/egl.h>
 #include <gbm.h>
+#include <pixman.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <wlr/render.h>
 
+#define WLR_DRM_SURFACE_DAMAGE_LEN 4
+
 struct wlr_drm_backend;
 struct wlr_drm_plane;
 
@@ -29,6 +32,11 @@ struct wlr_drm_surface {
 
 	struct gbm_bo *front;
 	struct gbm_bo *back;
+
+	// Only used by multi-GPU copies: bounding boxes of the damage of the
+	// previous frames, most recent first
+	pixman_box32_t previous_damage[WLR_DRM_SURFACE_DAMAGE_LEN];
+	size_t previous_damage_len;
 };
 
 bool wlr_drm_renderer_init(struct wlr_drm_backend *drm,
@@ -49,7 +57,11 @@ struct gbm_bo *wlr_drm_surface_swap_buffers(struct wlr_drm_surface *surf,
 	pixman_region32_t *damage);
 struct gbm_bo *wlr_drm_surface_get_front(struct wlr_drm_surface *surf);
 void wlr_drm_surface_post(struct wlr_drm_surface *surf);
+/**
+ * Copies the src bo, rendered on the parent GPU, to dest. Only the damaged
+ * area is copied if damage isn't NULL.
+ */
 struct gbm_bo *wlr_drm_surface_mgpu_copy(struct wlr_drm_surface *dest,
-	struct gbm_bo *src);
+	struct gbm_bo *src, pixman_region32_t *damage);
 
 #endif
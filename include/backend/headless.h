@@ -1,12 +1,15 @@
 #ifndef BACKEND_HEADLESS_H
 #define BACKEND_HEADLESS_H
 
+#include <pixman.h>
 #include <wlr/backend/headless.h>
 #include <wlr/backend/interface.h>
+#include <wlr/render/egl.h>
 
 struct wlr_headless_backend {
 	struct wlr_backend backend;
 	struct wlr_egl egl;
+	bool has_egl; // outputs are memory-backed if false
 	struct wlr_renderer *renderer;
 	struct wl_display *display;
 	struct wl_list outputs;
@@ -22,6 +25,8 @@ struct wlr_headless_output {
 	struct wl_list link;
 
 	void *egl_surface;
+	pixman_image_t *image; // if the backend doesn't use EGL
+	bool image_rendered;
 	struct wl_event_source *frame_timer;
 	int frame_delay; // ms
 };
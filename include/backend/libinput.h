@@ -7,6 +7,7 @@
 #include <wlr/interfaces/wlr_input_device.h>
 #include <wlr/types/wlr_input_device.h>
 #include <wlr/types/wlr_list.h>
+#include <wlr/types/wlr_pointer.h>
 
 struct wlr_libinput_backend {
 	struct wlr_backend backend;
@@ -21,6 +22,10 @@ struct wlr_libinput_backend {
 	struct wl_listener session_signal;
 
 	struct wlr_list wlr_device_lists; // list of struct wl_list
+
+	// relative motion accumulated during the current dispatch, the device is
+	// NULL if there is none
+	struct wlr_event_pointer_motion pending_motion;
 };
 
 struct wlr_libinput_input_device {
@@ -43,8 +48,12 @@ void handle_keyboard_key(struct libinput_event *event,
 
 struct wlr_pointer *wlr_libinput_pointer_create(
 		struct libinput_device *device);
-void handle_pointer_motion(struct libinput_event *event,
-		struct libinput_device *device);
+void handle_pointer_motion(struct wlr_libinput_backend *backend,
+		struct libinput_event *event, struct libinput_device *device);
+/**
+ * Emits the relative motion accumulated since the last flush, if any.
+ */
+void wlr_libinput_flush_pointer_motion(struct wlr_libinput_backend *backend);
 void handle_pointer_motion_abs(struct libinput_event *event,
 		struct libinput_device *device);
 void handle_pointer_button(struct libinput_event *event,
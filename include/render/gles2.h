@@ -23,15 +23,64 @@ struct pixel_format {
 	GLuint *shader;
 };
 
+/**
+ * Quads sharing the same program, texture and uniforms, queued between
+ * wlr_renderer_begin and wlr_renderer_end. Each vertex is made of a position
+ * in normalized device coordinates and a texture coordinate.
+ */
+struct gles2_batch {
+	GLuint program;
+	struct wlr_texture *texture; // NULL for colored quads
+	float alpha;
+	float color[4];
+
+	GLfloat *verts;
+	size_t len, cap; // in floats
+};
+
+/**
+ * A pending asynchronous read: the pixels are copied to a pixel buffer object,
+ * which is mapped once the fence is signaled.
+ */
+struct gles2_read_request {
+	struct wlr_gles2_renderer *renderer;
+	struct wl_list link; // wlr_gles2_renderer::read_requests
+
+	struct wl_event_source *timer;
+	GLuint pbo;
+	EGLSyncKHR fence;
+	uint32_t height, stride;
+
+	wlr_renderer_read_pixels_func_t done;
+	void *data;
+};
+
 struct wlr_gles2_renderer {
 	struct wlr_renderer wlr_renderer;
 
 	struct wlr_egl *egl;
+
+	// Only set between begin and end, quads are drawn immediately otherwise
+	struct wlr_output *current_output;
+	int viewport_width, viewport_height;
+
+	struct {
+		bool enabled;
+		struct wlr_box box;
+	} scissor;
+
+	GLuint vbo;
+	struct gles2_batch batch;
+
+	// Set if pixel buffer objects and fences are supported
+	bool has_async_read;
+	struct wl_list read_requests; // gles2_read_request::link
 };
 
 struct wlr_gles2_texture {
 	struct wlr_texture wlr_texture;
 
+	struct wlr_gles2_renderer *renderer;
 	struct wlr_egl *egl;
 	GLuint tex_id;
 	const struct pixel_format *pixel_format;
@@ -50,7 +99,14 @@ extern struct shaders shaders;
 
 const struct pixel_format *gl_format_for_wl_format(enum wl_shm_format fmt);
 
-struct wlr_texture *gles2_texture_create();
+struct wlr_texture *gles2_texture_create(
+	struct wlr_gles2_renderer *renderer);
+/**
+ * Draws the queued quads if they use the texture, which is about to change or
+ * be destroyed.
+ */
+void gles2_renderer_flush_texture(struct wlr_gles2_renderer *renderer,
+	struct wlr_texture *texture);
 
 extern const GLchar quad_vertex_src[];
 extern const GLchar quad_fragment_src[];
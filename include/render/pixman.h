@@ -0,0 +1,30 @@
+#ifndef RENDER_PIXMAN_H
+#define RENDER_PIXMAN_H
+
+#include <pixman.h>
+#include <stdbool.h>
+#include <wayland-server-protocol.h>
+#include <wlr/render.h>
+#include <wlr/render/interface.h>
+#include <wlr/render/pixman.h>
+
+struct wlr_pixman_renderer {
+	struct wlr_renderer wlr_renderer;
+
+	pixman_image_t *image; // not owned, bound by the backend
+};
+
+struct wlr_pixman_texture {
+	struct wlr_texture wlr_texture;
+
+	pixman_image_t *image;
+};
+
+/**
+ * Returns the pixman format matching a wl_shm format, or 0 if unsupported.
+ */
+pixman_format_code_t pixman_format_for_wl_format(enum wl_shm_format fmt);
+
+struct wlr_texture *pixman_texture_create();
+
+#endif
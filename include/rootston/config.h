@@ -5,6 +5,8 @@
 #include <wlr/types/wlr_output_layout.h>
 
 #define ROOTS_CONFIG_DEFAULT_SEAT_NAME "seat0"
+#define ROOTS_CONFIG_RENDER_TIME_AUTO -1
+#define ROOTS_CONFIG_BINDING_BUCKETS 256 // must be a power of two
 
 struct roots_output_config {
 	char *name;
@@ -12,6 +14,9 @@ struct roots_output_config {
 	enum wl_output_transform transform;
 	int x, y;
 	float scale;
+	// ms to keep for rendering before the next vblank, zero to render as soon
+	// as possible or ROOTS_CONFIG_RENDER_TIME_AUTO to measure it
+	int max_render_time;
 	struct wl_list link;
 	struct {
 		int width, height;
@@ -30,10 +35,11 @@ struct roots_device_config {
 
 struct roots_binding_config {
 	uint32_t modifiers;
-	xkb_keysym_t *keysyms;
+	xkb_keysym_t *keysyms; // sorted
 	size_t keysyms_len;
 	char *command;
 	struct wl_list link;
+	struct wl_list bucket_link; // roots_config::binding_buckets
 };
 
 struct roots_keyboard_config {
@@ -60,10 +66,12 @@ struct roots_cursor_config {
 
 struct roots_config {
 	bool xwayland;
+	bool xwayland_lazy;
 
 	struct wl_list outputs;
 	struct wl_list devices;
 	struct wl_list bindings;
+	struct wl_list binding_buckets[ROOTS_CONFIG_BINDING_BUCKETS];
 	struct wl_list keyboards;
 	struct wl_list cursors;
 	char *config_path;
@@ -82,6 +90,19 @@ struct roots_config *roots_config_create_from_args(int argc, char *argv[]);
  */
 void roots_config_destroy(struct roots_config *config);
 
+/**
+ * Sort keysyms in place, in the order expected by roots_config_get_binding.
+ */
+void roots_keysyms_sort(xkb_keysym_t *keysyms, size_t len);
+
+/**
+ * Get the binding triggered by the modifiers and the sorted set of keysyms. If
+ * there is no such binding, returns NULL.
+ */
+struct roots_binding_config *roots_config_get_binding(
+	struct roots_config *config, uint32_t modifiers,
+	const xkb_keysym_t *keysyms, size_t keysyms_len);
+
 /**
  * Get configuration for the output. If the output is not configured, returns
  * NULL.
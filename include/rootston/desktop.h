@@ -10,6 +10,7 @@
 #include <wlr/types/wlr_list.h>
 #include <wlr/types/wlr_output_layout.h>
 #include <wlr/types/wlr_output.h>
+#include <wlr/types/wlr_presentation_time.h>
 #include <wlr/types/wlr_primary_selection.h>
 #include <wlr/types/wlr_screenshooter.h>
 #include <wlr/types/wlr_wl_shell.h>
@@ -23,9 +24,11 @@
 #include "rootston/config.h"
 #include "rootston/output.h"
 #include "rootston/view.h"
+#include "rootston/view_grid.h"
 
 struct roots_desktop {
 	struct wl_list views; // roots_view::link
+	struct roots_view_grid view_grid;
 
 	struct wl_list outputs; // roots_output::link
 	struct timespec last_frame;
@@ -46,6 +49,7 @@ struct roots_desktop {
 	struct wlr_primary_selection_device_manager *primary_selection_device_manager;
 	struct wlr_idle *idle;
 	struct wlr_idle_inhibit_manager_v1 *idle_inhibit;
+	struct wlr_presentation *presentation;
 
 	struct wl_listener new_output;
 	struct wl_listener layout_change;
@@ -68,6 +72,13 @@ struct roots_desktop *desktop_create(struct roots_server *server,
 void desktop_destroy(struct roots_desktop *desktop);
 struct roots_output *desktop_output_from_wlr_output(
 	struct roots_desktop *desktop, struct wlr_output *output);
+/**
+ * Inserts the view on top of all others, or raises it if it's already there.
+ */
+void desktop_insert_view(struct roots_desktop *desktop,
+	struct roots_view *view);
+void desktop_remove_view(struct roots_desktop *desktop,
+	struct roots_view *view);
 struct roots_view *desktop_view_at(struct roots_desktop *desktop, double lx,
 	double ly, struct wlr_surface **surface, double *sx, double *sy);
 
@@ -78,6 +89,7 @@ void view_apply_damage(struct roots_view *view);
 void view_damage_whole(struct roots_view *view);
 void view_update_position(struct roots_view *view, double x, double y);
 void view_update_size(struct roots_view *view, uint32_t width, uint32_t height);
+void view_update_outputs(struct roots_view *view);
 
 void handle_xdg_shell_v6_surface(struct wl_listener *listener, void *data);
 void handle_xdg_shell_surface(struct wl_listener *listener, void *data);
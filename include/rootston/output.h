@@ -7,6 +7,7 @@
 #include <wlr/types/wlr_output_damage.h>
 
 struct roots_desktop;
+struct wlr_surface;
 
 struct roots_output {
 	struct roots_desktop *desktop;
@@ -15,19 +16,34 @@ struct roots_output {
 
 	struct roots_view *fullscreen_view;
 
+	// the overlay plane box of the last frame, see render_output
+	bool overlay_active;
+	struct wlr_box overlay_box;
+
 	struct timespec last_frame;
 	struct wlr_output_damage *damage;
 
+	int max_render_time; // see roots_output_config::max_render_time
+	struct timespec last_present;
+	struct wl_event_source *repaint_timer;
+
 	struct wl_listener destroy;
 	struct wl_listener damage_frame;
 	struct wl_listener damage_destroy;
+	struct wl_listener present;
 };
 
+typedef void (*surface_iterator_func_t)(struct wlr_surface *surface,
+	double lx, double ly, float rotation, void *data);
+
 void handle_new_output(struct wl_listener *listener, void *data);
 
 struct roots_view;
 struct roots_drag_icon;
 
+void view_for_each_surface(struct roots_view *view,
+	surface_iterator_func_t iterator, void *user_data);
+
 void output_damage_whole(struct roots_output *output);
 void output_damage_whole_view(struct roots_output *output,
 	struct roots_view *view);
@@ -126,6 +126,14 @@ struct roots_view {
 	struct wlr_surface *wlr_surface;
 	struct wl_list children; // roots_view_child::link
 
+	struct {
+		bool added, linked;
+		struct wl_list dirty_link; // roots_view_grid::dirty
+		struct wlr_box bounds; // in layout coordinates, if linked
+		int x1, y1, x2, y2; // cells covered by the view, if linked
+		uint32_t z;
+	} grid;
+
 	struct wl_listener new_subsurface;
 
 	struct {
@@ -0,0 +1,62 @@
+#ifndef ROOTSTON_VIEW_GRID_H
+#define ROOTSTON_VIEW_GRID_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <wayland-server.h>
+
+#define ROOTS_VIEW_GRID_CELL_SIZE 512 // in layout coordinates
+#define ROOTS_VIEW_GRID_BUCKETS 64 // must be a power of two
+
+struct roots_view;
+struct wlr_box;
+
+struct roots_view_grid_cell {
+	struct wl_list link; // roots_view_grid::buckets
+	int x, y;
+
+	// Views whose bounds overlap this cell, from front to back
+	struct roots_view **views;
+	size_t len, cap;
+};
+
+/**
+ * A uniform grid over the layout, mapping each cell to the views which may
+ * accept input in it. Only non-empty cells are stored, in a hash table. The
+ * bounds of each view are kept as well, to find the views on an output.
+ *
+ * Views are re-indexed lazily: changes only mark them dirty, the grid is
+ * updated on the next lookup.
+ */
+struct roots_view_grid {
+	struct wl_list buckets[ROOTS_VIEW_GRID_BUCKETS];
+	struct wl_list dirty; // roots_view::grid.dirty_link
+	uint32_t next_z;
+};
+
+void view_grid_init(struct roots_view_grid *grid);
+/**
+ * Adds a view on top of all others, or moves it there if it is already in the
+ * grid.
+ */
+void view_grid_add(struct roots_view_grid *grid, struct roots_view *view);
+void view_grid_remove(struct roots_view_grid *grid, struct roots_view *view);
+/**
+ * Notifies the grid that the view bounds may have changed.
+ */
+void view_grid_update(struct roots_view_grid *grid, struct roots_view *view);
+/**
+ * Returns the views which may accept input at the given point, from front to
+ * back. The array is valid until the grid is modified.
+ */
+struct roots_view **view_grid_views_at(struct roots_view_grid *grid,
+	double lx, double ly, size_t *len);
+/**
+ * Returns whether the view may be displayed in the box, in layout
+ * coordinates. The bounds of the view are only recomputed after it changed.
+ */
+bool view_grid_view_intersects(struct roots_view_grid *grid,
+	struct roots_view *view, const struct wlr_box *box);
+
+#endif
@@ -23,6 +23,15 @@ struct wlr_output_impl {
 	void (*set_gamma)(struct wlr_output *output,
 		uint32_t size, uint16_t *r, uint16_t *g, uint16_t *b);
 	uint32_t (*get_gamma_size)(struct wlr_output *output);
+	// Display the client buffer instead of the composited frame. Returns false
+	// if the buffer can't be scanned out, in which case the frame is
+	// composited as usual.
+	bool (*scanout_buffer)(struct wlr_output *output,
+		struct wl_resource *buffer);
+	// Display the client buffer on an overlay plane at box, starting with the
+	// next frame. Set buffer to NULL to disable the overlay plane.
+	bool (*set_overlay)(struct wlr_output *output, struct wl_resource *buffer,
+		const struct wlr_box *box);
 };
 
 void wlr_output_init(struct wlr_output *output, struct wlr_backend *backend,
@@ -34,5 +43,12 @@ void wlr_output_update_custom_mode(struct wlr_output *output, int32_t width,
 void wlr_output_update_enabled(struct wlr_output *output, bool enabled);
 void wlr_output_update_needs_swap(struct wlr_output *output);
 void wlr_output_send_frame(struct wlr_output *output);
+/**
+ * Notifies that the last swapped frame has been presented. `when` may be NULL
+ * if the time is unknown, `seq` is the vblank sequence number or zero and
+ * `flags` is a bitfield of enum wlr_output_present_flag.
+ */
+void wlr_output_send_present(struct wlr_output *output, struct timespec *when,
+	unsigned seq, uint32_t flags);
 
 #endif
@@ -3,6 +3,7 @@
 
 #include <EGL/egl.h>
 #include <EGL/eglext.h>
+#include <pixman.h>
 #include <stdint.h>
 #include <wayland-server-protocol.h>
 #include <wlr/types/wlr_box.h>
@@ -67,6 +68,22 @@ bool wlr_renderer_buffer_is_drm(struct wlr_renderer *renderer,
 bool wlr_renderer_read_pixels(struct wlr_renderer *r, enum wl_shm_format fmt,
 	uint32_t stride, uint32_t width, uint32_t height,
 	uint32_t src_x, uint32_t src_y, uint32_t dst_x, uint32_t dst_y, void *data);
+/**
+ * Called when an asynchronous read is complete. `pixels` points to the first
+ * (top) row and is only valid during the call, rows are `stride` bytes apart
+ * (`stride` can be negative). `pixels` is NULL if the read failed.
+ */
+typedef void (*wlr_renderer_read_pixels_func_t)(const void *pixels,
+	int32_t stride, void *data);
+/**
+ * Starts reading out pixels of the currently bound surface without waiting for
+ * the GPU. `done` is called from `loop` once the pixels are available, and is
+ * always called exactly once if this function returns true.
+ */
+bool wlr_renderer_read_pixels_async(struct wlr_renderer *r,
+	struct wl_event_loop *loop, enum wl_shm_format fmt,
+	uint32_t width, uint32_t height, uint32_t src_x, uint32_t src_y,
+	wlr_renderer_read_pixels_func_t done, void *data);
 /**
  * Checks if a format is supported.
  */
@@ -130,6 +147,14 @@ bool wlr_texture_upload_eglimage(struct wlr_texture *tex,
  */
 bool wlr_texture_update_shm(struct wlr_texture *surf, uint32_t format,
 		int x, int y, int width, int height, struct wl_shm_buffer *shm);
+/**
+ * Copies a region of pixels from a wl_shm_buffer onto the texture, in as few
+ * uploads as possible. Nearby rectangles may be merged, therefore the entire
+ * buffer must be valid. The buffer is not accessed after this function
+ * returns.
+ */
+bool wlr_texture_update_shm_region(struct wlr_texture *tex, uint32_t format,
+		pixman_region32_t *region, struct wl_shm_buffer *shm);
 /**
  * Prepares a matrix with the appropriate scale for the given texture and
  * multiplies it with the projection, producing a matrix that the shader can
@@ -35,6 +35,10 @@ struct wlr_renderer_impl {
 		uint32_t stride, uint32_t width, uint32_t height,
 		uint32_t src_x, uint32_t src_y, uint32_t dst_x, uint32_t dst_y,
 		void *data);
+	bool (*read_pixels_async)(struct wlr_renderer *renderer,
+		struct wl_event_loop *loop, enum wl_shm_format fmt,
+		uint32_t width, uint32_t height, uint32_t src_x, uint32_t src_y,
+		wlr_renderer_read_pixels_func_t done, void *data);
 	bool (*format_supported)(struct wlr_renderer *renderer,
 		enum wl_shm_format fmt);
 	void (*destroy)(struct wlr_renderer *renderer);
@@ -54,6 +58,8 @@ struct wlr_texture_impl {
 		struct wl_shm_buffer *shm);
 	bool (*update_shm)(struct wlr_texture *texture, uint32_t format,
 		int x, int y, int width, int height, struct wl_shm_buffer *shm);
+	bool (*update_shm_region)(struct wlr_texture *texture, uint32_t format,
+		pixman_region32_t *region, struct wl_shm_buffer *shm);
 	bool (*upload_drm)(struct wlr_texture *texture,
 		struct wl_resource *drm_buf);
 	bool (*upload_eglimage)(struct wlr_texture *texture, EGLImageKHR image,
@@ -0,0 +1,20 @@
+#ifndef WLR_RENDER_PIXMAN_H
+#define WLR_RENDER_PIXMAN_H
+
+#include <pixman.h>
+#include <wlr/render.h>
+
+/**
+ * Creates a renderer drawing on the CPU into memory, it doesn't need EGL.
+ */
+struct wlr_renderer *wlr_pixman_renderer_create(void);
+/**
+ * Sets the image subsequent rendering operations draw into. The image must
+ * stay alive until another image is bound. Passing NULL unbinds the current
+ * image.
+ */
+void wlr_pixman_renderer_bind_image(struct wlr_renderer *renderer,
+	pixman_image_t *image);
+bool wlr_renderer_is_pixman(struct wlr_renderer *renderer);
+
+#endif
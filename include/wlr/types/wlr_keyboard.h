@@ -31,6 +31,7 @@ enum wlr_keyboard_modifier {
 #define WLR_KEYBOARD_KEYS_CAP 32
 
 struct wlr_keyboard_impl;
+struct wlr_keyboard_keymap_file;
 
 struct wlr_keyboard_modifiers {
 	xkb_mod_mask_t depressed;
@@ -43,8 +44,12 @@ struct wlr_keyboard {
 	struct wlr_keyboard_impl *impl;
 	// TODO: Should this store key repeat info too?
 
+	// read-only, shared with keyboards having an identical keymap
 	int keymap_fd;
 	size_t keymap_size;
+	// equal for keyboards sharing the same keymap file, zero if none
+	uint64_t keymap_serial;
+	struct wlr_keyboard_keymap_file *keymap_file;
 	struct xkb_keymap *keymap;
 	struct xkb_state *xkb_state;
 	xkb_led_index_t led_indexes[WLR_LED_COUNT];
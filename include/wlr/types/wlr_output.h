@@ -6,6 +6,7 @@
 #include <time.h>
 #include <wayland-server.h>
 #include <wayland-util.h>
+#include <wlr/types/wlr_box.h>
 
 struct wlr_output_mode {
 	uint32_t flags; // enum wl_output_mode
@@ -36,6 +37,59 @@ struct wlr_output_cursor {
 	} events;
 };
 
+#define WLR_OUTPUT_TIMINGS_LEN 64
+
+/**
+ * Timings of a single frame. Timestamps are taken from CLOCK_MONOTONIC and are
+ * zero when unknown.
+ */
+struct wlr_output_frame_timing {
+	uint64_t frame; // sequence number, starting at 1
+
+	struct timespec render_start; // wlr_output_make_current
+	struct timespec render_end; // wlr_output_swap_buffers
+	struct timespec submit; // buffers handed to the backend
+	struct timespec present; // reported by the backend, e.g. page-flip
+
+	bool presented;
+	uint32_t vblank_seq; // only if presented and provided by the backend
+	// vblanks between submission and presentation, over the first one
+	uint32_t missed_vblanks;
+	uint64_t damage_area; // in buffer pixels
+};
+
+/**
+ * A ring buffer of the most recent frame timings.
+ */
+struct wlr_output_timings {
+	struct wlr_output_frame_timing frames[WLR_OUTPUT_TIMINGS_LEN];
+	size_t idx; // index of the last started frame
+	uint64_t frame_count;
+	uint64_t missed_vblanks; // total since the output has been created
+
+	// the frame waiting to be presented, if any
+	struct wlr_output_frame_timing *pending_present;
+};
+
+enum wlr_output_present_flag {
+	// The presentation was synchronized to the vertical retrace
+	WLR_OUTPUT_PRESENT_VSYNC = 0x1,
+	// The timestamp comes from the display hardware
+	WLR_OUTPUT_PRESENT_HW_CLOCK = 0x2,
+	// The completion of the presentation was signaled by the display hardware
+	WLR_OUTPUT_PRESENT_HW_COMPLETION = 0x4,
+	// The client buffer was scanned out directly, without a copy
+	WLR_OUTPUT_PRESENT_ZERO_COPY = 0x8,
+};
+
+struct wlr_output_event_present {
+	struct wlr_output *output;
+	struct timespec *when; // CLOCK_MONOTONIC
+	unsigned seq; // vblank sequence number, zero if unknown
+	int refresh; // nsec until the next refresh, zero if unknown
+	uint32_t flags; // enum wlr_output_present_flag
+};
+
 struct wlr_output_impl;
 
 /**
@@ -76,12 +130,17 @@ struct wlr_output {
 	// damage for cursors and fullscreen surface, in output-local coordinates
 	pixman_region32_t damage;
 	bool frame_pending;
+	// a frame has been submitted and not presented yet
+	bool present_pending;
 	float transform_matrix[16];
 
+	struct wlr_output_timings timings;
+
 	struct {
 		struct wl_signal frame;
 		struct wl_signal needs_swap;
 		struct wl_signal swap_buffers;
+		struct wl_signal present; // wlr_output_event_present
 		struct wl_signal enable;
 		struct wl_signal mode;
 		struct wl_signal scale;
@@ -95,6 +154,18 @@ struct wlr_output {
 	struct wl_listener fullscreen_surface_commit;
 	struct wl_listener fullscreen_surface_destroy;
 	int fullscreen_width, fullscreen_height;
+	// true if the last frame scanned out the fullscreen surface buffer
+	bool fullscreen_scanout;
+	// composited frames since the last scanout, -1 if there was none
+	int composited_since_scanout;
+
+	// surface attached to the overlay plane for the frame being rendered
+	struct wlr_surface *overlay_surface;
+	// true if the overlay plane displays a client buffer
+	bool overlay_enabled;
+	struct wlr_box overlay_box;
+	struct wl_resource *overlay_buffer; // NULL if destroyed
+	struct wl_listener overlay_buffer_destroy;
 
 	struct wl_list cursors; // wlr_output_cursor::link
 	struct wlr_output_cursor *hardware_cursor;
@@ -147,6 +218,16 @@ bool wlr_output_make_current(struct wlr_output *output, int *buffer_age);
  */
 bool wlr_output_swap_buffers(struct wlr_output *output, struct timespec *when,
 	pixman_region32_t *damage);
+/**
+ * Returns the timings of the frame started `age` frames ago, 0 being the most
+ * recent one. Returns NULL if the frame isn't recorded anymore.
+ */
+const struct wlr_output_frame_timing *wlr_output_get_frame_timing(
+	struct wlr_output *output, size_t age);
+/**
+ * Logs a summary of the recorded frame timings.
+ */
+void wlr_output_log_timings(struct wlr_output *output);
 /**
  * Manually schedules a `frame` event. If a `frame` event is already pending,
  * it is a no-op.
@@ -157,6 +238,15 @@ void wlr_output_set_gamma(struct wlr_output *output,
 uint32_t wlr_output_get_gamma_size(struct wlr_output *output);
 void wlr_output_set_fullscreen_surface(struct wlr_output *output,
 	struct wlr_surface *surface);
+/**
+ * Displays the surface on an overlay plane, above the frame being rendered.
+ * `box` is in output-buffer coordinates and nothing else must be displayed
+ * there. Returns false if the backend can't do it, in which case the surface
+ * must be rendered as usual. Must be called after `wlr_output_make_current`
+ * for each frame the surface should stay on the overlay plane.
+ */
+bool wlr_output_attach_overlay(struct wlr_output *output,
+	struct wlr_surface *surface, const struct wlr_box *box);
 struct wlr_output *wlr_output_from_resource(struct wl_resource *resource);
 
 
@@ -2,15 +2,18 @@
 #define WLR_TYPES_WLR_OUTPUT_DAMAGE_H
 
 #include <pixman.h>
+#include <stdint.h>
 #include <time.h>
 #include <wlr/types/wlr_output.h>
 
 /**
  * Damage tracking requires to keep track of previous frames' damage. To allow
  * damage tracking to work with triple buffering, a history of two frames is
- * required.
+ * required. The history grows if the backend reports older buffers, up to
+ * WLR_OUTPUT_DAMAGE_MAX_PREVIOUS_LEN frames.
  */
 #define WLR_OUTPUT_DAMAGE_PREVIOUS_LEN 2
+#define WLR_OUTPUT_DAMAGE_MAX_PREVIOUS_LEN 8
 
 /**
  * Tracks damage for an output.
@@ -26,9 +29,19 @@ struct wlr_output_damage {
 	pixman_region32_t current; // in output-local coordinates
 
 	// circular queue for previous damage
-	pixman_region32_t previous[WLR_OUTPUT_DAMAGE_PREVIOUS_LEN];
+	pixman_region32_t *previous;
+	size_t previous_len;
 	size_t previous_idx;
 
+	struct {
+		uint64_t frames;
+		// Frames repainted in full because the buffer age was unknown
+		uint64_t full_damage_new_buffer;
+		// Frames repainted in full because the buffer was older than the
+		// damage history
+		uint64_t full_damage_old_buffer;
+	} stats;
+
 	struct {
 		struct wl_signal frame;
 		struct wl_signal destroy;
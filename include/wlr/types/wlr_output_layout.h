@@ -64,6 +64,15 @@ bool wlr_output_layout_contains_point(struct wlr_output_layout *layout,
 bool wlr_output_layout_intersects(struct wlr_output_layout *layout,
 		struct wlr_output *reference, const struct wlr_box *target_box);
 
+/**
+ * Get the outputs intersecting the box, in layout order. At most `outputs_len`
+ * outputs are written to `outputs`, and the number of intersecting outputs is
+ * returned.
+ */
+size_t wlr_output_layout_outputs_in_box(struct wlr_output_layout *layout,
+		const struct wlr_box *box, struct wlr_output **outputs,
+		size_t outputs_len);
+
 /**
  * Get the closest point on this layout from the given point from the reference
  * output. If reference is NULL, gets the closest point from the entire layout.
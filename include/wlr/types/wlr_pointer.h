@@ -24,6 +24,8 @@ struct wlr_event_pointer_motion {
 	struct wlr_input_device *device;
 	uint32_t time_msec;
 	double delta_x, delta_y;
+	// without pointer acceleration, in the same units
+	double unaccel_dx, unaccel_dy;
 };
 
 struct wlr_event_pointer_motion_absolute {
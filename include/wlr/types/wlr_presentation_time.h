@@ -0,0 +1,70 @@
+#ifndef WLR_TYPES_WLR_PRESENTATION_TIME_H
+#define WLR_TYPES_WLR_PRESENTATION_TIME_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+#include <wayland-server.h>
+
+struct wlr_output;
+struct wlr_output_event_present;
+struct wlr_surface;
+
+struct wlr_presentation {
+	struct wl_global *global;
+	struct wl_list resources; // wl_resource_get_link
+	struct wl_list feedbacks; // wlr_presentation_feedback::link
+	clockid_t clock;
+
+	struct {
+		struct wl_signal destroy;
+	} events;
+
+	struct wl_listener display_destroy;
+};
+
+struct wlr_presentation_feedback {
+	struct wl_resource *resource;
+	struct wlr_presentation *presentation;
+	struct wlr_surface *surface;
+	// true once the content update this feedback is about has been committed
+	bool committed;
+	// the output whose submitted frame contains the content update, if any
+	struct wlr_output *output;
+	struct wl_list link; // wlr_presentation::feedbacks
+
+	struct wl_listener surface_commit;
+	struct wl_listener surface_destroy;
+	struct wl_listener output_destroy;
+};
+
+struct wlr_presentation_event {
+	struct wlr_output *output;
+	uint64_t tv_sec;
+	uint32_t tv_nsec;
+	uint32_t refresh; // nsec, zero if unknown
+	uint64_t seq;
+	uint32_t flags; // enum wlr_output_present_flag
+};
+
+struct wlr_presentation *wlr_presentation_create(struct wl_display *display);
+void wlr_presentation_destroy(struct wlr_presentation *presentation);
+/**
+ * Marks the committed content updates of the surface as part of the frame
+ * submitted to the output. Compositors should call this for each surface
+ * displayed by an output after a successful `wlr_output_swap_buffers`.
+ */
+void wlr_presentation_surface_sampled(struct wlr_presentation *presentation,
+	struct wlr_surface *surface, struct wlr_output *output);
+/**
+ * Sends presentation feedback to the content updates which are part of the
+ * frame presented by the output. Compositors should call this when the output
+ * `present` event is emitted.
+ */
+void wlr_presentation_send_output_presented(
+	struct wlr_presentation *presentation,
+	struct wlr_presentation_event *event);
+void wlr_presentation_event_from_output(struct wlr_presentation_event *event,
+	const struct wlr_output_event_present *output_event);
+
+#endif
@@ -145,6 +145,8 @@ struct wlr_seat_pointer_state {
 struct wlr_seat_keyboard_state {
 	struct wlr_seat *seat;
 	struct wlr_keyboard *keyboard;
+	// wlr_keyboard::keymap_serial of the keymap last sent to clients
+	uint64_t keymap_serial;
 
 	struct wlr_seat_client *focused_client;
 	struct wlr_surface *focused_surface;
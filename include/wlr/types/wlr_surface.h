@@ -63,6 +63,13 @@ struct wlr_subsurface {
 	} events;
 };
 
+struct wlr_surface_output {
+	struct wlr_surface *surface;
+	struct wlr_output *output;
+	struct wl_list link; // wlr_surface::current_outputs
+	struct wl_listener output_destroy;
+};
+
 struct wlr_surface {
 	struct wl_resource *resource;
 	struct wlr_renderer *renderer;
@@ -93,6 +100,9 @@ struct wlr_surface {
 
 	// wlr_subsurface::parent_pending_link
 	struct wl_list subsurface_pending_list;
+
+	// outputs the surface has entered, see wlr_surface_send_enter
+	struct wl_list current_outputs; // wlr_surface_output::link
 	void *data;
 };
 
@@ -147,15 +157,35 @@ struct wlr_surface *wlr_surface_get_main_surface(struct wlr_surface *surface);
 struct wlr_subsurface *wlr_surface_subsurface_at(struct wlr_surface *surface,
 		double sx, double sy, double *sub_x, double *sub_y);
 
+/**
+ * Tell the client the surface entered the output. Nothing is sent if it
+ * already did, so this can be called whenever the surface may have moved.
+ */
 void wlr_surface_send_enter(struct wlr_surface *surface,
 		struct wlr_output *output);
 
+/**
+ * Tell the client the surface left the output. Nothing is sent if it hasn't
+ * entered it.
+ */
 void wlr_surface_send_leave(struct wlr_surface *surface,
 		struct wlr_output *output);
 
 void wlr_surface_send_frame_done(struct wlr_surface *surface,
 		const struct timespec *when);
 
+struct wlr_buffer_lock;
+
+/**
+ * Keeps surfaces from releasing the buffer to its client while it is used
+ * elsewhere, e.g. scanned out. If a surface lets go of the buffer in the
+ * meantime, it is released when the last lock is dropped. Returns NULL on
+ * allocation failure.
+ */
+struct wlr_buffer_lock *wlr_surface_lock_buffer(struct wl_resource *buffer);
+
+void wlr_surface_unlock_buffer(struct wlr_buffer_lock *lock);
+
 /**
  * Set a callback for surface commit that runs before all the other callbacks.
  * This is intended for use by the surface role.
@@ -19,6 +19,16 @@ void wlr_region_scale(pixman_region32_t *dst, pixman_region32_t *src,
 void wlr_region_transform(pixman_region32_t *dst, pixman_region32_t *src,
 	enum wl_output_transform transform, int width, int height);
 
+/**
+ * Applies a transform to a region inside a box of size `width` x `height`,
+ * scales it and translates it by (`dx`, `dy`) in a single pass. This is the
+ * same as `wlr_region_transform`, `wlr_region_scale` and
+ * `pixman_region32_translate` in this order.
+ */
+void wlr_region_transform_scale_translate(pixman_region32_t *dst,
+	pixman_region32_t *src, enum wl_output_transform transform,
+	int width, int height, float scale, int dx, int dy);
+
 /**
  * Expands the region of `distance`. If `distance` is negative, it shrinks the
  * region.
@@ -31,6 +31,7 @@
 #ifndef WLR_XCURSOR_H
 #define WLR_XCURSOR_H
 
+#include <stddef.h>
 #include <stdint.h>
 #include <wlr/util/edges.h>
 
@@ -50,14 +51,20 @@ struct wlr_xcursor {
 	uint32_t total_delay; /* length of the animation in ms */
 };
 
+struct wlr_xcursor_theme_entry;
+
 /**
  * Container for an Xcursor theme.
  */
 struct wlr_xcursor_theme {
 	unsigned int cursor_count;
-	struct wlr_xcursor **cursors;
+	struct wlr_xcursor **cursors; // cursors loaded so far
 	char *name;
 	int size;
+
+	// cursor files of the theme sorted by name, decoded on first use
+	size_t entry_count;
+	struct wlr_xcursor_theme_entry *entries;
 };
 
 /**
@@ -66,13 +73,18 @@ struct wlr_xcursor_theme {
  * client-side cursors is not available or you wish to override client-side
  * cursors for a particular UI interaction (such as using a grab cursor when
  * moving a window around).
+ *
+ * Only the cursor file names are read here, images are decoded the first time
+ * a cursor is requested. Decoded images are shared with other loaded themes
+ * which resolve to the same file and image size.
  */
 struct wlr_xcursor_theme *wlr_xcursor_theme_load(const char *name, int size);
 
 void wlr_xcursor_theme_destroy(struct wlr_xcursor_theme *theme);
 
 /**
- * Obtains a wlr_xcursor image for the specified cursor name (e.g. "left_ptr").
+ * Obtains a wlr_xcursor image for the specified cursor name (e.g. "left_ptr"),
+ * loading it if needed.
  */
 struct wlr_xcursor *wlr_xcursor_theme_get_cursor(
 	struct wlr_xcursor_theme *theme, const char *name);
@@ -19,6 +19,7 @@ struct wlr_xwayland {
 	pid_t pid;
 	int display;
 	int x_fd[2], wl_fd[2], wm_fd[2];
+	struct wl_event_source *x_fd_read_event[2];
 	struct wl_client *client;
 	struct wl_display *wl_display;
 	struct wlr_compositor *compositor;
@@ -29,8 +30,8 @@ struct wlr_xwayland {
 	struct wl_listener display_destroy;
 	struct wlr_xwm *xwm;
 	struct wlr_xwayland_cursor *cursor;
+	bool lazy;
 
-	/* Anything above seat is reset on Xwayland restart, rest is conserved */
 	struct wlr_seat *seat;
 	struct wl_listener seat_destroy;
 
@@ -85,7 +86,8 @@ struct wlr_xwayland_surface {
 	uint32_t surface_id;
 
 	struct wl_list link;
-	struct wl_list unpaired_link;
+	struct wl_list window_link; // wlr_xwm::windows
+	struct wl_list unpaired_link; // wlr_xwm::unpaired_surfaces
 
 	struct wlr_surface *surface;
 	int16_t x, y;
@@ -122,6 +124,9 @@ struct wlr_xwayland_surface {
 
 	bool has_alpha;
 
+	// Bits of the properties waiting to be read after a PropertyNotify
+	uint32_t pending_properties;
+
 	struct {
 		struct wl_signal destroy;
 		struct wl_signal request_configure;
@@ -160,8 +165,12 @@ struct wlr_xwayland_resize_event {
 	uint32_t edges;
 };
 
+/**
+ * Creates an X11 display. In lazy mode, Xwayland is only spawned when the
+ * first X11 client connects, and again after it exited with its last client.
+ */
 struct wlr_xwayland *wlr_xwayland_create(struct wl_display *wl_display,
-	struct wlr_compositor *compositor);
+	struct wlr_compositor *compositor, bool lazy);
 
 void wlr_xwayland_destroy(struct wlr_xwayland *wlr_xwayland);
 
@@ -68,6 +68,18 @@ struct wlr_xwm_selection {
 	bool property_set;
 };
 
+/**
+ * A hash table of X11 surfaces, either keyed by window ID and chained with
+ * wlr_xwayland_surface::window_link, or keyed by Wayland surface ID and chained
+ * with wlr_xwayland_surface::unpaired_link.
+ */
+struct wlr_xwm_surface_table {
+	struct wl_list *buckets;
+	size_t len; // a power of two
+	size_t count;
+	bool by_surface_id;
+};
+
 struct wlr_xwm {
 	struct wlr_xwayland *xwayland;
 	struct wl_event_source *event_source;
@@ -89,7 +101,9 @@ struct wlr_xwm {
 	struct wlr_xwayland_surface *focus_surface;
 
 	struct wl_list surfaces; // wlr_xwayland_surface::link
-	struct wl_list unpaired_surfaces; // wlr_xwayland_surface::unpaired_link
+	struct wlr_xwm_surface_table windows;
+	struct wlr_xwm_surface_table unpaired_surfaces;
+	struct wl_array pending_properties; // struct property_request
 
 	const xcb_query_extension_reply_t *xfixes;
 
@@ -62,4 +62,15 @@ void
 xcursor_load_theme(const char *theme, int size,
 		    void (*load_callback)(XcursorImages *, void *),
 		    void *user_data);
+
+void
+xcursor_scan_theme(const char *theme,
+		   void (*scan_callback)(const char *, const char *, void *),
+		   void *user_data);
+
+unsigned int
+xcursor_file_best_size(const char *path, int size);
+
+XcursorImages *
+xcursor_file_load_images(const char *path, const char *name, int size);
 #endif
@@ -1,9 +1,11 @@
 #include <assert.h>
 #include <GLES2/gl2.h>
 #include <GLES2/gl2ext.h>
+#include <math.h>
 #include <stdint.h>
 #include <stdlib.h>
-#include <wayland-server-protocol.h>
+#include <string.h>
+#include <wayland-server.h>
 #include <wayland-util.h>
 #include <wlr/backend.h>
 #include <wlr/render.h>
@@ -105,35 +107,224 @@ static void init_globals() {
 	init_default_shaders();
 }
 
+static void apply_scissor(struct wlr_gles2_renderer *renderer) {
+	if (renderer->scissor.enabled) {
+		struct wlr_box *box = &renderer->scissor.box;
+		GL_CALL(glScissor(box->x, box->y, box->width, box->height));
+		GL_CALL(glEnable(GL_SCISSOR_TEST));
+	} else {
+		GL_CALL(glDisable(GL_SCISSOR_TEST));
+	}
+}
+
+/**
+ * Submits all queued quads in a single draw call.
+ */
+static void batch_flush(struct wlr_gles2_renderer *renderer) {
+	struct gles2_batch *batch = &renderer->batch;
+	if (batch->len == 0) {
+		return;
+	}
+
+	if (batch->texture != NULL) {
+		wlr_texture_bind(batch->texture);
+		GL_CALL(glUniform1f(2, batch->alpha));
+	} else {
+		GL_CALL(glUseProgram(batch->program));
+		GL_CALL(glUniform4f(1, batch->color[0], batch->color[1],
+			batch->color[2], batch->color[3]));
+	}
+
+	// Vertices are already in normalized device coordinates
+	float identity[16];
+	wlr_matrix_identity(&identity);
+	GL_CALL(glUniformMatrix4fv(0, 1, GL_FALSE, identity));
+
+	GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, renderer->vbo));
+	GL_CALL(glBufferData(GL_ARRAY_BUFFER, batch->len * sizeof(GLfloat),
+		batch->verts, GL_STREAM_DRAW));
+
+	GLsizei stride = 4 * sizeof(GLfloat);
+	GL_CALL(glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, stride,
+		(const GLvoid *)0));
+	GL_CALL(glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, stride,
+		(const GLvoid *)(2 * sizeof(GLfloat))));
+
+	GL_CALL(glEnableVertexAttribArray(0));
+	GL_CALL(glEnableVertexAttribArray(1));
+
+	// Quads have already been clipped to their scissor box
+	GL_CALL(glDisable(GL_SCISSOR_TEST));
+	GL_CALL(glDrawArrays(GL_TRIANGLES, 0, batch->len / 4));
+
+	GL_CALL(glDisableVertexAttribArray(0));
+	GL_CALL(glDisableVertexAttribArray(1));
+	GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, 0));
+
+	batch->len = 0;
+}
+
+void gles2_renderer_flush_texture(struct wlr_gles2_renderer *renderer,
+		struct wlr_texture *texture) {
+	struct gles2_batch *batch = &renderer->batch;
+	if (batch->texture != texture) {
+		return;
+	}
+	batch_flush(renderer);
+	// The texture may be destroyed, don't compare it with new ones
+	batch->texture = NULL;
+}
+
+/**
+ * Queues the unit quad transformed by `matrix`, clipped to the current scissor
+ * box. The clipped rectangle is used as geometry, so that all quads sharing
+ * the same state can be drawn at once regardless of their scissor box.
+ *
+ * Returns false if the quad can't be batched, in which case it needs to be
+ * drawn immediately.
+ */
+static bool batch_add_quad(struct wlr_gles2_renderer *renderer,
+		GLuint program, struct wlr_texture *texture, float alpha,
+		const float (*color)[4], const float (*matrix)[16]) {
+	const float *m = *matrix;
+
+	// Only quads rotated by a multiple of 90 degrees are still rectangles
+	// once clipped
+	if ((m[1] != 0 || m[4] != 0) && (m[0] != 0 || m[5] != 0)) {
+		return false;
+	}
+	if (m[12] != 0 || m[13] != 0 || m[15] != 1) {
+		return false;
+	}
+	float det = m[0] * m[5] - m[1] * m[4];
+	if (det == 0) {
+		return true;
+	}
+
+	// Quad bounds, in window coordinates
+	float w = renderer->viewport_width, h = renderer->viewport_height;
+	float ax = m[3], bx = m[3] + m[0] + m[1];
+	float ay = m[7], by = m[7] + m[4] + m[5];
+	float x1 = (fminf(ax, bx) + 1) * w / 2, x2 = (fmaxf(ax, bx) + 1) * w / 2;
+	float y1 = (fminf(ay, by) + 1) * h / 2, y2 = (fmaxf(ay, by) + 1) * h / 2;
+
+	struct wlr_box clip = { .width = w, .height = h };
+	if (renderer->scissor.enabled) {
+		clip = renderer->scissor.box;
+	}
+	x1 = fmaxf(x1, clip.x);
+	y1 = fmaxf(y1, clip.y);
+	x2 = fminf(x2, clip.x + clip.width);
+	y2 = fminf(y2, clip.y + clip.height);
+	if (x1 >= x2 || y1 >= y2) {
+		return true;
+	}
+
+	struct gles2_batch *batch = &renderer->batch;
+	float rgba[4] = { 0 };
+	if (color != NULL) {
+		memcpy(rgba, *color, sizeof(rgba));
+	}
+	if (batch->program != program || batch->texture != texture ||
+			batch->alpha != alpha ||
+			memcmp(batch->color, rgba, sizeof(rgba)) != 0) {
+		batch_flush(renderer);
+		batch->program = program;
+		batch->texture = texture;
+		batch->alpha = alpha;
+		memcpy(batch->color, rgba, sizeof(rgba));
+	}
+
+	const size_t quad_len = 6 * 4;
+	if (batch->len + quad_len > batch->cap) {
+		size_t cap = batch->cap > 0 ? batch->cap * 2 : 64 * quad_len;
+		GLfloat *verts = realloc(batch->verts, cap * sizeof(GLfloat));
+		if (verts == NULL) {
+			wlr_log(L_ERROR, "Allocation failed");
+			return false;
+		}
+		batch->verts = verts;
+		batch->cap = cap;
+	}
+
+	// Back to normalized device coordinates, then to texture coordinates
+	// using the inverse of the quad's transform
+	float nx[2] = { x1 * 2 / w - 1, x2 * 2 / w - 1 };
+	float ny[2] = { y1 * 2 / h - 1, y2 * 2 / h - 1 };
+	static const int corners[6][2] = {
+		{0, 0}, {1, 0}, {0, 1},
+		{1, 0}, {1, 1}, {0, 1},
+	};
+	GLfloat *v = &batch->verts[batch->len];
+	for (size_t i = 0; i < 6; ++i) {
+		float x = nx[corners[i][0]], y = ny[corners[i][1]];
+		*v++ = x;
+		*v++ = y;
+		*v++ = (m[5] * (x - m[3]) - m[1] * (y - m[7])) / det;
+		*v++ = (m[0] * (y - m[7]) - m[4] * (x - m[3])) / det;
+	}
+	batch->len += quad_len;
+
+	return true;
+}
+
 static void wlr_gles2_begin(struct wlr_renderer *wlr_renderer,
 		struct wlr_output *output) {
+	struct wlr_gles2_renderer *renderer =
+		(struct wlr_gles2_renderer *)wlr_renderer;
+
 	GL_CALL(glViewport(0, 0, output->width, output->height));
 
 	// enable transparency
 	GL_CALL(glEnable(GL_BLEND));
 	GL_CALL(glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA));
 
+	if (renderer->vbo == 0) {
+		GL_CALL(glGenBuffers(1, &renderer->vbo));
+	}
+
+	renderer->current_output = output;
+	renderer->viewport_width = output->width;
+	renderer->viewport_height = output->height;
+
 	// Note: maybe we should save output projection and remove some of the need
 	// for users to sling matricies themselves
 }
 
 static void wlr_gles2_end(struct wlr_renderer *wlr_renderer) {
-	// no-op
+	struct wlr_gles2_renderer *renderer =
+		(struct wlr_gles2_renderer *)wlr_renderer;
+	batch_flush(renderer);
+	apply_scissor(renderer);
+	renderer->current_output = NULL;
 }
 
 static void wlr_gles2_clear(struct wlr_renderer *wlr_renderer,
 		const float (*color)[4]) {
+	struct wlr_gles2_renderer *renderer =
+		(struct wlr_gles2_renderer *)wlr_renderer;
+	if (renderer->current_output != NULL) {
+		batch_flush(renderer);
+		apply_scissor(renderer);
+	}
+
 	glClearColor((*color)[0], (*color)[1], (*color)[2], (*color)[3]);
 	glClear(GL_COLOR_BUFFER_BIT);
 }
 
 static void wlr_gles2_scissor(struct wlr_renderer *wlr_renderer,
 		struct wlr_box *box) {
+	struct wlr_gles2_renderer *renderer =
+		(struct wlr_gles2_renderer *)wlr_renderer;
+	renderer->scissor.enabled = box != NULL;
 	if (box != NULL) {
-		glScissor(box->x, box->y, box->width, box->height);
-		glEnable(GL_SCISSOR_TEST);
-	} else {
-		glDisable(GL_SCISSOR_TEST);
+		renderer->scissor.box = *box;
+	}
+
+	// While rendering, the scissor box is only applied to queued quads and
+	// to the operations which can't be batched
+	if (renderer->current_output == NULL) {
+		apply_scissor(renderer);
 	}
 }
 
@@ -141,7 +332,7 @@ static struct wlr_texture *wlr_gles2_texture_create(
 		struct wlr_renderer *wlr_renderer) {
 	struct wlr_gles2_renderer *renderer =
 		(struct wlr_gles2_renderer *)wlr_renderer;
-	return gles2_texture_create(renderer->egl);
+	return gles2_texture_create(renderer);
 }
 
 static void draw_quad() {
@@ -172,11 +363,24 @@ static void draw_quad() {
 
 static bool wlr_gles2_render_texture(struct wlr_renderer *wlr_renderer,
 		struct wlr_texture *texture, const float (*matrix)[16], float alpha) {
+	struct wlr_gles2_renderer *renderer =
+		(struct wlr_gles2_renderer *)wlr_renderer;
 	if (!texture || !texture->valid) {
 		wlr_log(L_ERROR, "attempt to render invalid texture");
 		return false;
 	}
 
+	if (renderer->current_output != NULL) {
+		struct wlr_gles2_texture *gles2_texture =
+			(struct wlr_gles2_texture *)texture;
+		if (batch_add_quad(renderer, *gles2_texture->pixel_format->shader,
+				texture, alpha, NULL, matrix)) {
+			return true;
+		}
+		batch_flush(renderer);
+		apply_scissor(renderer);
+	}
+
 	wlr_texture_bind(texture);
 	GL_CALL(glUniformMatrix4fv(0, 1, GL_FALSE, *matrix));
 	GL_CALL(glUniform1f(2, alpha));
@@ -187,6 +391,17 @@ static bool wlr_gles2_render_texture(struct wlr_renderer *wlr_renderer,
 
 static void wlr_gles2_render_quad(struct wlr_renderer *wlr_renderer,
 		const float (*color)[4], const float (*matrix)[16]) {
+	struct wlr_gles2_renderer *renderer =
+		(struct wlr_gles2_renderer *)wlr_renderer;
+	if (renderer->current_output != NULL) {
+		if (batch_add_quad(renderer, shaders.quad, NULL, 1.0f, color,
+				matrix)) {
+			return;
+		}
+		batch_flush(renderer);
+		apply_scissor(renderer);
+	}
+
 	GL_CALL(glUseProgram(shaders.quad));
 	GL_CALL(glUniformMatrix4fv(0, 1, GL_FALSE, *matrix));
 	GL_CALL(glUniform4f(1, (*color)[0], (*color)[1], (*color)[2], (*color)[3]));
@@ -195,6 +410,13 @@ static void wlr_gles2_render_quad(struct wlr_renderer *wlr_renderer,
 
 static void wlr_gles2_render_ellipse(struct wlr_renderer *wlr_renderer,
 		const float (*color)[4], const float (*matrix)[16]) {
+	struct wlr_gles2_renderer *renderer =
+		(struct wlr_gles2_renderer *)wlr_renderer;
+	if (renderer->current_output != NULL) {
+		batch_flush(renderer);
+		apply_scissor(renderer);
+	}
+
 	GL_CALL(glUseProgram(shaders.ellipse));
 	GL_CALL(glUniformMatrix4fv(0, 1, GL_TRUE, *matrix));
 	GL_CALL(glUniform4f(1, (*color)[0], (*color)[1], (*color)[2], (*color)[3]));
@@ -222,16 +444,20 @@ static bool wlr_gles2_buffer_is_drm(struct wlr_renderer *wlr_renderer,
 		EGL_TEXTURE_FORMAT, &format);
 }
 
-static bool wlr_gles2_read_pixels(struct wlr_renderer *renderer,
+static bool wlr_gles2_read_pixels(struct wlr_renderer *wlr_renderer,
 		enum wl_shm_format wl_fmt, uint32_t stride, uint32_t width,
 		uint32_t height, uint32_t src_x, uint32_t src_y, uint32_t dst_x,
 		uint32_t dst_y, void *data) {
+	struct wlr_gles2_renderer *renderer =
+		(struct wlr_gles2_renderer *)wlr_renderer;
 	const struct pixel_format *fmt = gl_format_for_wl_format(wl_fmt);
 	if (fmt == NULL) {
 		wlr_log(L_ERROR, "Cannot read pixels: unsupported pixel format");
 		return false;
 	}
 
+	batch_flush(renderer);
+
 	// Make sure any pending drawing is finished before we try to read it
 	glFinish();
 
@@ -246,11 +472,133 @@ static bool wlr_gles2_read_pixels(struct wlr_renderer *renderer,
 	return true;
 }
 
+static void read_request_destroy(struct gles2_read_request *request) {
+	EGLDisplay display = request->renderer->egl->display;
+	wl_list_remove(&request->link);
+	wl_event_source_remove(request->timer);
+	eglDestroySyncKHR(display, request->fence);
+	glDeleteBuffers(1, &request->pbo);
+	free(request);
+}
+
+static int read_request_handle_timer(void *data) {
+	struct gles2_read_request *request = data;
+	struct wlr_egl *egl = request->renderer->egl;
+
+	EGLint ret = eglClientWaitSyncKHR(egl->display, request->fence, 0, 0);
+	// The buffer can only be mapped while our context is current
+	if (ret == EGL_TIMEOUT_EXPIRED_KHR ||
+			(ret != EGL_FALSE && eglGetCurrentContext() != egl->context)) {
+		wl_event_source_timer_update(request->timer, 1);
+		return 0;
+	}
+
+	const uint8_t *pixels = NULL;
+	size_t size = request->stride * request->height;
+	glBindBuffer(GL_PIXEL_PACK_BUFFER_NV, request->pbo);
+	if (ret == EGL_FALSE) {
+		wlr_log(L_ERROR, "Failed to wait for read pixels fence");
+	} else if (!(pixels = glMapBufferRangeEXT(GL_PIXEL_PACK_BUFFER_NV, 0,
+			size, GL_MAP_READ_BIT_EXT))) {
+		wlr_log(L_ERROR, "Failed to map pixel buffer");
+	}
+
+	if (pixels != NULL) {
+		// GL rows are bottom to top
+		request->done(pixels + (request->height - 1) * request->stride,
+			-(int32_t)request->stride, request->data);
+		glUnmapBufferOES(GL_PIXEL_PACK_BUFFER_NV);
+	} else {
+		request->done(NULL, 0, request->data);
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER_NV, 0);
+
+	read_request_destroy(request);
+	return 0;
+}
+
+static bool wlr_gles2_read_pixels_async(struct wlr_renderer *wlr_renderer,
+		struct wl_event_loop *loop, enum wl_shm_format wl_fmt,
+		uint32_t width, uint32_t height, uint32_t src_x, uint32_t src_y,
+		wlr_renderer_read_pixels_func_t done, void *data) {
+	struct wlr_gles2_renderer *renderer =
+		(struct wlr_gles2_renderer *)wlr_renderer;
+	if (!renderer->has_async_read) {
+		return false;
+	}
+	const struct pixel_format *fmt = gl_format_for_wl_format(wl_fmt);
+	if (fmt == NULL) {
+		wlr_log(L_ERROR, "Cannot read pixels: unsupported pixel format");
+		return false;
+	}
+
+	struct gles2_read_request *request =
+		calloc(1, sizeof(struct gles2_read_request));
+	if (request == NULL) {
+		wlr_log(L_ERROR, "Allocation failed");
+		return false;
+	}
+	request->renderer = renderer;
+	request->height = height;
+	request->stride = width * fmt->bpp / 8;
+	request->done = done;
+	request->data = data;
+
+	request->timer = wl_event_loop_add_timer(loop,
+		read_request_handle_timer, request);
+	if (request->timer == NULL) {
+		free(request);
+		return false;
+	}
+
+	batch_flush(renderer);
+
+	// GL_PACK_ALIGNMENT defaults to 4, which matches all supported formats
+	glGenBuffers(1, &request->pbo);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER_NV, request->pbo);
+	glBufferData(GL_PIXEL_PACK_BUFFER_NV, request->stride * height, NULL,
+		GL_STREAM_DRAW);
+	glReadPixels(src_x, src_y, width, height, fmt->gl_format, fmt->gl_type, 0);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER_NV, 0);
+
+	request->fence = eglCreateSyncKHR(renderer->egl->display,
+		EGL_SYNC_FENCE_KHR, NULL);
+	if (request->fence == EGL_NO_SYNC_KHR) {
+		wlr_log(L_ERROR, "Failed to create read pixels fence");
+		wl_event_source_remove(request->timer);
+		glDeleteBuffers(1, &request->pbo);
+		free(request);
+		return false;
+	}
+	// Make sure the commands are submitted, the fence would never signal
+	// otherwise
+	glFlush();
+
+	wl_list_insert(&renderer->read_requests, &request->link);
+	wl_event_source_timer_update(request->timer, 1);
+	return true;
+}
+
 static bool wlr_gles2_format_supported(struct wlr_renderer *r,
 		enum wl_shm_format wl_fmt) {
 	return gl_format_for_wl_format(wl_fmt);
 }
 
+static void wlr_gles2_destroy(struct wlr_renderer *wlr_renderer) {
+	struct wlr_gles2_renderer *renderer =
+		(struct wlr_gles2_renderer *)wlr_renderer;
+	struct gles2_read_request *request, *tmp;
+	wl_list_for_each_safe(request, tmp, &renderer->read_requests, link) {
+		request->done(NULL, 0, request->data);
+		read_request_destroy(request);
+	}
+	if (renderer->vbo) {
+		glDeleteBuffers(1, &renderer->vbo);
+	}
+	free(renderer->batch.verts);
+	free(renderer);
+}
+
 static struct wlr_renderer_impl wlr_renderer_impl = {
 	.begin = wlr_gles2_begin,
 	.end = wlr_gles2_end,
@@ -263,7 +611,9 @@ static struct wlr_renderer_impl wlr_renderer_impl = {
 	.formats = wlr_gles2_formats,
 	.buffer_is_drm = wlr_gles2_buffer_is_drm,
 	.read_pixels = wlr_gles2_read_pixels,
+	.read_pixels_async = wlr_gles2_read_pixels_async,
 	.format_supported = wlr_gles2_format_supported,
+	.destroy = wlr_gles2_destroy,
 };
 
 struct wlr_renderer *wlr_gles2_renderer_create(struct wlr_backend *backend) {
@@ -275,6 +625,19 @@ struct wlr_renderer *wlr_gles2_renderer_create(struct wlr_backend *backend) {
 	wlr_renderer_init(&renderer->wlr_renderer, &wlr_renderer_impl);
 
 	renderer->egl = wlr_backend_get_egl(backend);
+	wl_list_init(&renderer->read_requests);
+
+	// GLES2 has no pixel buffer objects, they are only available through
+	// extensions
+	struct wlr_egl *egl = renderer->egl;
+	renderer->has_async_read = egl != NULL &&
+		egl->gl_exts_str != NULL && egl->egl_exts_str != NULL &&
+		strstr(egl->gl_exts_str, "GL_NV_pixel_buffer_object") &&
+		strstr(egl->gl_exts_str, "GL_EXT_map_buffer_range") &&
+		strstr(egl->gl_exts_str, "GL_OES_mapbuffer") &&
+		strstr(egl->egl_exts_str, "EGL_KHR_fence_sync") &&
+		glMapBufferRangeEXT && glUnmapBufferOES &&
+		eglCreateSyncKHR && eglDestroySyncKHR && eglClientWaitSyncKHR;
 
 	return &renderer->wlr_renderer;
 }
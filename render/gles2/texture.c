@@ -22,6 +22,14 @@ static struct pixel_format external_pixel_format = {
 	.shader = &shaders.external
 };
 
+/**
+ * Draws the quads queued with the texture, before its contents change or it
+ * is destroyed.
+ */
+static void gles2_texture_flush(struct wlr_gles2_texture *texture) {
+	gles2_renderer_flush_texture(texture->renderer, &texture->wlr_texture);
+}
+
 static void gles2_texture_ensure_texture(struct wlr_gles2_texture *texture) {
 	if (texture->tex_id) {
 		return;
@@ -37,6 +45,7 @@ static bool gles2_texture_upload_pixels(struct wlr_texture *_texture,
 		const unsigned char *pixels) {
 	struct wlr_gles2_texture *texture = (struct wlr_gles2_texture *)_texture;
 	assert(texture);
+	gles2_texture_flush(texture);
 	const struct pixel_format *fmt = gl_format_for_wl_format(format);
 	if (!fmt || !fmt->gl_format) {
 		wlr_log(L_ERROR, "No supported pixel format for this texture");
@@ -61,6 +70,7 @@ static bool gles2_texture_update_pixels(struct wlr_texture *_texture,
 		int width, int height, const unsigned char *pixels) {
 	struct wlr_gles2_texture *texture = (struct wlr_gles2_texture *)_texture;
 	assert(texture);
+	gles2_texture_flush(texture);
 	// TODO: Test if the unpack subimage extension is supported and adjust the
 	// upload strategy if not
 	if (!texture->wlr_texture.valid
@@ -84,6 +94,7 @@ static bool gles2_texture_update_pixels(struct wlr_texture *_texture,
 static bool gles2_texture_upload_shm(struct wlr_texture *_texture,
 		uint32_t format, struct wl_shm_buffer *buffer) {
 	struct wlr_gles2_texture *texture = (struct wlr_gles2_texture *)_texture;
+	gles2_texture_flush(texture);
 	const struct pixel_format *fmt = gl_format_for_wl_format(format);
 	if (!fmt || !fmt->gl_format) {
 		wlr_log(L_ERROR, "No supported pixel format for this texture");
@@ -116,6 +127,7 @@ static bool gles2_texture_update_shm(struct wlr_texture *_texture,
 		uint32_t format, int x, int y, int width, int height,
 		struct wl_shm_buffer *buffer) {
 	struct wlr_gles2_texture *texture = (struct wlr_gles2_texture *)_texture;
+	gles2_texture_flush(texture);
 	// TODO: Test if the unpack subimage extension is supported and adjust the
 	// upload strategy if not
 	assert(texture);
@@ -143,9 +155,88 @@ static bool gles2_texture_update_shm(struct wlr_texture *_texture,
 	return true;
 }
 
+// Fixed cost of a glTexSubImage2D call, in pixels
+#define UPLOAD_OVERHEAD 4096
+
+static int64_t box_area(const pixman_box32_t *box) {
+	return (int64_t)(box->x2 - box->x1) * (box->y2 - box->y1);
+}
+
+/**
+ * Merges `box` into `pending` if uploading the extra pixels in between is
+ * cheaper than a separate upload.
+ */
+static bool box_try_merge(pixman_box32_t *pending, const pixman_box32_t *box) {
+	pixman_box32_t merged = {
+		.x1 = pending->x1 < box->x1 ? pending->x1 : box->x1,
+		.y1 = pending->y1 < box->y1 ? pending->y1 : box->y1,
+		.x2 = pending->x2 > box->x2 ? pending->x2 : box->x2,
+		.y2 = pending->y2 > box->y2 ? pending->y2 : box->y2,
+	};
+	if (box_area(&merged) >
+			box_area(pending) + box_area(box) + UPLOAD_OVERHEAD) {
+		return false;
+	}
+	*pending = merged;
+	return true;
+}
+
+static void gles2_texture_upload_box(struct wlr_gles2_texture *texture,
+		const pixman_box32_t *box, const uint8_t *pixels) {
+	const struct pixel_format *fmt = texture->pixel_format;
+	GL_CALL(glPixelStorei(GL_UNPACK_SKIP_PIXELS_EXT, box->x1));
+	GL_CALL(glPixelStorei(GL_UNPACK_SKIP_ROWS_EXT, box->y1));
+	GL_CALL(glTexSubImage2D(GL_TEXTURE_2D, 0, box->x1, box->y1,
+		box->x2 - box->x1, box->y2 - box->y1,
+		fmt->gl_format, fmt->gl_type, pixels));
+}
+
+static bool gles2_texture_update_shm_region(struct wlr_texture *_texture,
+		uint32_t format, pixman_region32_t *region,
+		struct wl_shm_buffer *buffer) {
+	struct wlr_gles2_texture *texture = (struct wlr_gles2_texture *)_texture;
+	assert(texture);
+	gles2_texture_flush(texture);
+	if (!texture->wlr_texture.valid
+			|| texture->wlr_texture.format != format) {
+		return gles2_texture_upload_shm(&texture->wlr_texture, format, buffer);
+	}
+
+	int n;
+	pixman_box32_t *rects = pixman_region32_rectangles(region, &n);
+	if (n == 0) {
+		return true;
+	}
+
+	const struct pixel_format *fmt = texture->pixel_format;
+	wl_shm_buffer_begin_access(buffer);
+	uint8_t *pixels = wl_shm_buffer_get_data(buffer);
+	int pitch = wl_shm_buffer_get_stride(buffer) / (fmt->bpp / 8);
+
+	GL_CALL(glBindTexture(GL_TEXTURE_2D, texture->tex_id));
+	GL_CALL(glPixelStorei(GL_UNPACK_ROW_LENGTH_EXT, pitch));
+
+	// Rectangles are sorted in bands, so neighbours are usually close
+	pixman_box32_t pending = rects[0];
+	for (int i = 1; i < n; ++i) {
+		if (!box_try_merge(&pending, &rects[i])) {
+			gles2_texture_upload_box(texture, &pending, pixels);
+			pending = rects[i];
+		}
+	}
+	gles2_texture_upload_box(texture, &pending, pixels);
+
+	GL_CALL(glPixelStorei(GL_UNPACK_SKIP_PIXELS_EXT, 0));
+	GL_CALL(glPixelStorei(GL_UNPACK_SKIP_ROWS_EXT, 0));
+
+	wl_shm_buffer_end_access(buffer);
+	return true;
+}
+
 static bool gles2_texture_upload_drm(struct wlr_texture *_tex,
 		struct wl_resource *buf) {
 	struct wlr_gles2_texture *tex = (struct wlr_gles2_texture *)_tex;
+	gles2_texture_flush(tex);
 	if (!glEGLImageTargetTexture2DOES) {
 		return false;
 	}
@@ -201,6 +292,7 @@ static bool gles2_texture_upload_drm(struct wlr_texture *_tex,
 	GL_CALL(glBindTexture(target, tex->tex_id));
 	GL_CALL(glEGLImageTargetTexture2DOES(target, tex->image));
 	tex->wlr_texture.valid = true;
+	tex->wlr_texture.format = pf->wl_format;
 	tex->pixel_format = pf;
 
 	return true;
@@ -209,6 +301,7 @@ static bool gles2_texture_upload_drm(struct wlr_texture *_tex,
 static bool gles2_texture_upload_eglimage(struct wlr_texture *wlr_tex,
 		EGLImageKHR image, uint32_t width, uint32_t height) {
 	struct wlr_gles2_texture *tex = (struct wlr_gles2_texture *)wlr_tex;
+	gles2_texture_flush(tex);
 
 	tex->image = image;
 	tex->pixel_format = &external_pixel_format;
@@ -272,6 +365,7 @@ static void gles2_texture_bind(struct wlr_texture *_texture) {
 
 static void gles2_texture_destroy(struct wlr_texture *_texture) {
 	struct wlr_gles2_texture *texture = (struct wlr_gles2_texture *)_texture;
+	gles2_texture_flush(texture);
 	wlr_signal_emit_safe(&texture->wlr_texture.destroy_signal, &texture->wlr_texture);
 	if (texture->tex_id) {
 		GL_CALL(glDeleteTextures(1, &texture->tex_id));
@@ -289,6 +383,7 @@ static struct wlr_texture_impl wlr_texture_impl = {
 	.update_pixels = gles2_texture_update_pixels,
 	.upload_shm = gles2_texture_upload_shm,
 	.update_shm = gles2_texture_update_shm,
+	.update_shm_region = gles2_texture_update_shm_region,
 	.upload_drm = gles2_texture_upload_drm,
 	.upload_eglimage = gles2_texture_upload_eglimage,
 	.get_matrix = gles2_texture_get_matrix,
@@ -297,12 +392,14 @@ static struct wlr_texture_impl wlr_texture_impl = {
 	.destroy = gles2_texture_destroy,
 };
 
-struct wlr_texture *gles2_texture_create(struct wlr_egl *egl) {
+struct wlr_texture *gles2_texture_create(
+		struct wlr_gles2_renderer *renderer) {
 	struct wlr_gles2_texture *texture;
 	if (!(texture = calloc(1, sizeof(struct wlr_gles2_texture)))) {
 		return NULL;
 	}
 	wlr_texture_init(&texture->wlr_texture, &wlr_texture_impl);
-	texture->egl = egl;
+	texture->renderer = renderer;
+	texture->egl = renderer->egl;
 	return &texture->wlr_texture;
 }
@@ -0,0 +1,33 @@
+#include <pixman.h>
+#include <wayland-server-protocol.h>
+#include "render/pixman.h"
+
+/*
+ * wl_shm formats are little-endian, pixman formats are in native endianness:
+ * on big-endian machines the channel order of the pixman format is reversed.
+ */
+static const struct {
+	enum wl_shm_format wl_format;
+	pixman_format_code_t pixman_format;
+} formats[] = {
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	{ WL_SHM_FORMAT_ARGB8888, PIXMAN_b8g8r8a8 },
+	{ WL_SHM_FORMAT_XRGB8888, PIXMAN_b8g8r8x8 },
+	{ WL_SHM_FORMAT_ABGR8888, PIXMAN_r8g8b8a8 },
+	{ WL_SHM_FORMAT_XBGR8888, PIXMAN_r8g8b8x8 },
+#else
+	{ WL_SHM_FORMAT_ARGB8888, PIXMAN_a8r8g8b8 },
+	{ WL_SHM_FORMAT_XRGB8888, PIXMAN_x8r8g8b8 },
+	{ WL_SHM_FORMAT_ABGR8888, PIXMAN_a8b8g8r8 },
+	{ WL_SHM_FORMAT_XBGR8888, PIXMAN_x8b8g8r8 },
+#endif
+};
+
+pixman_format_code_t pixman_format_for_wl_format(enum wl_shm_format fmt) {
+	for (size_t i = 0; i < sizeof(formats) / sizeof(formats[0]); ++i) {
+		if (formats[i].wl_format == fmt) {
+			return formats[i].pixman_format;
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,382 @@
+#define _XOPEN_SOURCE 700
+#include <assert.h>
+#include <math.h>
+#include <pixman.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <wayland-server-protocol.h>
+#include <wlr/render.h>
+#include <wlr/render/interface.h>
+#include <wlr/render/pixman.h>
+#include <wlr/util/log.h>
+#include "render/pixman.h"
+
+// Number of triangles used to approximate an ellipse
+#define ELLIPSE_TRIANGLES 64
+
+static struct wlr_renderer_impl wlr_renderer_impl;
+
+static struct wlr_pixman_renderer *pixman_renderer_from_renderer(
+		struct wlr_renderer *wlr_renderer) {
+	assert(wlr_renderer->impl == &wlr_renderer_impl);
+	return (struct wlr_pixman_renderer *)wlr_renderer;
+}
+
+/**
+ * Converts a matrix mapping the unit square to normalized device coordinates
+ * into a transform mapping the unit square to pixels of the bound image.
+ * Matrices are row-major, the first row of the image is at the top.
+ */
+static void matrix_to_image(struct wlr_pixman_renderer *renderer,
+		const float (*matrix)[16], struct pixman_f_transform *t) {
+	const float *m = *matrix;
+	double half_width = pixman_image_get_width(renderer->image) / 2.0;
+	double half_height = pixman_image_get_height(renderer->image) / 2.0;
+
+	pixman_f_transform_init_identity(t);
+	t->m[0][0] = m[0] * half_width;
+	t->m[0][1] = m[1] * half_width;
+	t->m[0][2] = (m[3] + 1) * half_width;
+	t->m[1][0] = -m[4] * half_height;
+	t->m[1][1] = -m[5] * half_height;
+	t->m[1][2] = (1 - m[7]) * half_height;
+}
+
+static pixman_point_fixed_t transform_point(const struct pixman_f_transform *t,
+		double x, double y) {
+	return (pixman_point_fixed_t){
+		.x = pixman_double_to_fixed(t->m[0][0] * x + t->m[0][1] * y +
+			t->m[0][2]),
+		.y = pixman_double_to_fixed(t->m[1][0] * x + t->m[1][1] * y +
+			t->m[1][2]),
+	};
+}
+
+/**
+ * Computes the pixels of the bound image covered by a width×height rectangle
+ * mapped with `t`. Returns false if none are.
+ */
+static bool transform_bounds(struct wlr_pixman_renderer *renderer,
+		const struct pixman_f_transform *t, double width, double height,
+		pixman_box32_t *box) {
+	double corners[4][2] = {
+		{ 0, 0 }, { width, 0 }, { 0, height }, { width, height },
+	};
+	double x1 = INFINITY, y1 = INFINITY, x2 = -INFINITY, y2 = -INFINITY;
+	for (size_t i = 0; i < 4; ++i) {
+		double x = t->m[0][0] * corners[i][0] + t->m[0][1] * corners[i][1] +
+			t->m[0][2];
+		double y = t->m[1][0] * corners[i][0] + t->m[1][1] * corners[i][1] +
+			t->m[1][2];
+		x1 = fmin(x1, x);
+		y1 = fmin(y1, y);
+		x2 = fmax(x2, x);
+		y2 = fmax(y2, y);
+	}
+
+	box->x1 = fmax(floor(x1), 0);
+	box->y1 = fmax(floor(y1), 0);
+	box->x2 = fmin(ceil(x2), pixman_image_get_width(renderer->image));
+	box->y2 = fmin(ceil(y2), pixman_image_get_height(renderer->image));
+	return box->x1 < box->x2 && box->y1 < box->y2;
+}
+
+static bool is_axis_aligned(const struct pixman_f_transform *t) {
+	return t->m[0][1] == 0 && t->m[1][0] == 0;
+}
+
+static pixman_color_t color_to_pixman(const float (*color)[4]) {
+	// Colors are premultiplied, just like pixman's
+	return (pixman_color_t){
+		.red = (*color)[0] * 0xFFFF,
+		.green = (*color)[1] * 0xFFFF,
+		.blue = (*color)[2] * 0xFFFF,
+		.alpha = (*color)[3] * 0xFFFF,
+	};
+}
+
+static void wlr_pixman_begin(struct wlr_renderer *wlr_renderer,
+		struct wlr_output *output) {
+	struct wlr_pixman_renderer *renderer =
+		pixman_renderer_from_renderer(wlr_renderer);
+	if (renderer->image == NULL) {
+		wlr_log(L_ERROR, "No image bound to the pixman renderer");
+	}
+}
+
+static void wlr_pixman_end(struct wlr_renderer *wlr_renderer) {
+	// No-op
+}
+
+static void wlr_pixman_clear(struct wlr_renderer *wlr_renderer,
+		const float (*color)[4]) {
+	struct wlr_pixman_renderer *renderer =
+		pixman_renderer_from_renderer(wlr_renderer);
+	if (renderer->image == NULL) {
+		return;
+	}
+
+	pixman_color_t pixman_color = color_to_pixman(color);
+	pixman_box32_t box = {
+		.x2 = pixman_image_get_width(renderer->image),
+		.y2 = pixman_image_get_height(renderer->image),
+	};
+	pixman_image_fill_boxes(PIXMAN_OP_SRC, renderer->image, &pixman_color,
+		1, &box);
+}
+
+static void wlr_pixman_scissor(struct wlr_renderer *wlr_renderer,
+		struct wlr_box *box) {
+	struct wlr_pixman_renderer *renderer =
+		pixman_renderer_from_renderer(wlr_renderer);
+	if (renderer->image == NULL) {
+		return;
+	}
+
+	if (box == NULL) {
+		pixman_image_set_clip_region32(renderer->image, NULL);
+		return;
+	}
+
+	// The scissor box is upside down, like glScissor's
+	int height = pixman_image_get_height(renderer->image);
+	pixman_region32_t region;
+	pixman_region32_init_rect(&region, box->x,
+		height - box->y - box->height, box->width, box->height);
+	pixman_image_set_clip_region32(renderer->image, &region);
+	pixman_region32_fini(&region);
+}
+
+static struct wlr_texture *wlr_pixman_texture_create(
+		struct wlr_renderer *wlr_renderer) {
+	return pixman_texture_create();
+}
+
+static bool wlr_pixman_render_texture(struct wlr_renderer *wlr_renderer,
+		struct wlr_texture *wlr_texture, const float (*matrix)[16],
+		float alpha) {
+	struct wlr_pixman_renderer *renderer =
+		pixman_renderer_from_renderer(wlr_renderer);
+	if (!wlr_texture || !wlr_texture->valid) {
+		wlr_log(L_ERROR, "attempt to render invalid texture");
+		return false;
+	}
+	if (renderer->image == NULL) {
+		return false;
+	}
+	struct wlr_pixman_texture *texture =
+		(struct wlr_pixman_texture *)wlr_texture;
+
+	// Map texture pixels to image pixels, then invert it because pixman
+	// samples the source for each destination pixel
+	struct pixman_f_transform to_image, to_texture;
+	matrix_to_image(renderer, matrix, &to_image);
+	struct pixman_f_transform scale;
+	pixman_f_transform_init_scale(&scale,
+		1.0 / wlr_texture->width, 1.0 / wlr_texture->height);
+	pixman_f_transform_multiply(&to_image, &to_image, &scale);
+	if (!pixman_f_transform_invert(&to_texture, &to_image)) {
+		return true; // Degenerate, nothing to draw
+	}
+
+	pixman_box32_t box;
+	if (!transform_bounds(renderer, &to_image, wlr_texture->width,
+			wlr_texture->height, &box)) {
+		return true;
+	}
+
+	struct pixman_transform transform;
+	pixman_transform_from_pixman_f_transform(&transform, &to_texture);
+	pixman_image_set_transform(texture->image, &transform);
+
+	// Only filter if pixels don't map one to one
+	bool integer_translation = is_axis_aligned(&to_image) &&
+		to_image.m[0][0] == 1 && to_image.m[1][1] == 1 &&
+		to_image.m[0][2] == floor(to_image.m[0][2]) &&
+		to_image.m[1][2] == floor(to_image.m[1][2]);
+	pixman_image_set_filter(texture->image, integer_translation ?
+		PIXMAN_FILTER_NEAREST : PIXMAN_FILTER_BILINEAR, NULL, 0);
+
+	pixman_image_t *mask = NULL;
+	if (alpha < 1.0) {
+		pixman_color_t mask_color = { .alpha = alpha * 0xFFFF };
+		mask = pixman_image_create_solid_fill(&mask_color);
+	}
+
+	pixman_image_composite32(PIXMAN_OP_OVER, texture->image, mask,
+		renderer->image, box.x1, box.y1, 0, 0, box.x1, box.y1,
+		box.x2 - box.x1, box.y2 - box.y1);
+
+	if (mask != NULL) {
+		pixman_image_unref(mask);
+	}
+	pixman_image_set_transform(texture->image, NULL);
+	return true;
+}
+
+/**
+ * Fills the polygon made of the given triangles, in image coordinates.
+ */
+static void fill_triangles(struct wlr_pixman_renderer *renderer,
+		const float (*color)[4], const pixman_triangle_t *triangles,
+		int n_triangles) {
+	pixman_color_t pixman_color = color_to_pixman(color);
+	pixman_image_t *src = pixman_image_create_solid_fill(&pixman_color);
+	if (src == NULL) {
+		return;
+	}
+	pixman_composite_triangles(PIXMAN_OP_OVER, src, renderer->image,
+		PIXMAN_a8, 0, 0, 0, 0, n_triangles, triangles);
+	pixman_image_unref(src);
+}
+
+static void wlr_pixman_render_quad(struct wlr_renderer *wlr_renderer,
+		const float (*color)[4], const float (*matrix)[16]) {
+	struct wlr_pixman_renderer *renderer =
+		pixman_renderer_from_renderer(wlr_renderer);
+	if (renderer->image == NULL) {
+		return;
+	}
+
+	struct pixman_f_transform to_image;
+	matrix_to_image(renderer, matrix, &to_image);
+
+	if (is_axis_aligned(&to_image)) {
+		pixman_box32_t box;
+		if (!transform_bounds(renderer, &to_image, 1, 1, &box)) {
+			return;
+		}
+		pixman_color_t pixman_color = color_to_pixman(color);
+		pixman_image_fill_boxes(PIXMAN_OP_OVER, renderer->image,
+			&pixman_color, 1, &box);
+		return;
+	}
+
+	pixman_point_fixed_t top_left = transform_point(&to_image, 0, 0);
+	pixman_point_fixed_t top_right = transform_point(&to_image, 1, 0);
+	pixman_point_fixed_t bottom_left = transform_point(&to_image, 0, 1);
+	pixman_point_fixed_t bottom_right = transform_point(&to_image, 1, 1);
+	pixman_triangle_t triangles[] = {
+		{ top_left, top_right, bottom_right },
+		{ top_left, bottom_right, bottom_left },
+	};
+	fill_triangles(renderer, color, triangles, 2);
+}
+
+static void wlr_pixman_render_ellipse(struct wlr_renderer *wlr_renderer,
+		const float (*color)[4], const float (*matrix)[16]) {
+	struct wlr_pixman_renderer *renderer =
+		pixman_renderer_from_renderer(wlr_renderer);
+	if (renderer->image == NULL) {
+		return;
+	}
+
+	struct pixman_f_transform to_image;
+	matrix_to_image(renderer, matrix, &to_image);
+
+	// Fan of triangles around the center of the unit square
+	pixman_triangle_t triangles[ELLIPSE_TRIANGLES];
+	pixman_point_fixed_t center = transform_point(&to_image, 0.5, 0.5);
+	pixman_point_fixed_t prev = transform_point(&to_image, 1, 0.5);
+	for (int i = 0; i < ELLIPSE_TRIANGLES; ++i) {
+		double angle = 2 * M_PI * (i + 1) / ELLIPSE_TRIANGLES;
+		pixman_point_fixed_t next = transform_point(&to_image,
+			0.5 + cos(angle) / 2, 0.5 + sin(angle) / 2);
+		triangles[i] = (pixman_triangle_t){ center, prev, next };
+		prev = next;
+	}
+	fill_triangles(renderer, color, triangles, ELLIPSE_TRIANGLES);
+}
+
+static const enum wl_shm_format *wlr_pixman_formats(
+		struct wlr_renderer *renderer, size_t *len) {
+	static enum wl_shm_format formats[] = {
+		WL_SHM_FORMAT_ARGB8888,
+		WL_SHM_FORMAT_XRGB8888,
+		WL_SHM_FORMAT_ABGR8888,
+		WL_SHM_FORMAT_XBGR8888,
+	};
+	*len = sizeof(formats) / sizeof(formats[0]);
+	return formats;
+}
+
+static bool wlr_pixman_buffer_is_drm(struct wlr_renderer *wlr_renderer,
+		struct wl_resource *buffer) {
+	return false;
+}
+
+static bool wlr_pixman_read_pixels(struct wlr_renderer *wlr_renderer,
+		enum wl_shm_format wl_fmt, uint32_t stride, uint32_t width,
+		uint32_t height, uint32_t src_x, uint32_t src_y, uint32_t dst_x,
+		uint32_t dst_y, void *data) {
+	struct wlr_pixman_renderer *renderer =
+		pixman_renderer_from_renderer(wlr_renderer);
+	pixman_format_code_t fmt = pixman_format_for_wl_format(wl_fmt);
+	if (fmt == 0) {
+		wlr_log(L_ERROR, "Cannot read pixels: unsupported pixel format");
+		return false;
+	}
+	if (renderer->image == NULL) {
+		wlr_log(L_ERROR, "Cannot read pixels: no image bound");
+		return false;
+	}
+
+	pixman_image_t *dst = pixman_image_create_bits_no_clear(fmt,
+		dst_x + width, dst_y + height, data, stride);
+	if (dst == NULL) {
+		wlr_log(L_ERROR, "Cannot read pixels: failed to wrap buffer");
+		return false;
+	}
+
+	// Like glReadPixels, src_y starts at the bottom
+	int image_height = pixman_image_get_height(renderer->image);
+	pixman_image_composite32(PIXMAN_OP_SRC, renderer->image, NULL, dst,
+		src_x, image_height - src_y - height, 0, 0, dst_x, dst_y,
+		width, height);
+	pixman_image_unref(dst);
+	return true;
+}
+
+static bool wlr_pixman_format_supported(struct wlr_renderer *r,
+		enum wl_shm_format wl_fmt) {
+	return pixman_format_for_wl_format(wl_fmt) != 0;
+}
+
+static struct wlr_renderer_impl wlr_renderer_impl = {
+	.begin = wlr_pixman_begin,
+	.end = wlr_pixman_end,
+	.clear = wlr_pixman_clear,
+	.scissor = wlr_pixman_scissor,
+	.texture_create = wlr_pixman_texture_create,
+	.render_with_matrix = wlr_pixman_render_texture,
+	.render_quad = wlr_pixman_render_quad,
+	.render_ellipse = wlr_pixman_render_ellipse,
+	.formats = wlr_pixman_formats,
+	.buffer_is_drm = wlr_pixman_buffer_is_drm,
+	.read_pixels = wlr_pixman_read_pixels,
+	.format_supported = wlr_pixman_format_supported,
+};
+
+struct wlr_renderer *wlr_pixman_renderer_create(void) {
+	struct wlr_pixman_renderer *renderer;
+	if (!(renderer = calloc(1, sizeof(struct wlr_pixman_renderer)))) {
+		return NULL;
+	}
+	wlr_renderer_init(&renderer->wlr_renderer, &wlr_renderer_impl);
+	return &renderer->wlr_renderer;
+}
+
+void wlr_pixman_renderer_bind_image(struct wlr_renderer *wlr_renderer,
+		pixman_image_t *image) {
+	struct wlr_pixman_renderer *renderer =
+		pixman_renderer_from_renderer(wlr_renderer);
+	renderer->image = image;
+	if (image != NULL) {
+		// Start without a scissor box
+		pixman_image_set_clip_region32(image, NULL);
+	}
+}
+
+bool wlr_renderer_is_pixman(struct wlr_renderer *wlr_renderer) {
+	return wlr_renderer->impl == &wlr_renderer_impl;
+}
@@ -0,0 +1,211 @@
+#include <assert.h>
+#include <pixman.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <wayland-server.h>
+#include <wlr/render.h>
+#include <wlr/render/interface.h>
+#include <wlr/render/matrix.h>
+#include <wlr/util/log.h>
+#include "render/pixman.h"
+#include "util/signal.h"
+
+/**
+ * Copies a rectangle of `pixels` to the same location in the texture,
+ * re-allocating the texture if needed. `stride` is in bytes.
+ */
+static bool pixman_texture_write(struct wlr_pixman_texture *texture,
+		enum wl_shm_format format, int stride, int x, int y,
+		int width, int height, int buffer_width, int buffer_height,
+		void *pixels) {
+	pixman_format_code_t fmt = pixman_format_for_wl_format(format);
+	if (fmt == 0) {
+		wlr_log(L_ERROR, "No supported pixel format for this texture");
+		return false;
+	}
+
+	struct wlr_texture *wlr_texture = &texture->wlr_texture;
+	if (texture->image == NULL || wlr_texture->format != format ||
+			wlr_texture->width != buffer_width ||
+			wlr_texture->height != buffer_height) {
+		pixman_image_t *image = pixman_image_create_bits_no_clear(fmt,
+			buffer_width, buffer_height, NULL, 0);
+		if (image == NULL) {
+			wlr_log(L_ERROR, "Failed to allocate texture image");
+			return false;
+		}
+		if (texture->image != NULL) {
+			pixman_image_unref(texture->image);
+		}
+		texture->image = image;
+		wlr_texture->format = format;
+		wlr_texture->width = buffer_width;
+		wlr_texture->height = buffer_height;
+
+		// The new image is uninitialized, copy everything
+		x = y = 0;
+		width = buffer_width;
+		height = buffer_height;
+	}
+
+	// Composite straight from the client memory, without a staging copy
+	pixman_image_t *src = pixman_image_create_bits_no_clear(fmt,
+		buffer_width, buffer_height, pixels, stride);
+	if (src == NULL) {
+		wlr_log(L_ERROR, "Failed to wrap texture pixels");
+		return false;
+	}
+	pixman_image_composite32(PIXMAN_OP_SRC, src, NULL, texture->image,
+		x, y, 0, 0, x, y, width, height);
+	pixman_image_unref(src);
+
+	wlr_texture->valid = true;
+	return true;
+}
+
+static bool pixman_texture_upload_pixels(struct wlr_texture *_texture,
+		enum wl_shm_format format, int stride, int width, int height,
+		const unsigned char *pixels) {
+	struct wlr_pixman_texture *texture = (struct wlr_pixman_texture *)_texture;
+	assert(texture);
+	pixman_format_code_t fmt = pixman_format_for_wl_format(format);
+	if (fmt == 0) {
+		wlr_log(L_ERROR, "No supported pixel format for this texture");
+		return false;
+	}
+	// The stride is in pixels
+	stride *= PIXMAN_FORMAT_BPP(fmt) / 8;
+	return pixman_texture_write(texture, format, stride, 0, 0, width, height,
+		width, height, (void *)pixels);
+}
+
+static bool pixman_texture_update_pixels(struct wlr_texture *_texture,
+		enum wl_shm_format format, int stride, int x, int y,
+		int width, int height, const unsigned char *pixels) {
+	struct wlr_pixman_texture *texture = (struct wlr_pixman_texture *)_texture;
+	assert(texture);
+	if (!texture->wlr_texture.valid) {
+		return pixman_texture_upload_pixels(&texture->wlr_texture, format,
+			stride, width, height, pixels);
+	}
+	pixman_format_code_t fmt = pixman_format_for_wl_format(format);
+	if (fmt == 0) {
+		wlr_log(L_ERROR, "No supported pixel format for this texture");
+		return false;
+	}
+	stride *= PIXMAN_FORMAT_BPP(fmt) / 8;
+	return pixman_texture_write(texture, format, stride, x, y, width, height,
+		texture->wlr_texture.width, texture->wlr_texture.height,
+		(void *)pixels);
+}
+
+static bool pixman_texture_update_shm(struct wlr_texture *_texture,
+		uint32_t format, int x, int y, int width, int height,
+		struct wl_shm_buffer *buffer) {
+	struct wlr_pixman_texture *texture = (struct wlr_pixman_texture *)_texture;
+	assert(texture);
+	wl_shm_buffer_begin_access(buffer);
+	bool ok = pixman_texture_write(texture, format,
+		wl_shm_buffer_get_stride(buffer), x, y, width, height,
+		wl_shm_buffer_get_width(buffer), wl_shm_buffer_get_height(buffer),
+		wl_shm_buffer_get_data(buffer));
+	wl_shm_buffer_end_access(buffer);
+	return ok;
+}
+
+static bool pixman_texture_upload_shm(struct wlr_texture *texture,
+		uint32_t format, struct wl_shm_buffer *buffer) {
+	return pixman_texture_update_shm(texture, format, 0, 0,
+		wl_shm_buffer_get_width(buffer), wl_shm_buffer_get_height(buffer),
+		buffer);
+}
+
+static bool pixman_texture_update_shm_region(struct wlr_texture *_texture,
+		uint32_t format, pixman_region32_t *region,
+		struct wl_shm_buffer *buffer) {
+	struct wlr_pixman_texture *texture = (struct wlr_pixman_texture *)_texture;
+	assert(texture);
+	if (!texture->wlr_texture.valid || texture->wlr_texture.format != format) {
+		return pixman_texture_upload_shm(&texture->wlr_texture, format,
+			buffer);
+	}
+
+	// A single composite clipped to the region
+	pixman_box32_t *extents = pixman_region32_extents(region);
+	pixman_image_set_clip_region32(texture->image, region);
+	bool ok = pixman_texture_update_shm(&texture->wlr_texture, format,
+		extents->x1, extents->y1, extents->x2 - extents->x1,
+		extents->y2 - extents->y1, buffer);
+	pixman_image_set_clip_region32(texture->image, NULL);
+	return ok;
+}
+
+static bool pixman_texture_upload_drm(struct wlr_texture *texture,
+		struct wl_resource *buf) {
+	wlr_log(L_ERROR, "DRM buffers are not supported by the pixman renderer");
+	return false;
+}
+
+static bool pixman_texture_upload_eglimage(struct wlr_texture *texture,
+		EGLImageKHR image, uint32_t width, uint32_t height) {
+	wlr_log(L_ERROR, "EGL images are not supported by the pixman renderer");
+	return false;
+}
+
+static void pixman_texture_get_matrix(struct wlr_texture *texture,
+		float (*matrix)[16], const float (*projection)[16], int x, int y) {
+	float world[16];
+	wlr_matrix_identity(matrix);
+	wlr_matrix_translate(&world, x, y, 0);
+	wlr_matrix_mul(matrix, &world, matrix);
+	wlr_matrix_scale(&world, texture->width, texture->height, 1);
+	wlr_matrix_mul(matrix, &world, matrix);
+	wlr_matrix_mul(projection, matrix, matrix);
+}
+
+static void pixman_texture_get_buffer_size(struct wlr_texture *texture,
+		struct wl_resource *resource, int *width, int *height) {
+	struct wl_shm_buffer *buffer = wl_shm_buffer_get(resource);
+	if (!buffer) {
+		return;
+	}
+	*width = wl_shm_buffer_get_width(buffer);
+	*height = wl_shm_buffer_get_height(buffer);
+}
+
+static void pixman_texture_bind(struct wlr_texture *texture) {
+	// No-op
+}
+
+static void pixman_texture_destroy(struct wlr_texture *_texture) {
+	struct wlr_pixman_texture *texture = (struct wlr_pixman_texture *)_texture;
+	wlr_signal_emit_safe(&texture->wlr_texture.destroy_signal,
+		&texture->wlr_texture);
+	if (texture->image != NULL) {
+		pixman_image_unref(texture->image);
+	}
+	free(texture);
+}
+
+static struct wlr_texture_impl wlr_texture_impl = {
+	.upload_pixels = pixman_texture_upload_pixels,
+	.update_pixels = pixman_texture_update_pixels,
+	.upload_shm = pixman_texture_upload_shm,
+	.update_shm = pixman_texture_update_shm,
+	.update_shm_region = pixman_texture_update_shm_region,
+	.upload_drm = pixman_texture_upload_drm,
+	.upload_eglimage = pixman_texture_upload_eglimage,
+	.get_matrix = pixman_texture_get_matrix,
+	.get_buffer_size = pixman_texture_get_buffer_size,
+	.bind = pixman_texture_bind,
+	.destroy = pixman_texture_destroy,
+};
+
+struct wlr_texture *pixman_texture_create() {
+	struct wlr_pixman_texture *texture;
+	if (!(texture = calloc(1, sizeof(struct wlr_pixman_texture)))) {
+		return NULL;
+	}
+	wlr_texture_init(&texture->wlr_texture, &wlr_texture_impl);
+	return &texture->wlr_texture;
+}
@@ -1,6 +1,8 @@
 #include <stdbool.h>
 #include <stdlib.h>
+#include <wayland-server.h>
 #include <wlr/render/interface.h>
+#include <wlr/util/log.h>
 
 void wlr_renderer_init(struct wlr_renderer *renderer,
 		struct wlr_renderer_impl *impl) {
@@ -68,6 +70,61 @@ bool wlr_renderer_read_pixels(struct wlr_renderer *r, enum wl_shm_format fmt,
 		dst_x, dst_y, data);
 }
 
+struct deferred_read {
+	void *pixels;
+	int32_t stride;
+	wlr_renderer_read_pixels_func_t done;
+	void *data;
+};
+
+static void deferred_read_handle_idle(void *data) {
+	struct deferred_read *read = data;
+	read->done(read->pixels, read->stride, read->data);
+	free(read->pixels);
+	free(read);
+}
+
+bool wlr_renderer_read_pixels_async(struct wlr_renderer *r,
+		struct wl_event_loop *loop, enum wl_shm_format fmt,
+		uint32_t width, uint32_t height, uint32_t src_x, uint32_t src_y,
+		wlr_renderer_read_pixels_func_t done, void *data) {
+	if (r->impl->read_pixels_async && r->impl->read_pixels_async(r, loop,
+			fmt, width, height, src_x, src_y, done, data)) {
+		return true;
+	}
+
+	// Fallback: read synchronously, but still report from the event loop so
+	// that callers don't have to care
+	struct deferred_read *read = calloc(1, sizeof(struct deferred_read));
+	if (read == NULL) {
+		wlr_log(L_ERROR, "Allocation failed");
+		return false;
+	}
+	read->done = done;
+	read->data = data;
+	// All the supported formats use at most 32 bits per pixel
+	read->stride = width * 4;
+	read->pixels = malloc(read->stride * height);
+	if (read->pixels == NULL) {
+		wlr_log(L_ERROR, "Allocation failed");
+		goto error;
+	}
+	if (!wlr_renderer_read_pixels(r, fmt, read->stride, width, height,
+			src_x, src_y, 0, 0, read->pixels)) {
+		goto error;
+	}
+
+	if (!wl_event_loop_add_idle(loop, deferred_read_handle_idle, read)) {
+		goto error;
+	}
+	return true;
+
+error:
+	free(read->pixels);
+	free(read);
+	return false;
+}
+
 bool wlr_renderer_format_supported(struct wlr_renderer *r,
 		enum wl_shm_format fmt) {
 	return r->impl->format_supported(r, fmt);
@@ -43,6 +43,24 @@ bool wlr_texture_update_shm(struct wlr_texture *texture, uint32_t format,
 	return texture->impl->update_shm(texture, format, x, y, width, height, shm);
 }
 
+bool wlr_texture_update_shm_region(struct wlr_texture *texture,
+		uint32_t format, pixman_region32_t *region, struct wl_shm_buffer *shm) {
+	if (texture->impl->update_shm_region) {
+		return texture->impl->update_shm_region(texture, format, region, shm);
+	}
+
+	int n;
+	pixman_box32_t *rects = pixman_region32_rectangles(region, &n);
+	for (int i = 0; i < n; ++i) {
+		if (!texture->impl->update_shm(texture, format, rects[i].x1,
+				rects[i].y1, rects[i].x2 - rects[i].x1,
+				rects[i].y2 - rects[i].y1, shm)) {
+			return false;
+		}
+	}
+	return true;
+}
+
 bool wlr_texture_upload_drm(struct wlr_texture *texture,
 		struct wl_resource *drm_buffer) {
 	return texture->impl->upload_drm(texture, drm_buffer);
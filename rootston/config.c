@@ -114,7 +114,29 @@ static uint32_t parse_modifier(const char *symname) {
 	}
 }
 
-void add_binding_config(struct wl_list *bindings, const char* combination,
+void roots_keysyms_sort(xkb_keysym_t *keysyms, size_t len) {
+	for (size_t i = 1; i < len; ++i) {
+		xkb_keysym_t sym = keysyms[i];
+		size_t j = i;
+		for (; j > 0 && keysyms[j - 1] > sym; --j) {
+			keysyms[j] = keysyms[j - 1];
+		}
+		keysyms[j] = sym;
+	}
+}
+
+static struct wl_list *binding_bucket(struct roots_config *config,
+		uint32_t modifiers, const xkb_keysym_t *keysyms, size_t keysyms_len) {
+	// FNV-1a
+	uint32_t hash = 2166136261u;
+	hash = (hash ^ modifiers) * 16777619u;
+	for (size_t i = 0; i < keysyms_len; ++i) {
+		hash = (hash ^ keysyms[i]) * 16777619u;
+	}
+	return &config->binding_buckets[hash & (ROOTS_CONFIG_BINDING_BUCKETS - 1)];
+}
+
+void add_binding_config(struct roots_config *config, const char* combination,
 		const char* command) {
 	struct roots_binding_config *bc =
 		calloc(1, sizeof(struct roots_binding_config));
@@ -136,6 +158,13 @@ void add_binding_config(struct wl_list *bindings, const char* combination,
 				bc = NULL;
 				break;
 			}
+			if (bc->keysyms_len == ROOTS_KEYBOARD_PRESSED_KEYSYMS_CAP) {
+				wlr_log(L_ERROR, "too many keysyms in key binding: %s",
+					combination);
+				free(bc);
+				bc = NULL;
+				break;
+			}
 			keysyms[bc->keysyms_len] = sym;
 			bc->keysyms_len++;
 		}
@@ -144,7 +173,13 @@ void add_binding_config(struct wl_list *bindings, const char* combination,
 	free(symnames);
 
 	if (bc) {
-		wl_list_insert(bindings, &bc->link);
+		// Lookups are made with the sorted set of pressed keysyms
+		roots_keysyms_sort(keysyms, bc->keysyms_len);
+
+		wl_list_insert(&config->bindings, &bc->link);
+		// Bindings added later take precedence
+		wl_list_insert(binding_bucket(config, bc->modifiers, keysyms,
+			bc->keysyms_len), &bc->bucket_link);
 		bc->command = strdup(command);
 		bc->keysyms = malloc(bc->keysyms_len * sizeof(xkb_keysym_t));
 		memcpy(bc->keysyms, keysyms, bc->keysyms_len * sizeof(xkb_keysym_t));
@@ -238,8 +273,13 @@ static int config_ini_handler(void *user, const char *section, const char *name,
 		if (strcmp(name, "xwayland") == 0) {
 			if (strcasecmp(value, "true") == 0) {
 				config->xwayland = true;
+				config->xwayland_lazy = false;
+			} else if (strcasecmp(value, "lazy") == 0) {
+				config->xwayland = true;
+				config->xwayland_lazy = true;
 			} else if (strcasecmp(value, "false") == 0) {
 				config->xwayland = false;
+				config->xwayland_lazy = false;
 			} else {
 				wlr_log(L_ERROR, "got unknown xwayland value: %s", value);
 			}
@@ -302,6 +342,19 @@ static int config_ini_handler(void *user, const char *section, const char *name,
 			} else {
 				wlr_log(L_ERROR, "got unknown transform value: %s", value);
 			}
+		} else if (strcmp(name, "max-render-time") == 0) {
+			if (strcmp(value, "auto") == 0) {
+				oc->max_render_time = ROOTS_CONFIG_RENDER_TIME_AUTO;
+			} else {
+				char *end;
+				long max_render_time = strtol(value, &end, 10);
+				if (*end || max_render_time < 0) {
+					wlr_log(L_ERROR, "got invalid max-render-time value: %s",
+						value);
+				} else {
+					oc->max_render_time = max_render_time;
+				}
+			}
 		} else if (strcmp(name, "mode") == 0) {
 			char *end;
 			oc->mode.width = strtol(value, &end, 10);
@@ -372,7 +425,7 @@ static int config_ini_handler(void *user, const char *section, const char *name,
 		const char *device_name = section + strlen(keyboard_prefix);
 		config_handle_keyboard(config, device_name, name, value);
 	} else if (strcmp(section, "bindings") == 0) {
-		add_binding_config(&config->bindings, name, value);
+		add_binding_config(config, name, value);
 	} else {
 		wlr_log(L_ERROR, "got unknown config section: %s", section);
 	}
@@ -392,6 +445,9 @@ struct roots_config *roots_config_create_from_args(int argc, char *argv[]) {
 	wl_list_init(&config->keyboards);
 	wl_list_init(&config->cursors);
 	wl_list_init(&config->bindings);
+	for (size_t i = 0; i < ROOTS_CONFIG_BINDING_BUCKETS; ++i) {
+		wl_list_init(&config->binding_buckets[i]);
+	}
 
 	int c;
 	while ((c = getopt(argc, argv, "C:E:h")) != -1) {
@@ -425,9 +481,9 @@ struct roots_config *roots_config_create_from_args(int argc, char *argv[]) {
 
 	if (result == -1) {
 		wlr_log(L_DEBUG, "No config file found. Using sensible defaults.");
-		add_binding_config(&config->bindings, "Logo+Shift+E", "exit");
-		add_binding_config(&config->bindings, "Ctrl+q", "close");
-		add_binding_config(&config->bindings, "Alt+Tab", "next_window");
+		add_binding_config(config, "Logo+Shift+E", "exit");
+		add_binding_config(config, "Ctrl+q", "close");
+		add_binding_config(config, "Alt+Tab", "next_window");
 		struct roots_keyboard_config *kc =
 			calloc(1, sizeof(struct roots_keyboard_config));
 		kc->meta_key = WLR_MODIFIER_LOGO;
@@ -483,6 +539,7 @@ void roots_config_destroy(struct roots_config *config) {
 
 	struct roots_binding_config *bc, *btmp = NULL;
 	wl_list_for_each_safe(bc, btmp, &config->bindings, link) {
+		wl_list_remove(&bc->bucket_link);
 		free(bc->keysyms);
 		free(bc->command);
 		free(bc);
@@ -492,6 +549,22 @@ void roots_config_destroy(struct roots_config *config) {
 	free(config);
 }
 
+struct roots_binding_config *roots_config_get_binding(
+		struct roots_config *config, uint32_t modifiers,
+		const xkb_keysym_t *keysyms, size_t keysyms_len) {
+	struct wl_list *bucket =
+		binding_bucket(config, modifiers, keysyms, keysyms_len);
+	struct roots_binding_config *bc;
+	wl_list_for_each(bc, bucket, bucket_link) {
+		if (bc->modifiers == modifiers && bc->keysyms_len == keysyms_len &&
+				memcmp(bc->keysyms, keysyms,
+					keysyms_len * sizeof(xkb_keysym_t)) == 0) {
+			return bc;
+		}
+	}
+	return NULL;
+}
+
 struct roots_output_config *roots_config_get_output(struct roots_config *config,
 		struct wlr_output *output) {
 	char name[83];
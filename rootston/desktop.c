@@ -89,39 +89,75 @@ enum roots_deco_part view_get_deco_part(struct roots_view *view, double sx, doub
 	return parts;
 }
 
-static void view_update_output(const struct roots_view *view,
-		const struct wlr_box *before) {
-	struct roots_desktop *desktop = view->desktop;
-	struct roots_output *output;
-	struct wlr_box box;
-	view_get_box(view, &box);
-	wl_list_for_each(output, &desktop->outputs, link) {
-		bool intersected = before != NULL && wlr_output_layout_intersects(
-			desktop->layout, output->wlr_output, before);
-		bool intersects = wlr_output_layout_intersects(desktop->layout,
-			output->wlr_output, &box);
-		if (intersected && !intersects) {
-			wlr_surface_send_leave(view->wlr_surface, output->wlr_output);
+static void surface_update_outputs(struct wlr_surface *surface, double lx,
+		double ly, float rotation, void *data) {
+	struct wlr_output_layout *layout = data;
+
+	struct wlr_box box = {
+		.x = lx,
+		.y = ly,
+		.width = surface->current->width,
+		.height = surface->current->height,
+	};
+	wlr_box_rotated_bounds(&box, -rotation, &box);
+	bool mapped = wlr_surface_has_buffer(surface) && !wlr_box_empty(&box);
+
+	struct wlr_surface_output *surface_output, *tmp;
+	wl_list_for_each_safe(surface_output, tmp, &surface->current_outputs,
+			link) {
+		if (!mapped || !wlr_output_layout_intersects(layout,
+				surface_output->output, &box)) {
+			wlr_surface_send_leave(surface, surface_output->output);
 		}
-		if (!intersected && intersects) {
-			wlr_surface_send_enter(view->wlr_surface, output->wlr_output);
+	}
+	if (!mapped) {
+		return;
+	}
+
+	struct wlr_output_layout_output *l_output;
+	wl_list_for_each(l_output, &layout->outputs, link) {
+		if (wlr_output_layout_intersects(layout, l_output->output, &box)) {
+			wlr_surface_send_enter(surface, l_output->output);
 		}
 	}
 }
 
+static void surface_leave_outputs(struct wlr_surface *surface) {
+	struct wlr_surface_output *surface_output, *tmp;
+	wl_list_for_each_safe(surface_output, tmp, &surface->current_outputs,
+			link) {
+		wlr_surface_send_leave(surface, surface_output->output);
+	}
+}
+
+static void surface_handle_leave_outputs(struct wlr_surface *surface,
+		double lx, double ly, float rotation, void *data) {
+	surface_leave_outputs(surface);
+}
+
+/**
+ * Sends enter and leave events to each surface of the view, for the outputs
+ * its own box entered or left. Surfaces keep track of the outputs they have
+ * entered, so this can be called after any change of the view.
+ */
+void view_update_outputs(struct roots_view *view) {
+	if (!view->grid.added) {
+		// Not displayed
+		return;
+	}
+	view_for_each_surface(view, surface_update_outputs, view->desktop->layout);
+}
+
 void view_move(struct roots_view *view, double x, double y) {
 	if (view->x == x && view->y == y) {
 		return;
 	}
 
-	struct wlr_box before;
-	view_get_box(view, &before);
 	if (view->move) {
 		view->move(view, x, y);
 	} else {
 		view_update_position(view, x, y);
 	}
-	view_update_output(view, &before);
 }
 
 void view_activate(struct roots_view *view, bool activate) {
@@ -131,12 +167,9 @@ void view_activate(struct roots_view *view, bool activate) {
 }
 
 void view_resize(struct roots_view *view, uint32_t width, uint32_t height) {
-	struct wlr_box before;
-	view_get_box(view, &before);
 	if (view->resize) {
 		view->resize(view, width, height);
 	}
-	view_update_output(view, &before);
 }
 
 void view_move_resize(struct roots_view *view, double x, double y,
@@ -277,6 +310,7 @@ void view_rotate(struct roots_view *view, float rotation) {
 	view_damage_whole(view);
 	view->rotation = rotation;
 	view_damage_whole(view);
+	view_update_outputs(view);
 }
 
 void view_cycle_alpha(struct roots_view *view) {
@@ -338,6 +372,8 @@ void view_child_finish(struct roots_view_child *child) {
 		return;
 	}
 	view_damage_whole(child->view);
+	// The surface isn't part of the view anymore
+	surface_leave_outputs(child->wlr_surface);
 	wl_list_remove(&child->link);
 	wl_list_remove(&child->commit.link);
 	wl_list_remove(&child->new_subsurface.link);
@@ -347,6 +383,7 @@ static void view_child_handle_commit(struct wl_listener *listener,
 		void *data) {
 	struct roots_view_child *child = wl_container_of(listener, child, commit);
 	view_apply_damage(child->view);
+	view_update_outputs(child->view);
 }
 
 static void view_child_handle_new_subsurface(struct wl_listener *listener,
@@ -367,6 +404,7 @@ void view_child_init(struct roots_view_child *child, struct roots_view *view,
 	child->new_subsurface.notify = view_child_handle_new_subsurface;
 	wl_signal_add(&wlr_surface->events.new_subsurface, &child->new_subsurface);
 	wl_list_insert(&view->children, &child->link);
+	view_update_outputs(view);
 }
 
 static void subsurface_destroy(struct roots_view_child *child) {
@@ -454,10 +492,12 @@ void view_setup(struct roots_view *view) {
 	}
 
 	view_center(view);
-	view_update_output(view, NULL);
+	view_update_outputs(view);
 }
 
 void view_apply_damage(struct roots_view *view) {
+	view_grid_update(&view->desktop->view_grid, view);
+
 	struct roots_output *output;
 	wl_list_for_each(output, &view->desktop->outputs, link) {
 		output_damage_from_view(output, view);
@@ -465,6 +505,8 @@ void view_apply_damage(struct roots_view *view) {
 }
 
 void view_damage_whole(struct roots_view *view) {
+	view_grid_update(&view->desktop->view_grid, view);
+
 	struct roots_output *output;
 	wl_list_for_each(output, &view->desktop->outputs, link) {
 		output_damage_whole_view(output, view);
@@ -480,6 +522,7 @@ void view_update_position(struct roots_view *view, double x, double y) {
 	view->x = x;
 	view->y = y;
 	view_damage_whole(view);
+	view_update_outputs(view);
 }
 
 void view_update_size(struct roots_view *view, uint32_t width, uint32_t height) {
@@ -593,19 +636,42 @@ struct roots_view *desktop_view_at(struct roots_desktop *desktop, double lx,
 		}
 	}
 
-	struct roots_view *view;
-	wl_list_for_each(view, &desktop->views, link) {
-		if (view_at(view, lx, ly, surface, sx, sy)) {
-			return view;
+	size_t len;
+	struct roots_view **views =
+		view_grid_views_at(&desktop->view_grid, lx, ly, &len);
+	for (size_t i = 0; i < len; ++i) {
+		if (view_at(views[i], lx, ly, surface, sx, sy)) {
+			return views[i];
 		}
 	}
 	return NULL;
 }
 
+void desktop_insert_view(struct roots_desktop *desktop,
+		struct roots_view *view) {
+	if (view->grid.added) {
+		wl_list_remove(&view->link);
+	}
+	wl_list_insert(&desktop->views, &view->link);
+	view_grid_add(&desktop->view_grid, view);
+}
+
+void desktop_remove_view(struct roots_desktop *desktop,
+		struct roots_view *view) {
+	view_for_each_surface(view, surface_handle_leave_outputs, NULL);
+	wl_list_remove(&view->link);
+	view_grid_remove(&desktop->view_grid, view);
+}
+
 static void handle_layout_change(struct wl_listener *listener, void *data) {
 	struct roots_desktop *desktop =
 		wl_container_of(listener, desktop, layout_change);
 
+	struct roots_view *view;
+	wl_list_for_each(view, &desktop->views, link) {
+		view_update_outputs(view);
+	}
+
 	struct wlr_output *center_output =
 		wlr_output_layout_get_center_output(desktop->layout);
 	if (center_output == NULL) {
@@ -617,7 +683,6 @@ static void handle_layout_change(struct wl_listener *listener, void *data) {
 	double center_x = center_output_box->x + center_output_box->width/2;
 	double center_y = center_output_box->y + center_output_box->height/2;
 
-	struct roots_view *view;
 	wl_list_for_each(view, &desktop->views, link) {
 		struct wlr_box box;
 		view_get_box(view, &box);
@@ -640,6 +705,7 @@ struct roots_desktop *desktop_create(struct roots_server *server,
 	}
 
 	wl_list_init(&desktop->views);
+	view_grid_init(&desktop->view_grid);
 	wl_list_init(&desktop->outputs);
 
 	desktop->new_output.notify = handle_new_output;
@@ -693,7 +759,7 @@ struct roots_desktop *desktop_create(struct roots_server *server,
 
 	if (config->xwayland) {
 		desktop->xwayland = wlr_xwayland_create(server->wl_display,
-			desktop->compositor);
+			desktop->compositor, config->xwayland_lazy);
 		wl_signal_add(&desktop->xwayland->events.new_surface,
 			&desktop->xwayland_surface);
 		desktop->xwayland_surface.notify = handle_xwayland_surface;
@@ -724,6 +790,7 @@ struct roots_desktop *desktop_create(struct roots_server *server,
 		wlr_primary_selection_device_manager_create(server->wl_display);
 	desktop->idle = wlr_idle_create(server->wl_display);
 	desktop->idle_inhibit = wlr_idle_inhibit_v1_create(server->wl_display);
+	desktop->presentation = wlr_presentation_create(server->wl_display);
 
 	return desktop;
 }
@@ -24,16 +24,6 @@ static ssize_t pressed_keysyms_index(xkb_keysym_t *pressed_keysyms,
 	return -1;
 }
 
-static size_t pressed_keysyms_length(xkb_keysym_t *pressed_keysyms) {
-	size_t n = 0;
-	for (size_t i = 0; i < ROOTS_KEYBOARD_PRESSED_KEYSYMS_CAP; ++i) {
-		if (pressed_keysyms[i] != XKB_KEY_NoSymbol) {
-			++n;
-		}
-	}
-	return n;
-}
-
 static void pressed_keysyms_add(xkb_keysym_t *pressed_keysyms,
 		xkb_keysym_t keysym) {
 	ssize_t i = pressed_keysyms_index(pressed_keysyms, keysym);
@@ -127,6 +117,11 @@ static void keyboard_binding_execute(struct roots_keyboard *keyboard,
 		}
 	} else if (strcmp(command, "nop") == 0) {
 		wlr_log(L_DEBUG, "nop command");
+	} else if (strcmp(command, "log_frame_timings") == 0) {
+		struct roots_output *output;
+		wl_list_for_each(output, &keyboard->input->server->desktop->outputs, link) {
+			wlr_output_log_timings(output->wlr_output);
+		}
 	} else if (strcmp(command, "toggle_outputs") == 0) {
 		outputs_enabled = !outputs_enabled;
 		struct roots_output *output;
@@ -186,28 +181,22 @@ static bool keyboard_execute_binding(struct roots_keyboard *keyboard,
 		}
 	}
 
-	// User-defined bindings
-	size_t n = pressed_keysyms_length(pressed_keysyms);
-	struct wl_list *bindings = &keyboard->input->server->config->bindings;
-	struct roots_binding_config *bc;
-	wl_list_for_each(bc, bindings, link) {
-		if (modifiers ^ bc->modifiers || n != bc->keysyms_len) {
-			continue;
-		}
-
-		bool ok = true;
-		for (size_t i = 0; i < bc->keysyms_len; i++) {
-			ssize_t j = pressed_keysyms_index(pressed_keysyms, bc->keysyms[i]);
-			if (j < 0) {
-				ok = false;
-				break;
-			}
+	// User-defined bindings, looked up with the sorted set of pressed keysyms
+	xkb_keysym_t sorted[ROOTS_KEYBOARD_PRESSED_KEYSYMS_CAP];
+	size_t n = 0;
+	for (size_t i = 0; i < ROOTS_KEYBOARD_PRESSED_KEYSYMS_CAP; ++i) {
+		xkb_keysym_t sym = pressed_keysyms[i];
+		if (sym != XKB_KEY_NoSymbol) {
+			sorted[n++] = sym;
 		}
+	}
+	roots_keysyms_sort(sorted, n);
 
-		if (ok) {
-			keyboard_binding_execute(keyboard, bc->command);
-			return true;
-		}
+	struct roots_binding_config *bc = roots_config_get_binding(
+		keyboard->input->server->config, modifiers, sorted, n);
+	if (bc != NULL) {
+		keyboard_binding_execute(keyboard, bc->command);
+		return true;
 	}
 
 	return false;
@@ -2,10 +2,12 @@
 #include <assert.h>
 #include <stdbool.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
 #include <wlr/render/matrix.h>
 #include <wlr/types/wlr_compositor.h>
 #include <wlr/types/wlr_output_layout.h>
+#include <wlr/types/wlr_presentation_time.h>
 #include <wlr/types/wlr_wl_shell.h>
 #include <wlr/types/wlr_xdg_shell_v6.h>
 #include <wlr/types/wlr_xdg_shell.h>
@@ -15,9 +17,6 @@
 #include "rootston/output.h"
 #include "rootston/server.h"
 
-typedef void (*surface_iterator_func_t)(struct wlr_surface *surface,
-	double lx, double ly, float rotation, void *data);
-
 /**
  * Rotate a child's position relative to a parent. The parent size is (pw, ph),
  * the child position is (*sx, *sy) and its size is (sw, sh).
@@ -137,7 +136,7 @@ static void wl_shell_surface_for_each_surface(
 	}
 }
 
-static void view_for_each_surface(struct roots_view *view,
+void view_for_each_surface(struct roots_view *view,
 		surface_iterator_func_t iterator, void *user_data) {
 	switch (view->type) {
 	case ROOTS_XDG_SHELL_V6_VIEW:
@@ -263,7 +262,8 @@ static void render_surface(struct wlr_surface *surface, double lx, double ly,
 		wlr_backend_get_renderer(output->wlr_output->backend);
 	assert(renderer);
 
-	if (!wlr_surface_has_buffer(surface)) {
+	if (!wlr_surface_has_buffer(surface) ||
+			surface == output->wlr_output->overlay_surface) {
 		return;
 	}
 
@@ -382,6 +382,103 @@ static void render_view(struct roots_view *view, struct render_data *data) {
 	view_for_each_surface(view, render_surface, data);
 }
 
+struct occlusion_data {
+	struct roots_output *output;
+	pixman_region32_t *opaque;
+};
+
+static void surface_add_opaque(struct wlr_surface *surface, double lx,
+		double ly, float rotation, void *_data) {
+	struct occlusion_data *data = _data;
+	struct wlr_output *wlr_output = data->output->wlr_output;
+
+	// Rotated surfaces don't cover their bounding box, ignore them
+	if (rotation != 0 || !wlr_surface_has_buffer(surface)) {
+		return;
+	}
+
+	struct wlr_box box;
+	bool intersects = surface_intersect_output(surface,
+		data->output->desktop->layout, wlr_output, lx, ly, rotation, &box);
+	if (!intersects) {
+		return;
+	}
+
+	pixman_region32_t opaque;
+	pixman_region32_init(&opaque);
+	uint32_t format = surface->texture->format;
+	if (format == WL_SHM_FORMAT_XRGB8888 ||
+			format == WL_SHM_FORMAT_XBGR8888) {
+		// Buffers without an alpha channel are entirely opaque
+		pixman_region32_union_rect(&opaque, &opaque, 0, 0,
+			surface->current->width, surface->current->height);
+	} else {
+		pixman_region32_intersect_rect(&opaque, &surface->current->opaque,
+			0, 0, surface->current->width, surface->current->height);
+	}
+	if (!pixman_region32_not_empty(&opaque)) {
+		goto opaque_finish;
+	}
+
+	wlr_region_transform_scale_translate(&opaque, &opaque,
+		WL_OUTPUT_TRANSFORM_NORMAL, 0, 0, wlr_output->scale, box.x, box.y);
+	if (wlr_output->scale != floor(wlr_output->scale)) {
+		// Scaled rectangles are rounded outwards, make sure pixels that are
+		// only partially covered by the surface are still painted below
+		wlr_region_expand(&opaque, &opaque, -1);
+	}
+	pixman_region32_union(data->opaque, data->opaque, &opaque);
+
+opaque_finish:
+	pixman_region32_fini(&opaque);
+}
+
+/**
+ * Removes the parts of `region` that are covered by opaque content of the
+ * view, so that anything below it doesn't need to be painted there.
+ */
+static void view_subtract_opaque(struct roots_view *view,
+		struct roots_output *output, pixman_region32_t *region) {
+	if (view->alpha < 1.0 || (view->fullscreen_output != NULL &&
+			view->fullscreen_output != output)) {
+		return;
+	}
+
+	pixman_region32_t opaque;
+	pixman_region32_init(&opaque);
+
+	if (view->decorated && view->wlr_surface != NULL &&
+			view->rotation == 0) {
+		struct wlr_box box;
+		get_decoration_box(view, output, &box);
+		pixman_region32_union_rect(&opaque, &opaque, box.x, box.y,
+			box.width, box.height);
+	}
+
+	struct occlusion_data data = {
+		.output = output,
+		.opaque = &opaque,
+	};
+	view_for_each_surface(view, surface_add_opaque, &data);
+
+	pixman_region32_subtract(region, region, &opaque);
+	pixman_region32_fini(&opaque);
+}
+
+static void clear_output(struct roots_output *output,
+		pixman_region32_t *damage, const float (*color)[4]) {
+	struct wlr_renderer *renderer =
+		wlr_backend_get_renderer(output->wlr_output->backend);
+	assert(renderer);
+
+	int nrects;
+	pixman_box32_t *rects = pixman_region32_rectangles(damage, &nrects);
+	for (int i = 0; i < nrects; ++i) {
+		scissor_output(output, &rects[i]);
+		wlr_renderer_clear(renderer, color);
+	}
+}
+
 static bool has_standalone_surface(struct roots_view *view) {
 	if (!wl_list_empty(&view->wlr_surface->subsurface_list)) {
 		return false;
@@ -402,6 +499,120 @@ static bool has_standalone_surface(struct roots_view *view) {
 	return true;
 }
 
+struct overlap_data {
+	struct roots_output *output;
+	const struct wlr_box *box;
+	bool overlaps;
+};
+
+static void surface_check_overlap(struct wlr_surface *surface, double lx,
+		double ly, float rotation, void *_data) {
+	struct overlap_data *data = _data;
+
+	struct wlr_box box;
+	if (!wlr_surface_has_buffer(surface) ||
+			!surface_intersect_output(surface, data->output->desktop->layout,
+				data->output->wlr_output, lx, ly, rotation, &box)) {
+		return;
+	}
+
+	struct wlr_box rotated, intersection;
+	wlr_box_rotated_bounds(&box, -rotation, &rotated);
+	if (wlr_box_intersection(&rotated, data->box, &intersection)) {
+		data->overlaps = true;
+	}
+}
+
+/**
+ * Finds a view which can be displayed on the overlay plane instead of being
+ * composited: the topmost view of the output, made of a single unrotated
+ * surface which is opaque on its whole box, with no drag icon above it.
+ * Populates `box` with its surface box in output-local coordinates.
+ */
+static struct roots_view *output_overlay_candidate(struct roots_output *output,
+		struct wlr_box *box) {
+	struct roots_desktop *desktop = output->desktop;
+
+	struct roots_view *view;
+	wl_list_for_each(view, &desktop->views, link) {
+		if (view->wlr_surface == NULL ||
+				!wlr_surface_has_buffer(view->wlr_surface) ||
+				!surface_intersect_output(view->wlr_surface, desktop->layout,
+					output->wlr_output, view->x, view->y, view->rotation,
+					box)) {
+			continue;
+		}
+
+		// Views below this one are covered, only this one can be lifted
+		if (view->rotation != 0 || view->alpha < 1.0 ||
+				view->fullscreen_output != NULL ||
+				!has_standalone_surface(view)) {
+			return NULL;
+		}
+
+		// Nothing is painted below the overlay plane, the surface has to hide
+		// the whole box
+		pixman_region32_t opaque;
+		pixman_region32_init(&opaque);
+		struct occlusion_data occlusion = {
+			.output = output,
+			.opaque = &opaque,
+		};
+		surface_add_opaque(view->wlr_surface, view->x, view->y,
+			view->rotation, &occlusion);
+		pixman_box32_t extents = {
+			.x1 = box->x,
+			.y1 = box->y,
+			.x2 = box->x + box->width,
+			.y2 = box->y + box->height,
+		};
+		bool covered = pixman_region32_contains_rectangle(&opaque, &extents) ==
+			PIXMAN_REGION_IN;
+		pixman_region32_fini(&opaque);
+		if (!covered) {
+			return NULL;
+		}
+
+		struct overlap_data data = {
+			.output = output,
+			.box = box,
+		};
+		drag_icons_for_each_surface(desktop->server->input,
+			surface_check_overlap, &data);
+		return data.overlaps ? NULL : view;
+	}
+	return NULL;
+}
+
+/**
+ * Damages the area where the overlay plane was displayed if it isn't anymore,
+ * since the frame doesn't contain what was below it.
+ */
+static void output_update_overlay(struct roots_output *output,
+		const struct wlr_box *box, pixman_region32_t *damage) {
+	if (output->overlay_active && (box == NULL ||
+			memcmp(&output->overlay_box, box, sizeof(struct wlr_box)) != 0)) {
+		struct wlr_box *old = &output->overlay_box;
+		wlr_output_damage_add_box(output->damage, old);
+		pixman_region32_union_rect(damage, damage, old->x, old->y,
+			old->width, old->height);
+	}
+}
+
+static void surface_sampled(struct wlr_surface *surface, double lx,
+		double ly, float rotation, void *_data) {
+	struct render_data *data = _data;
+	struct roots_output *output = data->output;
+
+	if (!surface_intersect_output(surface, output->desktop->layout,
+			output->wlr_output, lx, ly, rotation, NULL)) {
+		return;
+	}
+
+	wlr_presentation_surface_sampled(output->desktop->presentation, surface,
+		output->wlr_output);
+}
+
 static void surface_send_frame_done(struct wlr_surface *surface, double lx,
 		double ly, float rotation, void *_data) {
 	struct render_data *data = _data;
@@ -416,6 +627,49 @@ static void surface_send_frame_done(struct wlr_surface *surface, double lx,
 	wlr_surface_send_frame_done(surface, when);
 }
 
+/**
+ * Returns whether the view may be displayed on the output. This doesn't walk
+ * its surfaces: the view bounds are only updated when the view changes.
+ */
+static bool view_on_output(struct roots_view *view,
+		struct roots_output *output, const struct wlr_box *output_box) {
+	return view_grid_view_intersects(&output->desktop->view_grid, view,
+		output_box);
+}
+
+/**
+ * Iterates over the surfaces of the views which may be displayed by the
+ * output. Surfaces of these views may still not intersect it.
+ */
+static void output_for_each_surface(struct roots_output *output,
+		surface_iterator_func_t iterator, void *user_data) {
+	struct roots_desktop *desktop = output->desktop;
+
+	if (output->fullscreen_view != NULL) {
+		struct roots_view *view = output->fullscreen_view;
+		view_for_each_surface(view, iterator, user_data);
+
+#ifdef WLR_HAS_XWAYLAND
+		if (view->type == ROOTS_XWAYLAND_VIEW) {
+			xwayland_children_for_each_surface(view->xwayland_surface,
+				iterator, user_data);
+		}
+#endif
+	} else {
+		const struct wlr_box *output_box =
+			wlr_output_layout_get_box(desktop->layout, output->wlr_output);
+		struct roots_view *view;
+		wl_list_for_each_reverse(view, &desktop->views, link) {
+			if (view_on_output(view, output, output_box)) {
+				view_for_each_surface(view, iterator, user_data);
+			}
+		}
+
+		drag_icons_for_each_surface(desktop->server->input, iterator,
+			user_data);
+	}
+}
+
 static void render_output(struct roots_output *output) {
 	struct wlr_output *wlr_output = output->wlr_output;
 	struct roots_desktop *desktop = output->desktop;
@@ -459,7 +713,7 @@ static void render_output(struct roots_output *output) {
 		wlr_output_set_fullscreen_surface(wlr_output, NULL);
 	}
 
-	bool needs_swap;
+	bool needs_swap, swapped = false;
 	pixman_region32_t damage;
 	pixman_region32_init(&damage);
 	if (!wlr_output_damage_make_current(output->damage, &needs_swap, &damage)) {
@@ -477,6 +731,27 @@ static void render_output(struct roots_output *output) {
 		goto damage_finish;
 	}
 
+	// Lift the topmost view to the overlay plane if the backend can display
+	// it there, so that it doesn't need to be composited
+	struct roots_view *overlay_view = NULL;
+	struct wlr_box overlay_box;
+	if (output->fullscreen_view == NULL) {
+		overlay_view = output_overlay_candidate(output, &overlay_box);
+		if (overlay_view != NULL && !wlr_output_attach_overlay(wlr_output,
+				overlay_view->wlr_surface, &overlay_box)) {
+			overlay_view = NULL;
+		}
+	}
+	output_update_overlay(output, overlay_view ? &overlay_box : NULL, &damage);
+	if (overlay_view != NULL) {
+		// Nothing below the overlay plane is visible
+		pixman_region32_t overlay_region;
+		pixman_region32_init_rect(&overlay_region, overlay_box.x,
+			overlay_box.y, overlay_box.width, overlay_box.height);
+		pixman_region32_subtract(&damage, &damage, &overlay_region);
+		pixman_region32_fini(&overlay_region);
+	}
+
 	wlr_renderer_begin(renderer, wlr_output);
 
 	if (!pixman_region32_not_empty(&damage)) {
@@ -484,17 +759,12 @@ static void render_output(struct roots_output *output) {
 		goto renderer_end;
 	}
 
-	int nrects;
-	pixman_box32_t *rects = pixman_region32_rectangles(&damage, &nrects);
-	for (int i = 0; i < nrects; ++i) {
-		scissor_output(output, &rects[i]);
-		wlr_renderer_clear(renderer, &clear_color);
-	}
-
 	// If a view is fullscreen on this output, render it
 	if (output->fullscreen_view != NULL) {
 		struct roots_view *view = output->fullscreen_view;
 
+		clear_output(output, &damage, &clear_color);
+
 		if (wlr_output->fullscreen_surface == view->wlr_surface) {
 			// The output will render the fullscreen view
 			goto renderer_end;
@@ -515,51 +785,86 @@ static void render_output(struct roots_output *output) {
 		goto renderer_end;
 	}
 
-	// Render all views
+	// Views are stored front to back. Walk them in this order to find out
+	// which part of the damage each view still needs to repaint once the
+	// opaque regions of the views above it have been subtracted.
+	size_t nviews = wl_list_length(&desktop->views);
+	pixman_region32_t *views_damage =
+		calloc(nviews, sizeof(pixman_region32_t));
+	if (nviews > 0 && views_damage == NULL) {
+		wlr_log(L_ERROR, "Allocation failed");
+		goto renderer_end;
+	}
+
+	pixman_region32_t remaining;
+	pixman_region32_init(&remaining);
+	pixman_region32_copy(&remaining, &damage);
+
+	// Views which aren't on this output are left with no damage
+	const struct wlr_box *output_box =
+		wlr_output_layout_get_box(desktop->layout, wlr_output);
 	struct roots_view *view;
+	size_t i = 0;
+	wl_list_for_each(view, &desktop->views, link) {
+		pixman_region32_init(&views_damage[i]);
+		if (view_on_output(view, output, output_box)) {
+			pixman_region32_copy(&views_damage[i], &remaining);
+			if (pixman_region32_not_empty(&remaining)) {
+				view_subtract_opaque(view, output, &remaining);
+			}
+		}
+		++i;
+	}
+
+	// Only clear what isn't covered by any opaque view
+	clear_output(output, &remaining, &clear_color);
+	pixman_region32_fini(&remaining);
+
+	// Render all views
 	wl_list_for_each_reverse(view, &desktop->views, link) {
-		render_view(view, &data);
+		--i;
+		if (pixman_region32_not_empty(&views_damage[i])) {
+			data.damage = &views_damage[i];
+			render_view(view, &data);
+		}
+		pixman_region32_fini(&views_damage[i]);
 	}
+	free(views_damage);
 
 	// Render drag icons
+	data.damage = &damage;
 	drag_icons_for_each_surface(server->input, render_surface, &data);
 
 renderer_end:
 	wlr_renderer_scissor(renderer, NULL);
 	wlr_renderer_end(renderer);
-	if (!wlr_output_damage_swap_buffers(output->damage, &now, &damage)) {
+	bool ok = wlr_output_damage_swap_buffers(output->damage, &now, &damage);
+	// A plane which couldn't be disabled still covers its old box, which is
+	// damaged again until it is gone
+	output->overlay_active = wlr_output->overlay_enabled;
+	output->overlay_box = wlr_output->overlay_box;
+	if (!ok) {
 		goto damage_finish;
 	}
 	output->last_frame = desktop->last_frame = now;
+	swapped = true;
 
 damage_finish:
 	pixman_region32_fini(&damage);
 
-	// Send frame done events to all surfaces
-	if (output->fullscreen_view != NULL) {
-		struct roots_view *view = output->fullscreen_view;
-		if (wlr_output->fullscreen_surface == view->wlr_surface) {
-			// The surface is managed by the wlr_output
-			return;
-		}
-
-		view_for_each_surface(view, surface_send_frame_done, &data);
-
-#ifdef WLR_HAS_XWAYLAND
-		if (view->type == ROOTS_XWAYLAND_VIEW) {
-			xwayland_children_for_each_surface(view->xwayland_surface,
-				surface_send_frame_done, &data);
-		}
-#endif
-	} else {
-		struct roots_view *view;
-		wl_list_for_each_reverse(view, &desktop->views, link) {
-			view_for_each_surface(view, surface_send_frame_done, &data);
-		}
+	if (swapped) {
+		// Content updates displayed by the output are part of this frame
+		output_for_each_surface(output, surface_sampled, &data);
+	}
 
-		drag_icons_for_each_surface(server->input, surface_send_frame_done,
-			&data);
+	// Send frame done events to all surfaces
+	if (output->fullscreen_view != NULL &&
+			wlr_output->fullscreen_surface ==
+			output->fullscreen_view->wlr_surface) {
+		// The surface is managed by the wlr_output
+		return;
 	}
+	output_for_each_surface(output, surface_send_frame_done, &data);
 }
 
 void output_damage_whole(struct roots_output *output) {
@@ -662,15 +967,15 @@ static void damage_from_surface(struct wlr_surface *surface,
 	if (rotation == 0) {
 		pixman_region32_t damage;
 		pixman_region32_init(&damage);
-		pixman_region32_copy(&damage, &surface->current->surface_damage);
-		wlr_region_scale(&damage, &damage, wlr_output->scale);
+		wlr_region_transform_scale_translate(&damage,
+			&surface->current->surface_damage, WL_OUTPUT_TRANSFORM_NORMAL,
+			0, 0, wlr_output->scale, box.x, box.y);
 		if (ceil(wlr_output->scale) > surface->current->scale) {
 			// When scaling up a surface, it'll become blurry so we need to
 			// expand the damage region
 			wlr_region_expand(&damage, &damage,
 				ceil(wlr_output->scale) - surface->current->scale);
 		}
-		pixman_region32_translate(&damage, box.x, box.y);
 		wlr_output_damage_add(output->damage, &damage);
 	} else {
 		pixman_box32_t *extents =
@@ -732,6 +1037,10 @@ static void output_destroy(struct roots_output *output) {
 	wl_list_remove(&output->destroy.link);
 	wl_list_remove(&output->damage_frame.link);
 	wl_list_remove(&output->damage_destroy.link);
+	wl_list_remove(&output->present.link);
+	if (output->repaint_timer != NULL) {
+		wl_event_source_remove(output->repaint_timer);
+	}
 	free(output);
 }
 
@@ -740,11 +1049,106 @@ static void output_handle_destroy(struct wl_listener *listener, void *data) {
 	output_destroy(output);
 }
 
+#define RENDER_TIME_SAMPLES 16
+// Accounts for the GPU work and the event loop latency
+#define RENDER_TIME_MARGIN_NSEC 1000000
+
+static int64_t timespec_to_nsec(const struct timespec *a) {
+	return (int64_t)a->tv_sec * 1000000000 + a->tv_nsec;
+}
+
+/**
+ * Returns the time needed to render a frame, in nanoseconds.
+ */
+static int64_t output_render_time(struct roots_output *output) {
+	if (output->max_render_time != ROOTS_CONFIG_RENDER_TIME_AUTO) {
+		return (int64_t)output->max_render_time * 1000000;
+	}
+
+	struct wlr_output *wlr_output = output->wlr_output;
+	int64_t refresh = wlr_output->refresh > 0 ?
+		1000000000000ll / wlr_output->refresh : 0;
+	int64_t render_time = 0;
+	for (size_t age = 0; age < RENDER_TIME_SAMPLES; ++age) {
+		const struct wlr_output_frame_timing *timing =
+			wlr_output_get_frame_timing(wlr_output, age);
+		if (timing == NULL) {
+			break;
+		}
+		if (timing->submit.tv_sec == 0 && timing->submit.tv_nsec == 0) {
+			continue;
+		}
+		int64_t t = timespec_to_nsec(&timing->submit) -
+			timespec_to_nsec(&timing->render_start);
+		if (refresh > 0 && t > refresh) {
+			// Rendering is slower than the display, it can't be delayed at
+			// all: a longer sample doesn't change that
+			t = refresh;
+		}
+		if (t > render_time) {
+			render_time = t;
+		}
+	}
+	return render_time + RENDER_TIME_MARGIN_NSEC;
+}
+
+/**
+ * Returns how long rendering can be delayed so that it finishes right before
+ * the next vblank, in milliseconds.
+ */
+static int output_repaint_delay(struct roots_output *output) {
+	struct wlr_output *wlr_output = output->wlr_output;
+	if (output->max_render_time == 0 || wlr_output->refresh <= 0 ||
+			(output->last_present.tv_sec == 0 &&
+			output->last_present.tv_nsec == 0)) {
+		return 0;
+	}
+
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	int64_t now_nsec = timespec_to_nsec(&now);
+
+	// Predict the next vblank from the last presentation
+	int64_t refresh = 1000000000000ll / wlr_output->refresh;
+	int64_t next_vblank = timespec_to_nsec(&output->last_present) + refresh;
+	if (next_vblank <= now_nsec) {
+		next_vblank += ((now_nsec - next_vblank) / refresh + 1) * refresh;
+	}
+
+	int64_t delay = next_vblank - output_render_time(output) - now_nsec;
+	return delay > 0 ? delay / 1000000 : 0;
+}
+
+static int output_handle_repaint_timer(void *data) {
+	struct roots_output *output = data;
+	render_output(output);
+	return 0;
+}
+
 static void output_damage_handle_frame(struct wl_listener *listener,
 		void *data) {
 	struct roots_output *output =
 		wl_container_of(listener, output, damage_frame);
-	render_output(output);
+
+	int delay = output_repaint_delay(output);
+	if (delay == 0 || output->repaint_timer == NULL) {
+		render_output(output);
+		return;
+	}
+	// Input received until then will make it in this frame
+	wl_event_source_timer_update(output->repaint_timer, delay);
+}
+
+static void output_handle_present(struct wl_listener *listener, void *data) {
+	struct roots_output *output = wl_container_of(listener, output, present);
+	struct wlr_output_event_present *output_event = data;
+
+	output->last_present = *output_event->when;
+
+	struct wlr_presentation_event event;
+	wlr_presentation_event_from_output(&event, output_event);
+	wlr_presentation_send_output_presented(output->desktop->presentation,
+		&event);
 }
 
 static void output_damage_handle_destroy(struct wl_listener *listener,
@@ -780,16 +1184,24 @@ void handle_new_output(struct wl_listener *listener, void *data) {
 
 	output->damage = wlr_output_damage_create(wlr_output);
 
+	struct wl_event_loop *event_loop =
+		wl_display_get_event_loop(desktop->server->wl_display);
+	output->repaint_timer = wl_event_loop_add_timer(event_loop,
+		output_handle_repaint_timer, output);
+
 	output->destroy.notify = output_handle_destroy;
 	wl_signal_add(&wlr_output->events.destroy, &output->destroy);
 	output->damage_frame.notify = output_damage_handle_frame;
 	wl_signal_add(&output->damage->events.frame, &output->damage_frame);
 	output->damage_destroy.notify = output_damage_handle_destroy;
 	wl_signal_add(&output->damage->events.destroy, &output->damage_destroy);
+	output->present.notify = output_handle_present;
+	wl_signal_add(&wlr_output->events.present, &output->present);
 
 	struct roots_output_config *output_config =
 		roots_config_get_output(config, wlr_output);
 	if (output_config) {
+		output->max_render_time = output_config->max_render_time;
 		if (output_config->enable) {
 			if (output_config->mode.width) {
 				set_mode(wlr_output, output_config);
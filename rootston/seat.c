@@ -710,8 +710,7 @@ void roots_seat_set_focus(struct roots_seat *seat, struct roots_view *view) {
 	// Make sure the view will be rendered on top of others, even if it's
 	// already focused in this seat
 	if (view != NULL) {
-		wl_list_remove(&view->link);
-		wl_list_insert(&seat->input->server->desktop->views, &view->link);
+		desktop_insert_view(view->desktop, view);
 	}
 
 	struct roots_view *prev_focus = roots_seat_get_focus(seat);
@@ -865,7 +864,7 @@ void roots_seat_end_compositor_grab(struct roots_seat *seat) {
 			view_move_resize(view, cursor->view_x, cursor->view_y, cursor->view_width, cursor->view_height);
 			break;
 		case ROOTS_CURSOR_ROTATE:
-			view->rotation = cursor->view_rotation;
+			view_rotate(view, cursor->view_rotation);
 			break;
 		case ROOTS_CURSOR_PASSTHROUGH:
 			break;
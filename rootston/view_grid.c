@@ -0,0 +1,274 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wlr/types/wlr_box.h>
+#include <wlr/types/wlr_surface.h>
+#include <wlr/util/log.h>
+#include "rootston/output.h"
+#include "rootston/view.h"
+#include "rootston/view_grid.h"
+
+static int cell_coord(double v) {
+	return floor(v / ROOTS_VIEW_GRID_CELL_SIZE);
+}
+
+static struct wl_list *grid_bucket(struct roots_view_grid *grid, int x, int y) {
+	uint32_t hash = (uint32_t)x * 73856093u ^ (uint32_t)y * 19349663u;
+	return &grid->buckets[hash & (ROOTS_VIEW_GRID_BUCKETS - 1)];
+}
+
+static struct roots_view_grid_cell *grid_get_cell(struct roots_view_grid *grid,
+		int x, int y, bool create) {
+	struct wl_list *bucket = grid_bucket(grid, x, y);
+	struct roots_view_grid_cell *cell;
+	wl_list_for_each(cell, bucket, link) {
+		if (cell->x == x && cell->y == y) {
+			return cell;
+		}
+	}
+	if (!create) {
+		return NULL;
+	}
+
+	cell = calloc(1, sizeof(struct roots_view_grid_cell));
+	if (cell == NULL) {
+		wlr_log(L_ERROR, "Allocation failed");
+		return NULL;
+	}
+	cell->x = x;
+	cell->y = y;
+	wl_list_insert(bucket, &cell->link);
+	return cell;
+}
+
+static void cell_destroy(struct roots_view_grid_cell *cell) {
+	wl_list_remove(&cell->link);
+	free(cell->views);
+	free(cell);
+}
+
+static void cell_insert(struct roots_view_grid_cell *cell,
+		struct roots_view *view) {
+	if (cell->len == cell->cap) {
+		size_t cap = cell->cap == 0 ? 4 : cell->cap * 2;
+		struct roots_view **views =
+			realloc(cell->views, cap * sizeof(struct roots_view *));
+		if (views == NULL) {
+			wlr_log(L_ERROR, "Allocation failed");
+			return;
+		}
+		cell->views = views;
+		cell->cap = cap;
+	}
+
+	// Keep views sorted from front to back
+	size_t i = 0;
+	while (i < cell->len && cell->views[i]->grid.z > view->grid.z) {
+		++i;
+	}
+	memmove(&cell->views[i + 1], &cell->views[i],
+		(cell->len - i) * sizeof(struct roots_view *));
+	cell->views[i] = view;
+	++cell->len;
+}
+
+static void cell_remove(struct roots_view_grid_cell *cell,
+		struct roots_view *view) {
+	for (size_t i = 0; i < cell->len; ++i) {
+		if (cell->views[i] == view) {
+			memmove(&cell->views[i], &cell->views[i + 1],
+				(cell->len - i - 1) * sizeof(struct roots_view *));
+			--cell->len;
+			break;
+		}
+	}
+	if (cell->len == 0) {
+		cell_destroy(cell);
+	}
+}
+
+struct bounds_data {
+	bool empty;
+	double x1, y1, x2, y2;
+};
+
+static void bounds_add_box(struct bounds_data *data, const struct wlr_box *box) {
+	if (data->empty) {
+		data->x1 = box->x;
+		data->y1 = box->y;
+		data->x2 = box->x + box->width;
+		data->y2 = box->y + box->height;
+		data->empty = false;
+		return;
+	}
+	data->x1 = fmin(data->x1, box->x);
+	data->y1 = fmin(data->y1, box->y);
+	data->x2 = fmax(data->x2, box->x + box->width);
+	data->y2 = fmax(data->y2, box->y + box->height);
+}
+
+static void bounds_add_surface(struct wlr_surface *surface, double lx,
+		double ly, float rotation, void *_data) {
+	struct bounds_data *data = _data;
+	if (!wlr_surface_has_buffer(surface)) {
+		return;
+	}
+
+	struct wlr_box box = {
+		.x = floor(lx),
+		.y = floor(ly),
+		.width = surface->current->width + 1,
+		.height = surface->current->height + 1,
+	};
+	struct wlr_box rotated;
+	wlr_box_rotated_bounds(&box, -rotation, &rotated);
+	bounds_add_box(data, &rotated);
+}
+
+/**
+ * Computes a box containing every point where `view_at` may succeed and
+ * everything the view renders, in layout coordinates.
+ */
+static bool view_get_bounds(struct roots_view *view, struct wlr_box *bounds) {
+	if (view->wlr_surface == NULL) {
+		return false;
+	}
+
+	struct bounds_data data = { .empty = true };
+	view_for_each_surface(view, bounds_add_surface, &data);
+
+	struct wlr_box deco_box;
+	view_get_deco_box(view, &deco_box);
+	if (view->rotation != 0.0) {
+		// Decorations rotate around the center of the view, not their own:
+		// use the circle they describe
+		double cx = view->x + (double)view->width / 2;
+		double cy = view->y + (double)view->height / 2;
+		double rx = fmax(fabs(deco_box.x - cx),
+			fabs(deco_box.x + deco_box.width - cx));
+		double ry = fmax(fabs(deco_box.y - cy),
+			fabs(deco_box.y + deco_box.height - cy));
+		double r = ceil(sqrt(rx * rx + ry * ry));
+		deco_box.x = floor(cx - r);
+		deco_box.y = floor(cy - r);
+		deco_box.width = deco_box.height = 2 * r + 1;
+	}
+	bounds_add_box(&data, &deco_box);
+
+	bounds->x = floor(data.x1);
+	bounds->y = floor(data.y1);
+	bounds->width = ceil(data.x2) - bounds->x;
+	bounds->height = ceil(data.y2) - bounds->y;
+	return true;
+}
+
+static void grid_unlink_view(struct roots_view_grid *grid,
+		struct roots_view *view) {
+	if (!view->grid.linked) {
+		return;
+	}
+	for (int y = view->grid.y1; y < view->grid.y2; ++y) {
+		for (int x = view->grid.x1; x < view->grid.x2; ++x) {
+			struct roots_view_grid_cell *cell =
+				grid_get_cell(grid, x, y, false);
+			if (cell != NULL) {
+				cell_remove(cell, view);
+			}
+		}
+	}
+	view->grid.linked = false;
+}
+
+static void grid_link_view(struct roots_view_grid *grid,
+		struct roots_view *view) {
+	struct wlr_box *bounds = &view->grid.bounds;
+	if (!view_get_bounds(view, bounds)) {
+		return;
+	}
+	view->grid.x1 = cell_coord(bounds->x);
+	view->grid.y1 = cell_coord(bounds->y);
+	view->grid.x2 = cell_coord(bounds->x + bounds->width) + 1;
+	view->grid.y2 = cell_coord(bounds->y + bounds->height) + 1;
+	for (int y = view->grid.y1; y < view->grid.y2; ++y) {
+		for (int x = view->grid.x1; x < view->grid.x2; ++x) {
+			struct roots_view_grid_cell *cell =
+				grid_get_cell(grid, x, y, true);
+			if (cell != NULL) {
+				cell_insert(cell, view);
+			}
+		}
+	}
+	view->grid.linked = true;
+}
+
+static void grid_flush(struct roots_view_grid *grid) {
+	struct roots_view *view, *tmp;
+	wl_list_for_each_safe(view, tmp, &grid->dirty, grid.dirty_link) {
+		grid_unlink_view(grid, view);
+		grid_link_view(grid, view);
+		wl_list_remove(&view->grid.dirty_link);
+		wl_list_init(&view->grid.dirty_link);
+	}
+}
+
+void view_grid_init(struct roots_view_grid *grid) {
+	for (size_t i = 0; i < ROOTS_VIEW_GRID_BUCKETS; ++i) {
+		wl_list_init(&grid->buckets[i]);
+	}
+	wl_list_init(&grid->dirty);
+	grid->next_z = 0;
+}
+
+void view_grid_add(struct roots_view_grid *grid, struct roots_view *view) {
+	if (!view->grid.added) {
+		wl_list_init(&view->grid.dirty_link);
+		view->grid.added = true;
+	}
+	// The view needs to move to the front of its cells
+	grid_unlink_view(grid, view);
+	view->grid.z = ++grid->next_z;
+	view_grid_update(grid, view);
+}
+
+void view_grid_remove(struct roots_view_grid *grid, struct roots_view *view) {
+	if (!view->grid.added) {
+		return;
+	}
+	grid_unlink_view(grid, view);
+	wl_list_remove(&view->grid.dirty_link);
+	view->grid.added = false;
+}
+
+void view_grid_update(struct roots_view_grid *grid, struct roots_view *view) {
+	if (!view->grid.added || !wl_list_empty(&view->grid.dirty_link)) {
+		return;
+	}
+	wl_list_insert(&grid->dirty, &view->grid.dirty_link);
+}
+
+struct roots_view **view_grid_views_at(struct roots_view_grid *grid,
+		double lx, double ly, size_t *len) {
+	grid_flush(grid);
+
+	struct roots_view_grid_cell *cell =
+		grid_get_cell(grid, cell_coord(lx), cell_coord(ly), false);
+	if (cell == NULL) {
+		*len = 0;
+		return NULL;
+	}
+	*len = cell->len;
+	return cell->views;
+}
+
+bool view_grid_view_intersects(struct roots_view_grid *grid,
+		struct roots_view *view, const struct wlr_box *box) {
+	if (!view->grid.added) {
+		// Not tracked, assume it may be anywhere
+		return true;
+	}
+	grid_flush(grid);
+
+	struct wlr_box intersection;
+	return view->grid.linked &&
+		wlr_box_intersection(&view->grid.bounds, box, &intersection);
+}
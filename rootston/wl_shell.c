@@ -162,6 +162,7 @@ static void handle_surface_commit(struct wl_listener *listener, void *data) {
 		view->pending_move_resize.update_y = false;
 	}
 	view_update_position(view, x, y);
+	view_update_outputs(view);
 }
 
 static void handle_new_popup(struct wl_listener *listener, void *data) {
@@ -181,7 +182,8 @@ static void handle_destroy(struct wl_listener *listener, void *data) {
 	wl_list_remove(&roots_surface->request_fullscreen.link);
 	wl_list_remove(&roots_surface->set_state.link);
 	wl_list_remove(&roots_surface->surface_commit.link);
-	wl_list_remove(&roots_surface->view->link);
+	desktop_remove_view(roots_surface->view->desktop,
+		roots_surface->view);
 	view_finish(roots_surface->view);
 	free(roots_surface->view);
 	free(roots_surface);
@@ -243,7 +245,7 @@ void handle_wl_shell_surface(struct wl_listener *listener, void *data) {
 	view->close = close;
 	roots_surface->view = view;
 	view_init(view, desktop);
-	wl_list_insert(&desktop->views, &view->link);
+	desktop_insert_view(desktop, view);
 
 	view_setup(view);
 
@@ -268,6 +268,8 @@ static void handle_surface_commit(struct wl_listener *listener, void *data) {
 			roots_surface->pending_move_resize_configure_serial = 0;
 		}
 	}
+
+	view_update_outputs(view);
 }
 
 static void handle_new_popup(struct wl_listener *listener, void *data) {
@@ -287,7 +289,8 @@ static void handle_destroy(struct wl_listener *listener, void *data) {
 	wl_list_remove(&roots_xdg_surface->request_resize.link);
 	wl_list_remove(&roots_xdg_surface->request_maximize.link);
 	wl_list_remove(&roots_xdg_surface->request_fullscreen.link);
-	wl_list_remove(&roots_xdg_surface->view->link);
+	desktop_remove_view(roots_xdg_surface->view->desktop,
+		roots_xdg_surface->view);
 	view_finish(roots_xdg_surface->view);
 	free(roots_xdg_surface->view);
 	free(roots_xdg_surface);
@@ -357,7 +360,7 @@ void handle_xdg_shell_v6_surface(struct wl_listener *listener, void *data) {
 	view->height = box.height;
 
 	view_init(view, desktop);
-	wl_list_insert(&desktop->views, &view->link);
+	desktop_insert_view(desktop, view);
 
 	view_setup(view);
 }
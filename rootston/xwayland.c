@@ -119,7 +119,8 @@ static void handle_destroy(struct wl_listener *listener, void *data) {
 	wl_list_remove(&roots_surface->map_notify.link);
 	wl_list_remove(&roots_surface->unmap_notify.link);
 	if (xwayland_surface->mapped) {
-		wl_list_remove(&roots_surface->view->link);
+		desktop_remove_view(roots_surface->view->desktop,
+			roots_surface->view);
 	}
 	view_finish(roots_surface->view);
 	free(roots_surface->view);
@@ -224,6 +225,7 @@ static void handle_surface_commit(struct wl_listener *listener, void *data) {
 		view->pending_move_resize.update_y = false;
 	}
 	view_update_position(view, x, y);
+	view_update_outputs(view);
 }
 
 static void handle_map_notify(struct wl_listener *listener, void *data) {
@@ -238,7 +240,7 @@ static void handle_map_notify(struct wl_listener *listener, void *data) {
 	view->y = xsurface->y;
 	view->width = xsurface->surface->current->width;
 	view->height = xsurface->surface->current->height;
-	wl_list_insert(&desktop->views, &view->link);
+	desktop_insert_view(desktop, view);
 
 	struct wlr_subsurface *subsurface;
 	wl_list_for_each(subsurface, &view->wlr_surface->subsurface_list,
@@ -247,6 +249,7 @@ static void handle_map_notify(struct wl_listener *listener, void *data) {
 	}
 
 	view_damage_whole(view);
+	view_update_outputs(view);
 
 	roots_surface->surface_commit.notify = handle_surface_commit;
 	wl_signal_add(&xsurface->surface->events.commit,
@@ -273,9 +276,9 @@ static void handle_unmap_notify(struct wl_listener *listener, void *data) {
 		view->fullscreen_output = NULL;
 	}
 
+	desktop_remove_view(view->desktop, view);
 	view->wlr_surface = NULL;
 	view->width = view->height = 0;
-	wl_list_remove(&view->link);
 }
 
 void handle_xwayland_surface(struct wl_listener *listener, void *data) {
@@ -340,7 +343,7 @@ void handle_xwayland_surface(struct wl_listener *listener, void *data) {
 	view->close = close;
 	roots_surface->view = view;
 	view_init(view, desktop);
-	wl_list_insert(&desktop->views, &view->link);
+	desktop_insert_view(desktop, view);
 
 	if (!surface->override_redirect) {
 		if (surface->decorations == WLR_XWAYLAND_SURFACE_DECORATIONS_ALL) {
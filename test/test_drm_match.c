@@ -0,0 +1,145 @@
+#include <gbm.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "backend/drm/util.h"
+
+#define MAX_OBJS 6
+#define MAX_RES 6
+#define ITERATIONS 100000
+
+struct match_case {
+	size_t num_objs;
+	uint32_t objs[MAX_OBJS];
+	size_t num_res;
+	uint32_t res[MAX_RES];
+};
+
+struct match_result {
+	size_t matched;
+	size_t kept; // resources left on their original object
+};
+
+static bool can_match(const struct match_case *c, size_t i, size_t j) {
+	// The original solution is kept even if the masks don't allow it
+	return c->res[i] == j || (c->objs[j] & (UINT32_C(1) << i));
+}
+
+/*
+ * Tries every assignment and keeps the one with the most matched resources,
+ * then the most resources kept in place.
+ */
+static void brute_force(const struct match_case *c, size_t i, bool taken[],
+		struct match_result cur, struct match_result *best) {
+	if (i == c->num_res) {
+		if (cur.matched > best->matched || (cur.matched == best->matched &&
+				cur.kept > best->kept)) {
+			*best = cur;
+		}
+		return;
+	}
+
+	brute_force(c, i + 1, taken, cur, best);
+	if (c->res[i] == SKIP) {
+		return;
+	}
+
+	for (size_t j = 0; j < c->num_objs; ++j) {
+		if (taken[j] || !can_match(c, i, j)) {
+			continue;
+		}
+		struct match_result next = {
+			.matched = cur.matched + 1,
+			.kept = cur.kept + (c->res[i] == j),
+		};
+		taken[j] = true;
+		brute_force(c, i + 1, taken, next, best);
+		taken[j] = false;
+	}
+}
+
+static void random_case(struct match_case *c) {
+	c->num_objs = 1 + rand() % MAX_OBJS;
+	c->num_res = 1 + rand() % MAX_RES;
+	for (size_t j = 0; j < c->num_objs; ++j) {
+		c->objs[j] = rand() & ((UINT32_C(1) << c->num_res) - 1);
+	}
+
+	// The original solution is a valid matching, with some skipped resources
+	bool taken[MAX_OBJS] = {0};
+	for (size_t i = 0; i < c->num_res; ++i) {
+		c->res[i] = UNMATCHED;
+		int kind = rand() % 3;
+		size_t j = rand() % c->num_objs;
+		if (kind == 0) {
+			c->res[i] = SKIP;
+		} else if (kind == 1 && !taken[j] && can_match(c, i, j)) {
+			c->res[i] = j;
+			taken[j] = true;
+		}
+	}
+}
+
+static bool check_case(const struct match_case *c) {
+	uint32_t out[MAX_RES];
+	size_t score = match_obj(c->num_objs, c->objs, c->num_res, c->res, out);
+
+	struct match_result result = {0};
+	bool taken[MAX_OBJS] = {0};
+	for (size_t i = 0; i < c->num_res; ++i) {
+		if (c->res[i] == SKIP || out[i] == SKIP) {
+			if (c->res[i] != out[i]) {
+				fprintf(stderr, "resource %zu: skip not preserved\n", i);
+				return false;
+			}
+			continue;
+		}
+		if (out[i] == UNMATCHED) {
+			continue;
+		}
+		if (out[i] >= c->num_objs || taken[out[i]] ||
+				!can_match(c, i, out[i])) {
+			fprintf(stderr, "resource %zu: invalid object %u\n", i, out[i]);
+			return false;
+		}
+		taken[out[i]] = true;
+		++result.matched;
+		result.kept += c->res[i] == out[i];
+	}
+
+	struct match_result best = {0};
+	bool brute_taken[MAX_OBJS] = {0};
+	brute_force(c, 0, brute_taken, best, &best);
+
+	if (score != result.matched || result.matched != best.matched ||
+			result.kept != best.kept) {
+		fprintf(stderr, "score %zu, matched %zu, kept %zu, expected "
+			"matched %zu, kept %zu\n", score, result.matched, result.kept,
+			best.matched, best.kept);
+		return false;
+	}
+	return true;
+}
+
+static void print_case(const struct match_case *c) {
+	for (size_t j = 0; j < c->num_objs; ++j) {
+		fprintf(stderr, "objs[%zu] = 0x%x\n", j, c->objs[j]);
+	}
+	for (size_t i = 0; i < c->num_res; ++i) {
+		fprintf(stderr, "res[%zu] = %d\n", i, (int)c->res[i]);
+	}
+}
+
+int main(void) {
+	srand(1);
+	for (size_t n = 0; n < ITERATIONS; ++n) {
+		struct match_case c;
+		random_case(&c);
+		if (!check_case(&c)) {
+			print_case(&c);
+			return EXIT_FAILURE;
+		}
+	}
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,189 @@
+#define _POSIX_C_SOURCE 200809L
+#include <gbm.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <wayland-server.h>
+#include <wlr/backend/session.h>
+#include "backend/drm/drm.h"
+#include "backend/drm/iface.h"
+
+/*
+ * Drives direct scanout on a fake connector. Page-flips go through a stub
+ * wlr_drm_interface, and the gbm functions used to import client buffers are
+ * replaced below, so that no DRM device is needed.
+ */
+
+struct fake_buffer {
+	uint32_t width, height, format;
+	uint32_t fb_id;
+};
+
+struct gbm_bo {
+	const struct fake_buffer *buffer;
+};
+
+static struct {
+	size_t imports, destroys;
+	size_t pageflips;
+	uint32_t pageflip_fb_id;
+	bool pageflip_fails;
+	int failures;
+} test;
+
+struct gbm_bo *gbm_bo_import(struct gbm_device *gbm, uint32_t type,
+		void *buffer, uint32_t usage) {
+	struct gbm_bo *bo = calloc(1, sizeof(struct gbm_bo));
+	if (bo == NULL) {
+		return NULL;
+	}
+	bo->buffer = wl_resource_get_user_data(buffer);
+	++test.imports;
+	return bo;
+}
+
+void gbm_bo_destroy(struct gbm_bo *bo) {
+	++test.destroys;
+	free(bo);
+}
+
+uint32_t gbm_bo_get_width(struct gbm_bo *bo) {
+	return bo->buffer->width;
+}
+
+uint32_t gbm_bo_get_height(struct gbm_bo *bo) {
+	return bo->buffer->height;
+}
+
+uint32_t gbm_bo_get_format(struct gbm_bo *bo) {
+	return bo->buffer->format;
+}
+
+void *gbm_bo_get_user_data(struct gbm_bo *bo) {
+	// The framebuffer is already created, see get_fb_for_bo
+	return (void *)(uintptr_t)bo->buffer->fb_id;
+}
+
+static bool test_crtc_pageflip(struct wlr_drm_backend *drm,
+		struct wlr_drm_connector *conn, struct wlr_drm_crtc *crtc,
+		uint32_t fb_id, drmModeModeInfo *mode) {
+	++test.pageflips;
+	test.pageflip_fb_id = fb_id;
+	return !test.pageflip_fails;
+}
+
+static const struct wlr_drm_interface test_iface = {
+	.crtc_pageflip = test_crtc_pageflip,
+};
+
+#define expect(cond) \
+	do { \
+		if (!(cond)) { \
+			fprintf(stderr, "%s:%d: expected %s\n", __FILE__, __LINE__, \
+				#cond); \
+			++test.failures; \
+		} \
+	} while (0)
+
+static struct wl_resource *create_buffer(struct wl_client *client,
+		struct fake_buffer *buffer) {
+	struct wl_resource *resource =
+		wl_resource_create(client, &wl_buffer_interface, 1, 0);
+	if (resource == NULL) {
+		fprintf(stderr, "Failed to create a buffer\n");
+		exit(EXIT_FAILURE);
+	}
+	wl_resource_set_user_data(resource, buffer);
+	return resource;
+}
+
+int main(void) {
+	struct wl_display *display = wl_display_create();
+	int fds[2];
+	if (display == NULL ||
+			socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) != 0) {
+		fprintf(stderr, "Failed to create a client\n");
+		return EXIT_FAILURE;
+	}
+	struct wl_client *client = wl_client_create(display, fds[0]);
+	if (client == NULL) {
+		fprintf(stderr, "Failed to create a client\n");
+		return EXIT_FAILURE;
+	}
+
+	struct wlr_session session = { .active = true };
+	struct wlr_drm_backend drm = {
+		.iface = &test_iface,
+		.session = &session,
+	};
+	wl_list_init(&drm.client_buffers);
+	struct wlr_drm_plane primary = {0};
+	struct wlr_drm_crtc crtc = { .primary = &primary };
+	struct wlr_drm_connector conn = { .crtc = &crtc };
+	struct wlr_output *output = &conn.output;
+	output->backend = &drm.backend;
+	output->width = 1920;
+	output->height = 1080;
+	output->enabled = true;
+
+	struct fake_buffer fullscreen = { 1920, 1080, GBM_FORMAT_XRGB8888, 1 };
+	struct fake_buffer small = { 640, 480, GBM_FORMAT_XRGB8888, 2 };
+	struct fake_buffer yuv = { 1920, 1080, GBM_FORMAT_NV12, 3 };
+	struct wl_resource *fullscreen_res = create_buffer(client, &fullscreen);
+	struct wl_resource *small_res = create_buffer(client, &small);
+	struct wl_resource *yuv_res = create_buffer(client, &yuv);
+
+	// A buffer covering the output is flipped to
+	expect(wlr_drm_connector_scanout_buffer(output, fullscreen_res));
+	expect(test.pageflips == 1 && test.pageflip_fb_id == fullscreen.fb_id);
+	expect(conn.pageflip_pending);
+	expect(primary.scanout_pending && primary.pending_scanout != NULL &&
+		primary.pending_scanout->buffer == fullscreen_res);
+
+	// Nothing can be flipped before the previous flip completes
+	expect(!wlr_drm_connector_scanout_buffer(output, fullscreen_res));
+	expect(test.pageflips == 1);
+	conn.pageflip_pending = false;
+
+	// The import is reused for the same buffer
+	expect(wlr_drm_connector_scanout_buffer(output, fullscreen_res));
+	expect(test.pageflips == 2 && test.imports == 1);
+	conn.pageflip_pending = false;
+
+	// Buffers which don't match the output are composited instead
+	expect(!wlr_drm_connector_scanout_buffer(output, small_res));
+	expect(!wlr_drm_connector_scanout_buffer(output, yuv_res));
+	expect(test.pageflips == 2 && !conn.pageflip_pending);
+	expect(primary.pending_scanout->buffer == fullscreen_res);
+
+	// So are buffers the kernel refuses
+	test.pageflip_fails = true;
+	expect(!wlr_drm_connector_scanout_buffer(output, fullscreen_res));
+	expect(test.pageflips == 3 && !conn.pageflip_pending);
+	test.pageflip_fails = false;
+
+	// And anything while the session is inactive
+	session.active = false;
+	expect(!wlr_drm_connector_scanout_buffer(output, fullscreen_res));
+	expect(test.pageflips == 3);
+	session.active = true;
+
+	// Imports are destroyed with their buffer, unless a plane still uses them
+	size_t imports = test.imports;
+	wl_resource_destroy(small_res);
+	wl_resource_destroy(yuv_res);
+	expect(test.destroys == 2);
+	wl_resource_destroy(fullscreen_res);
+	expect(test.destroys == 2);
+	expect(primary.pending_scanout != NULL &&
+		primary.pending_scanout->buffer == NULL);
+	expect(imports == 3);
+
+	wl_client_destroy(client);
+	close(fds[1]);
+	wl_display_destroy(display);
+	return test.failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
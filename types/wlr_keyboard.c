@@ -1,15 +1,99 @@
 #include <assert.h>
 #include <stdlib.h>
 #include <string.h>
-#include <sys/mman.h>
 #include <unistd.h>
 #include <wayland-server.h>
 #include <wlr/interfaces/wlr_keyboard.h>
 #include <wlr/types/wlr_keyboard.h>
 #include <wlr/util/log.h>
+#include "util/os-compatibility.h"
 #include "util/signal.h"
 
-int os_create_anonymous_file(off_t size);
+/**
+ * A serialized keymap, shared by all keyboards whose keymaps have the same
+ * contents.
+ */
+struct wlr_keyboard_keymap_file {
+	struct wl_list link; // keymap_cache
+	uint32_t hash;
+	char *string;
+	size_t size; // including the NUL terminator
+	int fd;
+	uint64_t serial;
+	size_t refs;
+};
+
+static struct wl_list keymap_cache = { &keymap_cache, &keymap_cache };
+static uint64_t keymap_next_serial = 1;
+
+static uint32_t keymap_hash(const char *str, size_t size) {
+	// FNV-1a
+	uint32_t hash = 2166136261u;
+	for (size_t i = 0; i < size; ++i) {
+		hash ^= (uint8_t)str[i];
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+/**
+ * Returns a reference to the cached file for this keymap string, creating it
+ * if needed. Takes ownership of `str`.
+ */
+static struct wlr_keyboard_keymap_file *keymap_file_get(char *str) {
+	size_t size = strlen(str) + 1;
+	uint32_t hash = keymap_hash(str, size);
+
+	struct wlr_keyboard_keymap_file *file;
+	wl_list_for_each(file, &keymap_cache, link) {
+		if (file->hash == hash && file->size == size &&
+				memcmp(file->string, str, size) == 0) {
+			free(str);
+			++file->refs;
+			return file;
+		}
+	}
+
+	file = calloc(1, sizeof(struct wlr_keyboard_keymap_file));
+	if (file == NULL) {
+		wlr_log(L_ERROR, "Allocation failed");
+		free(str);
+		return NULL;
+	}
+	file->fd = os_create_sealed_file(str, size);
+	if (file->fd < 0) {
+		wlr_log_errno(L_ERROR, "creating a keymap file for %zu bytes failed",
+			size);
+		free(file);
+		free(str);
+		return NULL;
+	}
+	file->hash = hash;
+	file->string = str;
+	file->size = size;
+	file->serial = keymap_next_serial++;
+	file->refs = 1;
+	wl_list_insert(&keymap_cache, &file->link);
+	return file;
+}
+
+static void keymap_file_unref(struct wlr_keyboard_keymap_file *file) {
+	if (file == NULL || --file->refs > 0) {
+		return;
+	}
+	wl_list_remove(&file->link);
+	close(file->fd);
+	free(file->string);
+	free(file);
+}
+
+static void keyboard_unset_keymap_file(struct wlr_keyboard *kb) {
+	keymap_file_unref(kb->keymap_file);
+	kb->keymap_file = NULL;
+	kb->keymap_fd = -1;
+	kb->keymap_size = 0;
+	kb->keymap_serial = 0;
+}
 
 static void keyboard_led_update(struct wlr_keyboard *keyboard) {
 	if (keyboard->xkb_state == NULL) {
@@ -139,6 +223,7 @@ void wlr_keyboard_notify_key(struct wlr_keyboard *keyboard,
 void wlr_keyboard_init(struct wlr_keyboard *kb,
 		struct wlr_keyboard_impl *impl) {
 	kb->impl = impl;
+	kb->keymap_fd = -1;
 	wl_signal_init(&kb->events.key);
 	wl_signal_init(&kb->events.modifiers);
 	wl_signal_init(&kb->events.keymap);
@@ -160,7 +245,7 @@ void wlr_keyboard_destroy(struct wlr_keyboard *kb) {
 	}
 	xkb_state_unref(kb->xkb_state);
 	xkb_keymap_unref(kb->keymap);
-	close(kb->keymap_fd);
+	keymap_file_unref(kb->keymap_file);
 	free(kb);
 }
 
@@ -172,8 +257,6 @@ void wlr_keyboard_led_update(struct wlr_keyboard *kb, uint32_t leds) {
 
 void wlr_keyboard_set_keymap(struct wlr_keyboard *kb,
 		struct xkb_keymap *keymap) {
-	char *keymap_str = NULL;
-
 	xkb_keymap_unref(kb->keymap);
 	kb->keymap = xkb_keymap_ref(keymap);
 
@@ -208,25 +291,22 @@ void wlr_keyboard_set_keymap(struct wlr_keyboard *kb,
 		kb->mod_indexes[i] = xkb_map_mod_get_index(kb->keymap, mod_names[i]);
 	}
 
-	keymap_str = xkb_keymap_get_as_string(kb->keymap,
+	char *keymap_str = xkb_keymap_get_as_string(kb->keymap,
 		XKB_KEYMAP_FORMAT_TEXT_V1);
-	kb->keymap_size = strlen(keymap_str) + 1;
-	if (kb->keymap_fd) {
-		close(kb->keymap_fd);
-	}
-	kb->keymap_fd = os_create_anonymous_file(kb->keymap_size);
-	if (kb->keymap_fd < 0) {
-		wlr_log(L_ERROR, "creating a keymap file for %zu bytes failed", kb->keymap_size);
+	if (keymap_str == NULL) {
+		wlr_log(L_ERROR, "Failed to serialize keymap");
 		goto err;
 	}
-	void *ptr = mmap(NULL, kb->keymap_size,
-		PROT_READ | PROT_WRITE, MAP_SHARED, kb->keymap_fd, 0);
-	if (ptr == (void*)-1) {
-		wlr_log(L_ERROR, "failed to mmap() %zu bytes", kb->keymap_size);
+	// Keyboards with identical keymaps share a single read-only file
+	struct wlr_keyboard_keymap_file *file = keymap_file_get(keymap_str);
+	keyboard_unset_keymap_file(kb);
+	if (file == NULL) {
 		goto err;
 	}
-	strcpy(ptr, keymap_str);
-	free(keymap_str);
+	kb->keymap_file = file;
+	kb->keymap_fd = file->fd;
+	kb->keymap_size = file->size;
+	kb->keymap_serial = file->serial;
 
 	for (size_t i = 0; i < kb->num_keycodes; ++i) {
 		xkb_keycode_t keycode = kb->keycodes[i] + 8;
@@ -243,8 +323,7 @@ err:
 	kb->xkb_state = NULL;
 	xkb_keymap_unref(keymap);
 	kb->keymap = NULL;
-	close(kb->keymap_fd);
-	free(keymap_str);
+	keyboard_unset_keymap_file(kb);
 }
 
 void wlr_keyboard_set_repeat_info(struct wlr_keyboard *kb, int32_t rate,
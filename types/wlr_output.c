@@ -1,5 +1,6 @@
 #define _POSIX_C_SOURCE 200809L
 #include <assert.h>
+#include <inttypes.h>
 #include <stdlib.h>
 #include <string.h>
 #include <tgmath.h>
@@ -243,6 +244,27 @@ void wlr_output_set_scale(struct wlr_output *output, float scale) {
 	wlr_signal_emit_safe(&output->events.scale, output);
 }
 
+static void output_overlay_set_buffer(struct wlr_output *output,
+		struct wl_resource *buffer) {
+	if (output->overlay_buffer != NULL) {
+		wl_list_remove(&output->overlay_buffer_destroy.link);
+	}
+	output->overlay_buffer = buffer;
+	if (buffer != NULL) {
+		wl_resource_add_destroy_listener(buffer,
+			&output->overlay_buffer_destroy);
+	}
+}
+
+static void output_overlay_handle_buffer_destroy(struct wl_listener *listener,
+		void *data) {
+	struct wlr_output *output =
+		wl_container_of(listener, output, overlay_buffer_destroy);
+	// The plane keeps displaying its own reference to the buffer until the
+	// next frame, just make sure it's imported again if needed
+	output_overlay_set_buffer(output, NULL);
+}
+
 static void handle_display_destroy(struct wl_listener *listener, void *data) {
 	struct wlr_output *output =
 		wl_container_of(listener, output, display_destroy);
@@ -263,6 +285,7 @@ void wlr_output_init(struct wlr_output *output, struct wlr_backend *backend,
 	wl_signal_init(&output->events.frame);
 	wl_signal_init(&output->events.needs_swap);
 	wl_signal_init(&output->events.swap_buffers);
+	wl_signal_init(&output->events.present);
 	wl_signal_init(&output->events.enable);
 	wl_signal_init(&output->events.mode);
 	wl_signal_init(&output->events.scale);
@@ -274,6 +297,9 @@ void wlr_output_init(struct wlr_output *output, struct wlr_backend *backend,
 	wl_display_add_destroy_listener(display, &output->display_destroy);
 
 	output->frame_pending = true;
+	output->composited_since_scanout = -1;
+	output->overlay_buffer_destroy.notify =
+		output_overlay_handle_buffer_destroy;
 }
 
 void wlr_output_destroy(struct wlr_output *output) {
@@ -284,6 +310,7 @@ void wlr_output_destroy(struct wlr_output *output) {
 	wl_list_remove(&output->display_destroy.link);
 	wlr_output_destroy_global(output);
 	wlr_output_set_fullscreen_surface(output, NULL);
+	output_overlay_set_buffer(output, NULL);
 
 	wlr_signal_emit_safe(&output->events.destroy, output);
 
@@ -325,8 +352,116 @@ void wlr_output_effective_resolution(struct wlr_output *output,
 	*height /= output->scale;
 }
 
+static int64_t timespec_to_nsec(const struct timespec *a) {
+	return (int64_t)a->tv_sec * 1000000000 + a->tv_nsec;
+}
+
+static struct wlr_output_frame_timing *output_current_timing(
+		struct wlr_output *output) {
+	return &output->timings.frames[output->timings.idx];
+}
+
+static bool output_timing_in_progress(struct wlr_output *output) {
+	struct wlr_output_frame_timing *timing = output_current_timing(output);
+	return output->timings.frame_count > 0 &&
+		timing->render_end.tv_sec == 0 && timing->render_end.tv_nsec == 0;
+}
+
 bool wlr_output_make_current(struct wlr_output *output, int *buffer_age) {
-	return output->impl->make_current(output, buffer_age);
+	struct wlr_output_timings *timings = &output->timings;
+	// Making the output current several times per frame is allowed
+	if (!output_timing_in_progress(output)) {
+		timings->idx = (timings->idx + 1) % WLR_OUTPUT_TIMINGS_LEN;
+		struct wlr_output_frame_timing *timing = output_current_timing(output);
+		if (timings->pending_present == timing) {
+			timings->pending_present = NULL;
+		}
+		memset(timing, 0, sizeof(struct wlr_output_frame_timing));
+		timing->frame = ++timings->frame_count;
+		clock_gettime(CLOCK_MONOTONIC, &timing->render_start);
+	} else {
+		struct wlr_output_frame_timing *timing = output_current_timing(output);
+		if (timing->render_start.tv_sec == 0 &&
+				timing->render_start.tv_nsec == 0) {
+			// The frame was abandoned, see wlr_output_send_frame
+			clock_gettime(CLOCK_MONOTONIC, &timing->render_start);
+		}
+	}
+
+	if (!output->impl->make_current(output, buffer_age)) {
+		return false;
+	}
+	// Nothing has been rendered to the buffers while the fullscreen surface
+	// was scanned out, those older than that are out of date
+	if (buffer_age != NULL && output->composited_since_scanout >= 0 &&
+			*buffer_age > output->composited_since_scanout) {
+		*buffer_age = 0;
+	}
+	return true;
+}
+
+const struct wlr_output_frame_timing *wlr_output_get_frame_timing(
+		struct wlr_output *output, size_t age) {
+	struct wlr_output_timings *timings = &output->timings;
+	if (age >= WLR_OUTPUT_TIMINGS_LEN || age >= timings->frame_count) {
+		return NULL;
+	}
+	size_t idx = (timings->idx + WLR_OUTPUT_TIMINGS_LEN - age) %
+		WLR_OUTPUT_TIMINGS_LEN;
+	return &timings->frames[idx];
+}
+
+void wlr_output_log_timings(struct wlr_output *output) {
+	size_t rendered = 0, presented = 0;
+	int64_t render_sum = 0, render_max = 0;
+	int64_t latency_sum = 0, latency_max = 0;
+	uint64_t missed = 0, damage_sum = 0;
+	for (size_t age = 0; age < WLR_OUTPUT_TIMINGS_LEN; ++age) {
+		const struct wlr_output_frame_timing *timing =
+			wlr_output_get_frame_timing(output, age);
+		if (timing == NULL) {
+			break;
+		}
+		if (timing->submit.tv_sec == 0 && timing->submit.tv_nsec == 0) {
+			continue;
+		}
+
+		int64_t render = timespec_to_nsec(&timing->render_end) -
+			timespec_to_nsec(&timing->render_start);
+		render_sum += render;
+		if (render > render_max) {
+			render_max = render;
+		}
+		damage_sum += timing->damage_area;
+		++rendered;
+
+		if (timing->presented) {
+			int64_t latency = timespec_to_nsec(&timing->present) -
+				timespec_to_nsec(&timing->submit);
+			latency_sum += latency;
+			if (latency > latency_max) {
+				latency_max = latency;
+			}
+			missed += timing->missed_vblanks;
+			++presented;
+		}
+	}
+
+	if (rendered == 0) {
+		wlr_log(L_INFO, "%s: no frame rendered", output->name);
+		return;
+	}
+	wlr_log(L_INFO, "%s: %zu frames, render avg %.3f ms max %.3f ms, "
+		"avg damage %" PRIu64 " px", output->name, rendered,
+		render_sum / rendered / 1e6, render_max / 1e6,
+		damage_sum / rendered);
+	if (presented > 0) {
+		wlr_log(L_INFO, "%s: %zu frames presented, submit to present "
+			"avg %.3f ms max %.3f ms, %" PRIu64 " missed vblanks "
+			"(%" PRIu64 " total)", output->name, presented,
+			latency_sum / presented / 1e6, latency_max / 1e6, missed,
+			output->timings.missed_vblanks);
+	}
 }
 
 static void output_scissor(struct wlr_output *output, pixman_box32_t *rect) {
@@ -398,6 +533,43 @@ static void output_fullscreen_surface_render(struct wlr_output *output,
 	wlr_surface_send_frame_done(surface, when);
 }
 
+/**
+ * Tries to scan out the fullscreen surface buffer directly. This is only
+ * possible if nothing else needs to be composited and the buffer exactly
+ * covers the output.
+ */
+static bool output_fullscreen_surface_scanout(struct wlr_output *output) {
+	struct wlr_surface *surface = output->fullscreen_surface;
+	if (surface == NULL || output->impl->scanout_buffer == NULL ||
+			!wlr_surface_has_buffer(surface)) {
+		return false;
+	}
+
+	// Only buffers living on the GPU can be scanned out
+	struct wl_resource *buffer = surface->current->buffer;
+	if (buffer == NULL || wl_shm_buffer_get(buffer) != NULL) {
+		return false;
+	}
+
+	if (output->transform != WL_OUTPUT_TRANSFORM_NORMAL ||
+			surface->current->transform != WL_OUTPUT_TRANSFORM_NORMAL ||
+			surface->current->scale != output->scale ||
+			surface->current->buffer_width != output->width ||
+			surface->current->buffer_height != output->height) {
+		return false;
+	}
+
+	struct wlr_output_cursor *cursor;
+	wl_list_for_each(cursor, &output->cursors, link) {
+		if (cursor->enabled && cursor->visible &&
+				output->hardware_cursor != cursor) {
+			return false;
+		}
+	}
+
+	return output->impl->scanout_buffer(output, buffer);
+}
+
 /**
  * Returns the cursor box, scaled for its output.
  */
@@ -460,12 +632,94 @@ surface_damage_finish:
 	pixman_region32_fini(&surface_damage);
 }
 
+bool wlr_output_attach_overlay(struct wlr_output *output,
+		struct wlr_surface *surface, const struct wlr_box *box) {
+	if (output->impl->set_overlay == NULL || output->overlay_surface != NULL ||
+			!wlr_surface_has_buffer(surface)) {
+		return false;
+	}
+
+	// Only buffers living on the GPU can be displayed on a plane
+	struct wl_resource *buffer = surface->current->buffer;
+	if (buffer == NULL || wl_shm_buffer_get(buffer) != NULL) {
+		return false;
+	}
+
+	int width, height;
+	wlr_output_transformed_resolution(output, &width, &height);
+	if (output->transform != WL_OUTPUT_TRANSFORM_NORMAL ||
+			surface->current->transform != WL_OUTPUT_TRANSFORM_NORMAL ||
+			box->width <= 0 || box->height <= 0 || box->x < 0 || box->y < 0 ||
+			box->x + box->width > width || box->y + box->height > height) {
+		return false;
+	}
+
+	// Software cursors are rendered in the frame, below the overlay plane
+	struct wlr_output_cursor *cursor;
+	wl_list_for_each(cursor, &output->cursors, link) {
+		if (!cursor->enabled || !cursor->visible ||
+				output->hardware_cursor == cursor) {
+			continue;
+		}
+		struct wlr_box cursor_box, intersection;
+		output_cursor_get_box(cursor, &cursor_box);
+		if (wlr_box_intersection(&cursor_box, box, &intersection)) {
+			return false;
+		}
+	}
+
+	// The plane keeps its state across frames, only update it on changes
+	if (!output->overlay_enabled || output->overlay_buffer != buffer ||
+			memcmp(&output->overlay_box, box, sizeof(struct wlr_box)) != 0) {
+		if (!output->impl->set_overlay(output, buffer, box)) {
+			return false;
+		}
+		output->overlay_enabled = true;
+		output->overlay_box = *box;
+		output_overlay_set_buffer(output, buffer);
+	}
+
+	output->overlay_surface = surface;
+	return true;
+}
+
+/**
+ * Disables the overlay plane if no surface has been attached to it for the
+ * frame being swapped. Returns false if the plane still displays its previous
+ * buffer at overlay_box.
+ */
+static bool output_overlay_commit(struct wlr_output *output) {
+	bool ok = true;
+	if (output->overlay_surface == NULL && output->overlay_enabled) {
+		if (output->impl->set_overlay(output, NULL, NULL)) {
+			output->overlay_enabled = false;
+			output_overlay_set_buffer(output, NULL);
+		} else {
+			wlr_log(L_ERROR, "Failed to disable the overlay plane of "
+				"output %s", output->name);
+			ok = false;
+		}
+	}
+	output->overlay_surface = NULL;
+	return ok;
+}
+
 bool wlr_output_swap_buffers(struct wlr_output *output, struct timespec *when,
 		pixman_region32_t *damage) {
 	if (output->frame_pending) {
 		wlr_log(L_ERROR, "Tried to swap buffers when a frame is pending");
 		return false;
 	}
+
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	struct wlr_output_frame_timing *timing = NULL;
+	if (output_timing_in_progress(output)) {
+		timing = output_current_timing(output);
+		timing->render_end = now;
+	}
+
 	if (output->idle_frame != NULL) {
 		wl_event_source_remove(output->idle_frame);
 		output->idle_frame = NULL;
@@ -486,12 +740,17 @@ bool wlr_output_swap_buffers(struct wlr_output *output, struct timespec *when,
 	}
 
 	if (when == NULL) {
-		struct timespec now;
-		clock_gettime(CLOCK_MONOTONIC, &now);
 		when = &now;
 	}
 
-	if (pixman_region32_not_empty(&render_damage)) {
+	bool overlay_committed = output_overlay_commit(output);
+
+	bool scanout = output_fullscreen_surface_scanout(output);
+	if (scanout) {
+		if (pixman_region32_not_empty(&render_damage)) {
+			wlr_surface_send_frame_done(output->fullscreen_surface, when);
+		}
+	} else if (pixman_region32_not_empty(&render_damage)) {
 		if (output->fullscreen_surface != NULL) {
 			output_fullscreen_surface_render(output, output->fullscreen_surface,
 				when, &render_damage);
@@ -507,6 +766,16 @@ bool wlr_output_swap_buffers(struct wlr_output *output, struct timespec *when,
 		}
 	}
 
+	if (timing != NULL) {
+		int n_rects;
+		pixman_box32_t *rects =
+			pixman_region32_rectangles(&render_damage, &n_rects);
+		for (int i = 0; i < n_rects; ++i) {
+			timing->damage_area += (uint64_t)(rects[i].x2 - rects[i].x1) *
+				(rects[i].y2 - rects[i].y1);
+		}
+	}
+
 	// Transform damage into renderer coordinates, ie. upside down
 	enum wl_output_transform transform = wlr_output_transform_compose(
 		wlr_output_transform_invert(output->transform),
@@ -514,19 +783,91 @@ bool wlr_output_swap_buffers(struct wlr_output *output, struct timespec *when,
 	wlr_region_transform(&render_damage, &render_damage, transform, width,
 		height);
 
-	if (!output->impl->swap_buffers(output, damage ? &render_damage : NULL)) {
-		return false;
+	if (scanout) {
+		output->composited_since_scanout = 0;
+	} else {
+		if (!output->impl->swap_buffers(output,
+				damage ? &render_damage : NULL)) {
+			pixman_region32_fini(&render_damage);
+			return false;
+		}
+		if (output->composited_since_scanout >= 0) {
+			++output->composited_since_scanout;
+		}
+	}
+	output->fullscreen_scanout = scanout;
+
+	if (timing != NULL) {
+		clock_gettime(CLOCK_MONOTONIC, &timing->submit);
+		output->timings.pending_present = timing;
 	}
 
 	output->frame_pending = true;
+	output->present_pending = true;
 	output->needs_swap = false;
 	pixman_region32_clear(&output->damage);
+	if (!overlay_committed) {
+		// Try disabling the plane again with the next frame
+		wlr_output_update_needs_swap(output);
+	}
 
 	pixman_region32_fini(&render_damage);
 	return true;
 }
 
+void wlr_output_send_present(struct wlr_output *output, struct timespec *when,
+		unsigned seq, uint32_t flags) {
+	// Only report frames which have actually been swapped
+	if (!output->present_pending) {
+		return;
+	}
+	output->present_pending = false;
+
+	struct timespec now;
+	if (when == NULL) {
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		when = &now;
+	}
+
+	struct wlr_output_event_present event = {
+		.output = output,
+		.when = when,
+		.seq = seq,
+		.refresh = output->refresh > 0 ? 1000000000000ll / output->refresh : 0,
+		.flags = flags,
+	};
+	wlr_signal_emit_safe(&output->events.present, &event);
+
+	struct wlr_output_frame_timing *timing = output->timings.pending_present;
+	if (timing == NULL) {
+		return;
+	}
+	output->timings.pending_present = NULL;
+
+	timing->presented = true;
+	timing->present = *when;
+	timing->vblank_seq = seq;
+	if (output->refresh > 0) {
+		// The frame should have been presented at the first vblank after its
+		// submission
+		int64_t refresh_ns = 1000000000000ll / output->refresh;
+		int64_t latency = timespec_to_nsec(&timing->present) -
+			timespec_to_nsec(&timing->submit);
+		if (latency > refresh_ns) {
+			timing->missed_vblanks = latency / refresh_ns;
+			output->timings.missed_vblanks += timing->missed_vblanks;
+		}
+	}
+}
+
 void wlr_output_send_frame(struct wlr_output *output) {
+	if (output_timing_in_progress(output)) {
+		// The output was made current without swapping buffers: nothing was
+		// submitted, restart the timing when rendering the next frame
+		struct wlr_output_frame_timing *timing = output_current_timing(output);
+		timing->render_start = (struct timespec){0};
+	}
+
 	output->frame_pending = false;
 	wlr_signal_emit_safe(&output->events.frame, output);
 }
@@ -606,9 +947,9 @@ static void output_fullscreen_surface_handle_commit(
 
 	pixman_region32_t damage;
 	pixman_region32_init(&damage);
-	pixman_region32_copy(&damage, &surface->current->surface_damage);
-	wlr_region_scale(&damage, &damage, output->scale);
-	pixman_region32_translate(&damage, box.x, box.y);
+	wlr_region_transform_scale_translate(&damage,
+		&surface->current->surface_damage, WL_OUTPUT_TRANSFORM_NORMAL, 0, 0,
+		output->scale, box.x, box.y);
 	pixman_region32_union(&output->damage, &output->damage, &damage);
 	pixman_region32_fini(&damage);
 
@@ -624,8 +965,6 @@ static void output_fullscreen_surface_handle_destroy(
 
 void wlr_output_set_fullscreen_surface(struct wlr_output *output,
 		struct wlr_surface *surface) {
-	// TODO: hardware fullscreen
-
 	if (output->fullscreen_surface == surface) {
 		return;
 	}
@@ -61,8 +61,16 @@ struct wlr_output_damage *wlr_output_damage_create(struct wlr_output *output) {
 	wl_signal_init(&output_damage->events.frame);
 	wl_signal_init(&output_damage->events.destroy);
 
+	output_damage->previous = calloc(WLR_OUTPUT_DAMAGE_PREVIOUS_LEN,
+		sizeof(pixman_region32_t));
+	if (output_damage->previous == NULL) {
+		free(output_damage);
+		return NULL;
+	}
+	output_damage->previous_len = WLR_OUTPUT_DAMAGE_PREVIOUS_LEN;
+
 	pixman_region32_init(&output_damage->current);
-	for (size_t i = 0; i < WLR_OUTPUT_DAMAGE_PREVIOUS_LEN; ++i) {
+	for (size_t i = 0; i < output_damage->previous_len; ++i) {
 		pixman_region32_init(&output_damage->previous[i]);
 	}
 
@@ -94,12 +102,44 @@ void wlr_output_damage_destroy(struct wlr_output_damage *output_damage) {
 	wl_list_remove(&output_damage->output_needs_swap.link);
 	wl_list_remove(&output_damage->output_frame.link);
 	pixman_region32_fini(&output_damage->current);
-	for (size_t i = 0; i < WLR_OUTPUT_DAMAGE_PREVIOUS_LEN; ++i) {
+	for (size_t i = 0; i < output_damage->previous_len; ++i) {
 		pixman_region32_fini(&output_damage->previous[i]);
 	}
+	free(output_damage->previous);
 	free(output_damage);
 }
 
+/**
+ * Grows the damage history to `len` frames. The damage of the frames we didn't
+ * keep track of is unknown, so they're considered fully damaged.
+ */
+static bool output_damage_grow_previous(struct wlr_output_damage *output_damage,
+		size_t len) {
+	pixman_region32_t *previous = calloc(len, sizeof(pixman_region32_t));
+	if (previous == NULL) {
+		return false;
+	}
+
+	// Unroll the circular queue, from the most recent frame to the oldest
+	size_t old_len = output_damage->previous_len;
+	for (size_t i = 0; i < old_len; ++i) {
+		size_t j = (output_damage->previous_idx + i) % old_len;
+		previous[i] = output_damage->previous[j];
+	}
+
+	int width, height;
+	wlr_output_transformed_resolution(output_damage->output, &width, &height);
+	for (size_t i = old_len; i < len; ++i) {
+		pixman_region32_init_rect(&previous[i], 0, 0, width, height);
+	}
+
+	free(output_damage->previous);
+	output_damage->previous = previous;
+	output_damage->previous_len = len;
+	output_damage->previous_idx = 0;
+	return true;
+}
+
 bool wlr_output_damage_make_current(struct wlr_output_damage *output_damage,
 		bool *needs_swap, pixman_region32_t *damage) {
 	struct wlr_output *output = output_damage->output;
@@ -109,20 +149,38 @@ bool wlr_output_damage_make_current(struct wlr_output_damage *output_damage,
 		return false;
 	}
 
+	++output_damage->stats.frames;
+
+	if (buffer_age > 0 && (size_t)buffer_age - 1 > output_damage->previous_len &&
+			buffer_age - 1 <= WLR_OUTPUT_DAMAGE_MAX_PREVIOUS_LEN) {
+		// The new history is fully damaged, so this frame still is, but
+		// the next ones won't be
+		if (output_damage_grow_previous(output_damage, buffer_age - 1)) {
+			++output_damage->stats.full_damage_old_buffer;
+		}
+	}
+
 	// Check if we can use damage tracking
-	if (buffer_age <= 0 || buffer_age - 1 > WLR_OUTPUT_DAMAGE_PREVIOUS_LEN) {
+	if (buffer_age <= 0 ||
+			(size_t)buffer_age - 1 > output_damage->previous_len) {
 		int width, height;
 		wlr_output_transformed_resolution(output, &width, &height);
 
 		// Buffer new or too old, damage the whole output
 		pixman_region32_union_rect(damage, damage, 0, 0, width, height);
+
+		if (buffer_age <= 0) {
+			++output_damage->stats.full_damage_new_buffer;
+		} else {
+			++output_damage->stats.full_damage_old_buffer;
+		}
 	} else {
 		pixman_region32_copy(damage, &output_damage->current);
 
 		// Accumulate damage from old buffers
 		size_t idx = output_damage->previous_idx;
 		for (int i = 0; i < buffer_age - 1; ++i) {
-			int j = (idx + i) % WLR_OUTPUT_DAMAGE_PREVIOUS_LEN;
+			int j = (idx + i) % output_damage->previous_len;
 			pixman_region32_union(damage, damage, &output_damage->previous[j]);
 		}
 	}
@@ -138,8 +196,8 @@ bool wlr_output_damage_swap_buffers(struct wlr_output_damage *output_damage,
 	}
 
 	// same as decrementing, but works on unsigned integers
-	output_damage->previous_idx += WLR_OUTPUT_DAMAGE_PREVIOUS_LEN - 1;
-	output_damage->previous_idx %= WLR_OUTPUT_DAMAGE_PREVIOUS_LEN;
+	output_damage->previous_idx += output_damage->previous_len - 1;
+	output_damage->previous_idx %= output_damage->previous_len;
 
 	pixman_region32_copy(&output_damage->previous[output_damage->previous_idx],
 		&output_damage->current);
@@ -2,14 +2,32 @@
 #include <float.h>
 #include <limits.h>
 #include <stdlib.h>
+#include <string.h>
 #include <wlr/types/wlr_box.h>
 #include <wlr/types/wlr_output_layout.h>
 #include <wlr/types/wlr_output.h>
 #include <wlr/util/log.h>
 #include "util/signal.h"
 
+struct wlr_output_layout_entry {
+	struct wlr_output_layout_output *l_output;
+	struct wlr_box box;
+};
+
 struct wlr_output_layout_state {
 	struct wlr_box _box; // should never be read directly, use the getter
+
+	// Index of the output boxes, rebuilt when the layout is reconfigured or
+	// when an output is removed
+	bool index_dirty;
+	struct wlr_output_layout_entry *entries; // in layout->outputs order
+	size_t entries_len, entries_cap;
+	struct wlr_box extents;
+	// Indices of the entries with a non-empty box, sorted by x, along with
+	// the largest right edge of the boxes up to each of them
+	size_t *sorted;
+	int *sorted_max_x2;
+	size_t sorted_len;
 };
 
 struct wlr_output_layout_output_state {
@@ -37,6 +55,7 @@ struct wlr_output_layout *wlr_output_layout_create() {
 		return NULL;
 	}
 	wl_list_init(&layout->outputs);
+	layout->state->index_dirty = true;
 
 	wl_signal_init(&layout->events.add);
 	wl_signal_init(&layout->events.change);
@@ -48,6 +67,7 @@ struct wlr_output_layout *wlr_output_layout_create() {
 static void wlr_output_layout_output_destroy(
 		struct wlr_output_layout_output *l_output) {
 	wlr_signal_emit_safe(&l_output->events.destroy, l_output);
+	l_output->state->layout->state->index_dirty = true;
 	wl_list_remove(&l_output->state->mode.link);
 	wl_list_remove(&l_output->state->scale.link);
 	wl_list_remove(&l_output->state->transform.link);
@@ -69,6 +89,9 @@ void wlr_output_layout_destroy(struct wlr_output_layout *layout) {
 		wlr_output_layout_output_destroy(l_output);
 	}
 
+	free(layout->state->entries);
+	free(layout->state->sorted);
+	free(layout->state->sorted_max_x2);
 	free(layout->state);
 	free(layout);
 }
@@ -84,6 +107,133 @@ static struct wlr_box *wlr_output_layout_output_get_box(
 	return &l_output->state->_box;
 }
 
+static bool output_layout_index_reserve(struct wlr_output_layout_state *state,
+		size_t len) {
+	if (len <= state->entries_cap) {
+		return true;
+	}
+	size_t cap = state->entries_cap == 0 ? 4 : state->entries_cap;
+	while (cap < len) {
+		cap *= 2;
+	}
+	struct wlr_output_layout_entry *entries =
+		realloc(state->entries, cap * sizeof(*entries));
+	if (entries == NULL) {
+		return false;
+	}
+	state->entries = entries;
+	size_t *sorted = realloc(state->sorted, cap * sizeof(*sorted));
+	if (sorted == NULL) {
+		return false;
+	}
+	state->sorted = sorted;
+	int *sorted_max_x2 =
+		realloc(state->sorted_max_x2, cap * sizeof(*sorted_max_x2));
+	if (sorted_max_x2 == NULL) {
+		return false;
+	}
+	state->sorted_max_x2 = sorted_max_x2;
+	state->entries_cap = cap;
+	return true;
+}
+
+/**
+ * Rebuilds the index of the output boxes. The boxes only change when the
+ * layout is reconfigured.
+ */
+static void output_layout_index_rebuild(struct wlr_output_layout *layout) {
+	struct wlr_output_layout_state *state = layout->state;
+	state->entries_len = 0;
+	state->sorted_len = 0;
+	state->index_dirty = false;
+
+	int min_x = INT_MAX, min_y = INT_MAX;
+	int max_x = INT_MIN, max_y = INT_MIN;
+	struct wlr_output_layout_output *l_output;
+	if (!output_layout_index_reserve(state, wl_list_length(&layout->outputs))) {
+		// Queries will behave as if the layout was empty
+		wlr_log(L_ERROR, "Failed to allocate output layout index");
+		goto out;
+	}
+	wl_list_for_each(l_output, &layout->outputs, link) {
+		struct wlr_output_layout_entry *entry =
+			&state->entries[state->entries_len];
+		entry->l_output = l_output;
+		entry->box = *wlr_output_layout_output_get_box(l_output);
+		struct wlr_box *box = &entry->box;
+
+		if (box->x < min_x) {
+			min_x = box->x;
+		}
+		if (box->y < min_y) {
+			min_y = box->y;
+		}
+		if (box->x + box->width > max_x) {
+			max_x = box->x + box->width;
+		}
+		if (box->y + box->height > max_y) {
+			max_y = box->y + box->height;
+		}
+
+		if (!wlr_box_empty(box)) {
+			// Insertion sort, layouts have few outputs
+			size_t i = state->sorted_len++;
+			for (; i > 0 &&
+					state->entries[state->sorted[i - 1]].box.x > box->x; --i) {
+				state->sorted[i] = state->sorted[i - 1];
+			}
+			state->sorted[i] = state->entries_len;
+		}
+		++state->entries_len;
+	}
+
+out:
+	if (state->entries_len == 0) {
+		state->extents = (struct wlr_box){0};
+	} else {
+		state->extents.x = min_x;
+		state->extents.y = min_y;
+		state->extents.width = max_x - min_x;
+		state->extents.height = max_y - min_y;
+	}
+
+	int max_x2 = INT_MIN;
+	for (size_t i = 0; i < state->sorted_len; ++i) {
+		struct wlr_box *box = &state->entries[state->sorted[i]].box;
+		if (box->x + box->width > max_x2) {
+			max_x2 = box->x + box->width;
+		}
+		state->sorted_max_x2[i] = max_x2;
+	}
+}
+
+static struct wlr_output_layout_state *output_layout_get_index(
+		struct wlr_output_layout *layout) {
+	if (layout->state->index_dirty) {
+		output_layout_index_rebuild(layout);
+	}
+	return layout->state;
+}
+
+/**
+ * Returns the number of sorted entries whose box starts at or before x, or
+ * strictly before x if `strict` is set.
+ */
+static size_t output_layout_index_upper_bound(
+		struct wlr_output_layout_state *state, double x, bool strict) {
+	size_t lo = 0, hi = state->sorted_len;
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+		int box_x = state->entries[state->sorted[mid]].box.x;
+		if (box_x < x || (!strict && box_x == x)) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+	return lo;
+}
+
 /**
  * This must be called whenever the layout changes to reconfigure the auto
  * configured outputs and emit the `changed` event.
@@ -130,6 +280,8 @@ static void wlr_output_layout_reconfigure(struct wlr_output_layout *layout) {
 		wlr_output_set_position(l_output->output, l_output->x, l_output->y);
 	}
 
+	output_layout_index_rebuild(layout);
+
 	wlr_signal_emit_safe(&layout->events.change, layout);
 }
 
@@ -236,15 +388,8 @@ bool wlr_output_layout_intersects(struct wlr_output_layout *layout,
 	struct wlr_box out_box;
 
 	if (reference == NULL) {
-		struct wlr_output_layout_output *l_output;
-		wl_list_for_each(l_output, &layout->outputs, link) {
-			struct wlr_box *output_box =
-				wlr_output_layout_output_get_box(l_output);
-			if (wlr_box_intersection(output_box, target_box, &out_box)) {
-				return true;
-			}
-		}
-		return false;
+		return wlr_output_layout_outputs_in_box(layout, target_box,
+			NULL, 0) > 0;
 	} else {
 		struct wlr_output_layout_output *l_output =
 			wlr_output_layout_get(layout, reference);
@@ -259,14 +404,55 @@ bool wlr_output_layout_intersects(struct wlr_output_layout *layout,
 
 struct wlr_output *wlr_output_layout_output_at(struct wlr_output_layout *layout,
 		double x, double y) {
-	struct wlr_output_layout_output *l_output;
-	wl_list_for_each(l_output, &layout->outputs, link) {
-		struct wlr_box *box = wlr_output_layout_output_get_box(l_output);
-		if (wlr_box_contains_point(box, x, y)) {
-			return l_output->output;
+	struct wlr_output_layout_state *state = output_layout_get_index(layout);
+
+	// Only boxes starting before x which may reach it can contain the point,
+	// the first one in the layout wins
+	size_t best = SIZE_MAX;
+	for (size_t i = output_layout_index_upper_bound(state, x, false);
+			i > 0 && state->sorted_max_x2[i - 1] >= x; --i) {
+		size_t j = state->sorted[i - 1];
+		if (j < best && wlr_box_contains_point(&state->entries[j].box, x, y)) {
+			best = j;
 		}
 	}
-	return NULL;
+	if (best == SIZE_MAX) {
+		return NULL;
+	}
+	return state->entries[best].l_output->output;
+}
+
+size_t wlr_output_layout_outputs_in_box(struct wlr_output_layout *layout,
+		const struct wlr_box *box, struct wlr_output **outputs,
+		size_t outputs_len) {
+	struct wlr_output_layout_state *state = output_layout_get_index(layout);
+	if (wlr_box_empty(box)) {
+		return 0;
+	}
+
+	// Entries are visited from right to left, mark them to report the
+	// outputs in layout order
+	bool matches[state->entries_len + 1];
+	memset(matches, false, sizeof(matches));
+	size_t n = 0;
+	struct wlr_box out_box;
+	for (size_t i = output_layout_index_upper_bound(state,
+				box->x + box->width, true);
+			i > 0 && state->sorted_max_x2[i - 1] > box->x; --i) {
+		size_t j = state->sorted[i - 1];
+		if (wlr_box_intersection(&state->entries[j].box, box, &out_box)) {
+			matches[j] = true;
+			++n;
+		}
+	}
+
+	size_t k = 0;
+	for (size_t j = 0; j < state->entries_len && k < outputs_len; ++j) {
+		if (matches[j]) {
+			outputs[k++] = state->entries[j].l_output->output;
+		}
+	}
+	return n;
 }
 
 void wlr_output_layout_move(struct wlr_output_layout *layout,
@@ -313,16 +499,23 @@ void wlr_output_layout_output_coords(struct wlr_output_layout *layout,
 void wlr_output_layout_closest_point(struct wlr_output_layout *layout,
 		struct wlr_output *reference, double x, double y, double *dest_x,
 		double *dest_y) {
+	struct wlr_output_layout_state *state = output_layout_get_index(layout);
+	if (reference == NULL && wlr_output_layout_output_at(layout, x, y) != NULL) {
+		// The point is in the layout
+		*dest_x = x;
+		*dest_y = y;
+		return;
+	}
+
 	double min_x = DBL_MAX, min_y = DBL_MAX, min_distance = DBL_MAX;
-	struct wlr_output_layout_output *l_output;
-	wl_list_for_each(l_output, &layout->outputs, link) {
-		if (reference != NULL && reference != l_output->output) {
+	for (size_t i = 0; i < state->entries_len; ++i) {
+		struct wlr_output_layout_entry *entry = &state->entries[i];
+		if (reference != NULL && reference != entry->l_output->output) {
 			continue;
 		}
 
 		double output_x, output_y, output_distance;
-		struct wlr_box *box = wlr_output_layout_output_get_box(l_output);
-		wlr_box_closest_point(box, x, y, &output_x, &output_y);
+		wlr_box_closest_point(&entry->box, x, y, &output_x, &output_y);
 
 		// calculate squared distance suitable for comparison
 		output_distance =
@@ -357,31 +550,10 @@ struct wlr_box *wlr_output_layout_get_box(
 		}
 	} else {
 		// layout extents
-		int min_x = INT_MAX, min_y = INT_MAX;
-		int max_x = INT_MIN, max_y = INT_MIN;
-		wl_list_for_each(l_output, &layout->outputs, link) {
-			struct wlr_box *box = wlr_output_layout_output_get_box(l_output);
-
-			if (box->x < min_x) {
-				min_x = box->x;
-			}
-			if (box->y < min_y) {
-				min_y = box->y;
-			}
-			if (box->x + box->width > max_x) {
-				max_x = box->x + box->width;
-			}
-			if (box->y + box->height > max_y) {
-				max_y = box->y + box->height;
-			}
-		}
-
-		layout->state->_box.x = min_x;
-		layout->state->_box.y = min_y;
-		layout->state->_box.width = max_x - min_x;
-		layout->state->_box.height = max_y - min_y;
-
-		return &layout->state->_box;
+		struct wlr_output_layout_state *state =
+			output_layout_get_index(layout);
+		state->_box = state->extents;
+		return &state->_box;
 	}
 
 	// not reached
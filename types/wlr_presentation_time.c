@@ -0,0 +1,260 @@
+#define _POSIX_C_SOURCE 199309L
+#include <assert.h>
+#include <stdlib.h>
+#include <wayland-server.h>
+#include <wlr/types/wlr_output.h>
+#include <wlr/types/wlr_presentation_time.h>
+#include <wlr/types/wlr_surface.h>
+#include <wlr/util/log.h>
+#include "presentation-time-protocol.h"
+#include "util/signal.h"
+
+#define PRESENTATION_VERSION 1
+
+static void feedback_destroy(struct wlr_presentation_feedback *feedback) {
+	if (feedback == NULL) {
+		return;
+	}
+	wl_resource_set_user_data(feedback->resource, NULL);
+	wl_list_remove(&feedback->surface_commit.link);
+	wl_list_remove(&feedback->surface_destroy.link);
+	if (feedback->output != NULL) {
+		wl_list_remove(&feedback->output_destroy.link);
+	}
+	wl_list_remove(&feedback->link);
+	free(feedback);
+}
+
+static void feedback_resource_destroy(struct wl_resource *resource) {
+	struct wlr_presentation_feedback *feedback =
+		wl_resource_get_user_data(resource);
+	feedback_destroy(feedback);
+}
+
+/**
+ * Sends the discarded event and destroys the feedback. The protocol object is
+ * destroyed along with it.
+ */
+static void feedback_discard(struct wlr_presentation_feedback *feedback) {
+	wp_presentation_feedback_send_discarded(feedback->resource);
+	wl_resource_destroy(feedback->resource);
+}
+
+static void feedback_handle_surface_commit(struct wl_listener *listener,
+		void *data) {
+	struct wlr_presentation_feedback *feedback =
+		wl_container_of(listener, feedback, surface_commit);
+	if (feedback->output != NULL) {
+		// The content update is already part of a submitted frame
+		return;
+	}
+	if (feedback->committed) {
+		// The content update has been superseded before being presented
+		feedback_discard(feedback);
+	} else {
+		feedback->committed = true;
+	}
+}
+
+static void feedback_handle_surface_destroy(struct wl_listener *listener,
+		void *data) {
+	struct wlr_presentation_feedback *feedback =
+		wl_container_of(listener, feedback, surface_destroy);
+	feedback_discard(feedback);
+}
+
+static void feedback_handle_output_destroy(struct wl_listener *listener,
+		void *data) {
+	struct wlr_presentation_feedback *feedback =
+		wl_container_of(listener, feedback, output_destroy);
+	feedback_discard(feedback);
+}
+
+static const struct wp_presentation_interface presentation_impl;
+
+static struct wlr_presentation *presentation_from_resource(
+		struct wl_resource *resource) {
+	assert(wl_resource_instance_of(resource, &wp_presentation_interface,
+		&presentation_impl));
+	return wl_resource_get_user_data(resource);
+}
+
+static void presentation_handle_feedback(struct wl_client *client,
+		struct wl_resource *presentation_resource,
+		struct wl_resource *surface_resource, uint32_t id) {
+	struct wlr_presentation *presentation =
+		presentation_from_resource(presentation_resource);
+	struct wlr_surface *surface = wlr_surface_from_resource(surface_resource);
+
+	struct wlr_presentation_feedback *feedback =
+		calloc(1, sizeof(struct wlr_presentation_feedback));
+	if (feedback == NULL) {
+		wl_client_post_no_memory(client);
+		return;
+	}
+
+	uint32_t version = wl_resource_get_version(presentation_resource);
+	feedback->resource = wl_resource_create(client,
+		&wp_presentation_feedback_interface, version, id);
+	if (feedback->resource == NULL) {
+		free(feedback);
+		wl_client_post_no_memory(client);
+		return;
+	}
+	// wp_presentation_feedback has no requests
+	wl_resource_set_implementation(feedback->resource, NULL, feedback,
+		feedback_resource_destroy);
+
+	feedback->presentation = presentation;
+	feedback->surface = surface;
+
+	feedback->surface_commit.notify = feedback_handle_surface_commit;
+	wl_signal_add(&surface->events.commit, &feedback->surface_commit);
+	feedback->surface_destroy.notify = feedback_handle_surface_destroy;
+	wl_signal_add(&surface->events.destroy, &feedback->surface_destroy);
+
+	wl_list_insert(&presentation->feedbacks, &feedback->link);
+}
+
+static void presentation_handle_destroy(struct wl_client *client,
+		struct wl_resource *resource) {
+	wl_resource_destroy(resource);
+}
+
+static const struct wp_presentation_interface presentation_impl = {
+	.destroy = presentation_handle_destroy,
+	.feedback = presentation_handle_feedback,
+};
+
+static void presentation_resource_destroy(struct wl_resource *resource) {
+	wl_list_remove(wl_resource_get_link(resource));
+}
+
+static void presentation_bind(struct wl_client *client, void *data,
+		uint32_t version, uint32_t id) {
+	struct wlr_presentation *presentation = data;
+	assert(client && presentation);
+
+	struct wl_resource *resource = wl_resource_create(client,
+		&wp_presentation_interface, version, id);
+	if (resource == NULL) {
+		wl_client_post_no_memory(client);
+		return;
+	}
+	wl_resource_set_implementation(resource, &presentation_impl,
+		presentation, presentation_resource_destroy);
+	wl_list_insert(&presentation->resources, wl_resource_get_link(resource));
+
+	wp_presentation_send_clock_id(resource, (uint32_t)presentation->clock);
+}
+
+void wlr_presentation_destroy(struct wlr_presentation *presentation) {
+	if (presentation == NULL) {
+		return;
+	}
+	wlr_signal_emit_safe(&presentation->events.destroy, presentation);
+
+	wl_list_remove(&presentation->display_destroy.link);
+	wl_global_destroy(presentation->global);
+
+	struct wlr_presentation_feedback *feedback, *feedback_tmp;
+	wl_list_for_each_safe(feedback, feedback_tmp, &presentation->feedbacks,
+			link) {
+		wl_resource_destroy(feedback->resource);
+	}
+
+	struct wl_resource *resource, *resource_tmp;
+	wl_resource_for_each_safe(resource, resource_tmp,
+			&presentation->resources) {
+		wl_resource_destroy(resource);
+	}
+
+	free(presentation);
+}
+
+static void handle_display_destroy(struct wl_listener *listener, void *data) {
+	struct wlr_presentation *presentation =
+		wl_container_of(listener, presentation, display_destroy);
+	wlr_presentation_destroy(presentation);
+}
+
+struct wlr_presentation *wlr_presentation_create(struct wl_display *display) {
+	struct wlr_presentation *presentation =
+		calloc(1, sizeof(struct wlr_presentation));
+	if (presentation == NULL) {
+		return NULL;
+	}
+
+	presentation->global = wl_global_create(display,
+		&wp_presentation_interface, PRESENTATION_VERSION, presentation,
+		presentation_bind);
+	if (presentation->global == NULL) {
+		free(presentation);
+		return NULL;
+	}
+
+	// Timestamps reported by wlr_output are always monotonic
+	presentation->clock = CLOCK_MONOTONIC;
+
+	wl_list_init(&presentation->resources);
+	wl_list_init(&presentation->feedbacks);
+	wl_signal_init(&presentation->events.destroy);
+
+	presentation->display_destroy.notify = handle_display_destroy;
+	wl_display_add_destroy_listener(display, &presentation->display_destroy);
+
+	return presentation;
+}
+
+static void feedback_send_presented(struct wlr_presentation_feedback *feedback,
+		struct wlr_presentation_event *event) {
+	struct wl_client *client = wl_resource_get_client(feedback->resource);
+	struct wl_resource *resource;
+	wl_resource_for_each(resource, &event->output->wl_resources) {
+		if (wl_resource_get_client(resource) == client) {
+			wp_presentation_feedback_send_sync_output(feedback->resource,
+				resource);
+		}
+	}
+
+	wp_presentation_feedback_send_presented(feedback->resource,
+		event->tv_sec >> 32, event->tv_sec, event->tv_nsec, event->refresh,
+		event->seq >> 32, event->seq, event->flags);
+	wl_resource_destroy(feedback->resource);
+}
+
+void wlr_presentation_surface_sampled(struct wlr_presentation *presentation,
+		struct wlr_surface *surface, struct wlr_output *output) {
+	struct wlr_presentation_feedback *feedback;
+	wl_list_for_each(feedback, &presentation->feedbacks, link) {
+		// If the surface is on several outputs, the first frame wins
+		if (feedback->surface != surface || !feedback->committed ||
+				feedback->output != NULL) {
+			continue;
+		}
+		feedback->output = output;
+		feedback->output_destroy.notify = feedback_handle_output_destroy;
+		wl_signal_add(&output->events.destroy, &feedback->output_destroy);
+	}
+}
+
+void wlr_presentation_send_output_presented(
+		struct wlr_presentation *presentation,
+		struct wlr_presentation_event *event) {
+	struct wlr_presentation_feedback *feedback, *tmp;
+	wl_list_for_each_safe(feedback, tmp, &presentation->feedbacks, link) {
+		if (feedback->output == event->output) {
+			feedback_send_presented(feedback, event);
+		}
+	}
+}
+
+void wlr_presentation_event_from_output(struct wlr_presentation_event *event,
+		const struct wlr_output_event_present *output_event) {
+	event->output = output_event->output;
+	event->tv_sec = (uint64_t)output_event->when->tv_sec;
+	event->tv_nsec = (uint32_t)output_event->when->tv_nsec;
+	event->refresh = (uint32_t)output_event->refresh;
+	event->seq = (uint64_t)output_event->seq;
+	event->flags = output_event->flags;
+}
@@ -16,12 +16,28 @@ static struct wlr_screenshot *screenshot_from_resource(
 	return wl_resource_get_user_data(resource);
 }
 
+/**
+ * Lives until the pixels have been copied, which can happen after the
+ * screenshot or the buffer have been destroyed.
+ */
 struct screenshot_state {
-	struct wl_shm_buffer *shm_buffer;
-	struct wlr_screenshot *screenshot;
+	struct wl_resource *screenshot_resource; // NULL if destroyed
+	struct wl_resource *buffer_resource; // NULL if destroyed
+	struct wlr_output *output;
+	bool reading;
+
 	struct wl_listener frame_listener;
+	struct wl_listener screenshot_destroy;
+	struct wl_listener buffer_destroy;
 };
 
+static void screenshot_state_destroy(struct screenshot_state *state) {
+	wl_list_remove(&state->frame_listener.link);
+	wl_list_remove(&state->screenshot_destroy.link);
+	wl_list_remove(&state->buffer_destroy.link);
+	free(state);
+}
+
 static void screenshot_destroy(struct wlr_screenshot *screenshot) {
 	wl_list_remove(&screenshot->link);
 	wl_resource_set_user_data(screenshot->resource, NULL);
@@ -37,33 +53,86 @@ static void handle_screenshot_resource_destroy(
 	}
 }
 
+static void state_handle_read_pixels(const void *pixels, int32_t stride,
+		void *data) {
+	struct screenshot_state *state = data;
+	if (pixels == NULL) {
+		wlr_log(L_ERROR, "Cannot read pixels");
+		goto cleanup;
+	}
+	if (state->screenshot_resource == NULL || state->buffer_resource == NULL) {
+		goto cleanup;
+	}
+
+	struct wl_shm_buffer *shm_buffer =
+		wl_shm_buffer_get(state->buffer_resource);
+	int32_t height = wl_shm_buffer_get_height(shm_buffer);
+	int32_t shm_stride = wl_shm_buffer_get_stride(shm_buffer);
+	size_t row_size = abs(stride) < shm_stride ? abs(stride) : shm_stride;
+
+	wl_shm_buffer_begin_access(shm_buffer);
+	uint8_t *dst = wl_shm_buffer_get_data(shm_buffer);
+	const uint8_t *src = pixels;
+	for (int32_t i = 0; i < height; ++i) {
+		memcpy(dst + i * shm_stride, src + i * stride, row_size);
+	}
+	wl_shm_buffer_end_access(shm_buffer);
+
+	orbital_screenshot_send_done(state->screenshot_resource);
+
+cleanup:
+	screenshot_state_destroy(state);
+}
+
 static void output_handle_frame(struct wl_listener *listener, void *_data) {
 	struct screenshot_state *state = wl_container_of(listener, state,
 		frame_listener);
-	struct wlr_output *output = state->screenshot->output;
+	struct wlr_output *output = state->output;
 	struct wlr_renderer *renderer = wlr_backend_get_renderer(output->backend);
-	struct wl_shm_buffer *shm_buffer = state->shm_buffer;
+	struct wl_shm_buffer *shm_buffer =
+		wl_shm_buffer_get(state->buffer_resource);
 
+	wl_list_remove(&listener->link);
+	wl_list_init(&listener->link);
+
+	// Don't stall the compositor until the GPU is done, the pixels are copied
+	// to the buffer later on
 	enum wl_shm_format format = wl_shm_buffer_get_format(shm_buffer);
 	int32_t width = wl_shm_buffer_get_width(shm_buffer);
 	int32_t height = wl_shm_buffer_get_height(shm_buffer);
-	int32_t stride = wl_shm_buffer_get_stride(shm_buffer);
-	wl_shm_buffer_begin_access(shm_buffer);
-	void *data = wl_shm_buffer_get_data(shm_buffer);
-	bool ok = wlr_renderer_read_pixels(renderer, format, stride, width, height,
-		0, 0, 0, 0, data);
-	wl_shm_buffer_end_access(shm_buffer);
-
-	if (!ok) {
+	struct wl_event_loop *loop = wl_display_get_event_loop(
+		wl_client_get_display(wl_resource_get_client(state->buffer_resource)));
+	if (!wlr_renderer_read_pixels_async(renderer, loop, format, width, height,
+			0, 0, state_handle_read_pixels, state)) {
 		wlr_log(L_ERROR, "Cannot read pixels");
-		goto cleanup;
+		screenshot_state_destroy(state);
+		return;
 	}
+	state->reading = true;
+}
 
-	orbital_screenshot_send_done(state->screenshot->resource);
+static void state_handle_screenshot_destroy(struct wl_listener *listener,
+		void *data) {
+	struct screenshot_state *state = wl_container_of(listener, state,
+		screenshot_destroy);
+	state->screenshot_resource = NULL;
+	wl_list_remove(&listener->link);
+	wl_list_init(&listener->link);
+	if (!state->reading) {
+		screenshot_state_destroy(state);
+	}
+}
 
-cleanup:
+static void state_handle_buffer_destroy(struct wl_listener *listener,
+		void *data) {
+	struct screenshot_state *state = wl_container_of(listener, state,
+		buffer_destroy);
+	state->buffer_resource = NULL;
 	wl_list_remove(&listener->link);
-	free(state);
+	wl_list_init(&listener->link);
+	if (!state->reading) {
+		screenshot_state_destroy(state);
+	}
 }
 
 static const struct orbital_screenshooter_interface screenshooter_impl;
@@ -139,10 +208,16 @@ static void screenshooter_shoot(struct wl_client *client,
 		wl_resource_post_no_memory(screenshooter_resource);
 		return;
 	}
-	state->shm_buffer = shm_buffer;
-	state->screenshot = screenshot;
+	state->screenshot_resource = screenshot->resource;
+	state->buffer_resource = buffer_resource;
+	state->output = output;
 	state->frame_listener.notify = output_handle_frame;
 	wl_signal_add(&output->events.swap_buffers, &state->frame_listener);
+	state->screenshot_destroy.notify = state_handle_screenshot_destroy;
+	wl_resource_add_destroy_listener(screenshot->resource,
+		&state->screenshot_destroy);
+	state->buffer_destroy.notify = state_handle_buffer_destroy;
+	wl_resource_add_destroy_listener(buffer_resource, &state->buffer_destroy);
 
 	// Schedule a buffer swap
 	output->needs_swap = true;
@@ -102,7 +102,7 @@ static void wl_keyboard_destroy(struct wl_resource *resource) {
 
 static void seat_client_send_keymap(struct wlr_seat_client *client,
 		struct wlr_keyboard *keyboard) {
-	if (!keyboard) {
+	if (!keyboard || keyboard->keymap_fd < 0) {
 		return;
 	}
 
@@ -747,10 +747,13 @@ static void handle_keyboard_keymap(struct wl_listener *listener, void *data) {
 		wl_container_of(listener, state, keyboard_keymap);
 	struct wlr_seat_client *client;
 	struct wlr_keyboard *keyboard = data;
-	if (keyboard == state->keyboard) {
-		wl_list_for_each(client, &state->seat->clients, link) {
-			seat_client_send_keymap(client, state->keyboard);
-		}
+	if (keyboard != state->keyboard ||
+			keyboard->keymap_serial == state->keymap_serial) {
+		return;
+	}
+	state->keymap_serial = keyboard->keymap_serial;
+	wl_list_for_each(client, &state->seat->clients, link) {
+		seat_client_send_keymap(client, state->keyboard);
 	}
 }
 
@@ -768,6 +771,8 @@ static void handle_keyboard_destroy(struct wl_listener *listener, void *data) {
 	struct wlr_seat_keyboard_state *state =
 		wl_container_of(listener, state, keyboard_destroy);
 	state->keyboard = NULL;
+	// Clients binding wl_keyboard from now on won't get any keymap
+	state->keymap_serial = 0;
 }
 
 void wlr_seat_set_keyboard(struct wlr_seat *seat,
@@ -802,15 +807,23 @@ void wlr_seat_set_keyboard(struct wlr_seat *seat,
 		seat->keyboard_state.keyboard_repeat_info.notify =
 			handle_keyboard_repeat_info;
 
+		// Clients already have the keymap if the previous keyboard shared it
+		bool send_keymap =
+			keyboard->keymap_serial != seat->keyboard_state.keymap_serial;
+		seat->keyboard_state.keymap_serial = keyboard->keymap_serial;
+
 		struct wlr_seat_client *client;
 		wl_list_for_each(client, &seat->clients, link) {
-			seat_client_send_keymap(client, keyboard);
+			if (send_keymap) {
+				seat_client_send_keymap(client, keyboard);
+			}
 			seat_client_send_repeat_info(client, keyboard);
 		}
 
 		wlr_seat_keyboard_send_modifiers(seat, &keyboard->modifiers);
 	} else {
 		seat->keyboard_state.keyboard = NULL;
+		seat->keyboard_state.keymap_serial = 0;
 	}
 }
 
@@ -10,6 +10,65 @@
 #include <wlr/util/region.h>
 #include "util/signal.h"
 
+struct wlr_buffer_lock {
+	struct wl_resource *buffer; // NULL if destroyed
+	struct wl_listener buffer_destroy;
+	size_t locks;
+	bool release_pending; // the surface doesn't use the buffer anymore
+};
+
+static void buffer_lock_handle_destroy(struct wl_listener *listener,
+		void *data) {
+	struct wlr_buffer_lock *lock =
+		wl_container_of(listener, lock, buffer_destroy);
+	wl_list_remove(&lock->buffer_destroy.link);
+	lock->buffer = NULL;
+}
+
+static struct wlr_buffer_lock *buffer_get_lock(struct wl_resource *buffer) {
+	struct wl_listener *listener = wl_resource_get_destroy_listener(buffer,
+		buffer_lock_handle_destroy);
+	if (listener == NULL) {
+		return NULL;
+	}
+	struct wlr_buffer_lock *lock =
+		wl_container_of(listener, lock, buffer_destroy);
+	return lock;
+}
+
+struct wlr_buffer_lock *wlr_surface_lock_buffer(struct wl_resource *buffer) {
+	struct wlr_buffer_lock *lock = buffer_get_lock(buffer);
+	if (lock == NULL) {
+		lock = calloc(1, sizeof(struct wlr_buffer_lock));
+		if (lock == NULL) {
+			wlr_log(L_ERROR, "Allocation failed");
+			return NULL;
+		}
+		lock->buffer = buffer;
+		lock->buffer_destroy.notify = buffer_lock_handle_destroy;
+		wl_resource_add_destroy_listener(buffer, &lock->buffer_destroy);
+	}
+	++lock->locks;
+	return lock;
+}
+
+void wlr_surface_unlock_buffer(struct wlr_buffer_lock *lock) {
+	if (lock == NULL) {
+		return;
+	}
+	assert(lock->locks > 0);
+	if (--lock->locks > 0) {
+		return;
+	}
+	if (lock->buffer != NULL) {
+		if (lock->release_pending) {
+			wl_resource_post_event(lock->buffer, WL_BUFFER_RELEASE);
+		}
+		wl_list_remove(&lock->buffer_destroy.link);
+	}
+	free(lock);
+}
+
 static void wlr_surface_state_reset_buffer(struct wlr_surface_state *state) {
 	if (state->buffer) {
 		wl_list_remove(&state->buffer_destroy_listener.link);
@@ -27,7 +86,13 @@ static void buffer_destroy(struct wl_listener *listener, void *data) {
 
 static void wlr_surface_state_release_buffer(struct wlr_surface_state *state) {
 	if (state->buffer) {
-		wl_resource_post_event(state->buffer, WL_BUFFER_RELEASE);
+		struct wlr_buffer_lock *lock = buffer_get_lock(state->buffer);
+		if (lock != NULL) {
+			// Sent once the buffer is unlocked
+			lock->release_pending = true;
+		} else {
+			wl_resource_post_event(state->buffer, WL_BUFFER_RELEASE);
+		}
 		wl_list_remove(&state->buffer_destroy_listener.link);
 		state->buffer = NULL;
 	}
@@ -40,6 +105,12 @@ static void wlr_surface_state_set_buffer(struct wlr_surface_state *state,
 		wl_resource_add_destroy_listener(buffer,
 			&state->buffer_destroy_listener);
 		state->buffer_destroy_listener.notify = buffer_destroy;
+
+		// The buffer is in use by the surface again
+		struct wlr_buffer_lock *lock = buffer_get_lock(buffer);
+		if (lock != NULL) {
+			lock->release_pending = false;
+		}
 	}
 }
 
@@ -240,17 +311,15 @@ static void wlr_surface_move_state(struct wlr_surface *surface,
 		pixman_region32_init(&surface_damage);
 
 		// Surface to buffer damage
-		pixman_region32_copy(&buffer_damage, &state->surface_damage);
-		wlr_region_transform(&buffer_damage, &buffer_damage,
+		wlr_region_transform_scale_translate(&buffer_damage,
+			&state->surface_damage,
 			wlr_output_transform_invert(state->transform),
-			state->width, state->height);
-		wlr_region_scale(&buffer_damage, &buffer_damage, state->scale);
+			state->width, state->height, state->scale, 0, 0);
 
 		// Buffer to surface damage
-		pixman_region32_copy(&surface_damage, &state->buffer_damage);
-		wlr_region_transform(&surface_damage, &surface_damage, state->transform,
-			state->buffer_width, state->buffer_height);
-		wlr_region_scale(&surface_damage, &surface_damage, 1.0f/state->scale);
+		wlr_region_transform_scale_translate(&surface_damage,
+			&state->buffer_damage, state->transform, state->buffer_width,
+			state->buffer_height, 1.0f/state->scale, 0, 0);
 
 		pixman_region32_union(&state->buffer_damage, &state->buffer_damage,
 			&buffer_damage);
@@ -262,7 +331,7 @@ static void wlr_surface_move_state(struct wlr_surface *surface,
 	}
 	if ((next->invalid & WLR_SURFACE_INVALID_OPAQUE_REGION)) {
 		// TODO: process buffer
-		pixman_region32_clear(&next->opaque);
+		pixman_region32_copy(&state->opaque, &next->opaque);
 	}
 	if ((next->invalid & WLR_SURFACE_INVALID_INPUT_REGION)) {
 		// TODO: process buffer
@@ -315,7 +384,7 @@ static void wlr_surface_damage_subsurfaces(struct wlr_subsurface *subsurface) {
 }
 
 static void wlr_surface_apply_damage(struct wlr_surface *surface,
-		bool reupload_buffer) {
+		bool new_buffer, bool reupload_buffer) {
 	if (!surface->current->buffer) {
 		return;
 	}
@@ -323,8 +392,13 @@ static void wlr_surface_apply_damage(struct wlr_surface *surface,
 	if (!buffer) {
 		if (wlr_renderer_buffer_is_drm(surface->renderer,
 					surface->current->buffer)) {
-			wlr_texture_upload_drm(surface->texture, surface->current->buffer);
-			goto release;
+			// The texture uses the buffer storage directly and outputs may
+			// scan it out, keep it until it is replaced
+			if (new_buffer) {
+				wlr_texture_upload_drm(surface->texture,
+					surface->current->buffer);
+			}
+			return;
 		} else {
 			wlr_log(L_INFO, "Unknown buffer handle attached");
 			return;
@@ -341,23 +415,12 @@ static void wlr_surface_apply_damage(struct wlr_surface *surface,
 		pixman_region32_intersect_rect(&damage, &damage, 0, 0,
 			surface->current->buffer_width, surface->current->buffer_height);
 
-		int n;
-		pixman_box32_t *rects = pixman_region32_rectangles(&damage, &n);
-		for (int i = 0; i < n; ++i) {
-			pixman_box32_t rect = rects[i];
-			if (!wlr_texture_update_shm(surface->texture, format,
-					rect.x1, rect.y1,
-					rect.x2 - rect.x1,
-					rect.y2 - rect.y1,
-					buffer)) {
-				break;
-			}
-		}
+		wlr_texture_update_shm_region(surface->texture, format, &damage,
+			buffer);
 
 		pixman_region32_fini(&damage);
 	}
 
-release:
 	wlr_surface_state_release_buffer(surface->current);
 }
 
@@ -365,9 +428,8 @@ static void wlr_surface_commit_pending(struct wlr_surface *surface) {
 	int32_t oldw = surface->current->buffer_width;
 	int32_t oldh = surface->current->buffer_height;
 
-	bool null_buffer_commit =
-		(surface->pending->invalid & WLR_SURFACE_INVALID_BUFFER &&
-		 surface->pending->buffer == NULL);
+	bool new_buffer = surface->pending->invalid & WLR_SURFACE_INVALID_BUFFER;
+	bool null_buffer_commit = new_buffer && surface->pending->buffer == NULL;
 
 	wlr_surface_move_state(surface, surface->pending, surface->current);
 
@@ -377,7 +439,7 @@ static void wlr_surface_commit_pending(struct wlr_surface *surface) {
 
 	bool reupload_buffer = oldw != surface->current->buffer_width ||
 		oldh != surface->current->buffer_height;
-	wlr_surface_apply_damage(surface, reupload_buffer);
+	wlr_surface_apply_damage(surface, new_buffer, reupload_buffer);
 
 	// commit subsurface order
 	struct wlr_subsurface *subsurface;
@@ -584,6 +646,12 @@ void wlr_subsurface_destroy(struct wlr_subsurface *subsurface) {
 	free(subsurface);
 }
 
+static void surface_output_destroy(struct wlr_surface_output *surface_output) {
+	wl_list_remove(&surface_output->link);
+	wl_list_remove(&surface_output->output_destroy.link);
+	free(surface_output);
+}
+
 static void destroy_surface(struct wl_resource *resource) {
 	struct wlr_surface *surface = wlr_surface_from_resource(resource);
 	wlr_signal_emit_safe(&surface->events.destroy, surface);
@@ -592,6 +660,12 @@ static void destroy_surface(struct wl_resource *resource) {
 		wlr_subsurface_destroy(surface->subsurface);
 	}
 
+	struct wlr_surface_output *surface_output, *tmp;
+	wl_list_for_each_safe(surface_output, tmp, &surface->current_outputs,
+			link) {
+		surface_output_destroy(surface_output);
+	}
+
 	wlr_texture_destroy(surface->texture);
 	wlr_surface_state_destroy(surface->pending);
 	wlr_surface_state_destroy(surface->current);
@@ -619,6 +693,7 @@ struct wlr_surface *wlr_surface_create(struct wl_resource *res,
 	wl_signal_init(&surface->events.new_subsurface);
 	wl_list_init(&surface->subsurface_list);
 	wl_list_init(&surface->subsurface_pending_list);
+	wl_list_init(&surface->current_outputs);
 	wl_resource_set_implementation(res, &surface_interface,
 		surface, destroy_surface);
 	return surface;
@@ -894,8 +969,44 @@ struct wlr_subsurface *wlr_surface_subsurface_at(struct wlr_surface *surface,
 	return NULL;
 }
 
+static struct wlr_surface_output *surface_get_output(
+		struct wlr_surface *surface, struct wlr_output *output) {
+	struct wlr_surface_output *surface_output;
+	wl_list_for_each(surface_output, &surface->current_outputs, link) {
+		if (surface_output->output == output) {
+			return surface_output;
+		}
+	}
+	return NULL;
+}
+
+static void surface_output_handle_output_destroy(struct wl_listener *listener,
+		void *data) {
+	struct wlr_surface_output *surface_output =
+		wl_container_of(listener, surface_output, output_destroy);
+	// The wl_output global is gone, the client doesn't need a leave event
+	surface_output_destroy(surface_output);
+}
+
 void wlr_surface_send_enter(struct wlr_surface *surface,
 		struct wlr_output *output) {
+	if (surface_get_output(surface, output) != NULL) {
+		return;
+	}
+
+	struct wlr_surface_output *surface_output =
+		calloc(1, sizeof(struct wlr_surface_output));
+	if (surface_output == NULL) {
+		wlr_log(L_ERROR, "Allocation failed");
+		return;
+	}
+	surface_output->surface = surface;
+	surface_output->output = output;
+	wl_list_insert(&surface->current_outputs, &surface_output->link);
+	surface_output->output_destroy.notify =
+		surface_output_handle_output_destroy;
+	wl_signal_add(&output->events.destroy, &surface_output->output_destroy);
+
 	struct wl_client *client = wl_resource_get_client(surface->resource);
 	struct wl_resource *resource;
 	wl_resource_for_each(resource, &output->wl_resources) {
@@ -908,6 +1019,13 @@ void wlr_surface_send_enter(struct wlr_surface *surface,
 
 void wlr_surface_send_leave(struct wlr_surface *surface,
 		struct wlr_output *output) {
+	struct wlr_surface_output *surface_output =
+		surface_get_output(surface, output);
+	if (surface_output == NULL) {
+		return;
+	}
+	surface_output_destroy(surface_output);
+
 	struct wl_client *client = wl_resource_get_client(surface->resource);
 	struct wl_resource *resource;
 	wl_resource_for_each(resource, &output->wl_resources) {
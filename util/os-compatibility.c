@@ -24,10 +24,15 @@
  */
 
 #define _XOPEN_SOURCE 700
+#ifdef HAVE_MEMFD_CREATE
+#define _GNU_SOURCE
+#endif
 #include <errno.h>
 #include <fcntl.h>
+#include <stdbool.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
 #include <sys/socket.h>
 #include <sys/types.h>
 #include <unistd.h>
@@ -145,3 +150,56 @@ int os_create_anonymous_file(off_t size) {
 
 	return fd;
 }
+
+static bool write_all(int fd, const char *data, size_t size) {
+	while (size > 0) {
+		ssize_t ret = write(fd, data, size);
+		if (ret < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return false;
+		}
+		data += ret;
+		size -= ret;
+	}
+	return true;
+}
+
+/*
+ * Create an anonymous file holding a copy of `data`, suitable for sharing
+ * with clients which should only be able to mmap() it read-only.
+ *
+ * When memfd_create() is available the file is sealed, so that clients can
+ * neither modify nor resize it. Otherwise this falls back to
+ * os_create_anonymous_file().
+ */
+int os_create_sealed_file(const void *data, size_t size) {
+	int fd;
+#ifdef HAVE_MEMFD_CREATE
+	fd = memfd_create("wlroots-shared", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+	if (fd < 0) {
+		return -1;
+	}
+#else
+	fd = os_create_anonymous_file(size);
+	if (fd < 0) {
+		return -1;
+	}
+#endif
+
+	if (!write_all(fd, data, size)) {
+		close(fd);
+		return -1;
+	}
+
+#ifdef HAVE_MEMFD_CREATE
+	if (fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE |
+			F_SEAL_SEAL) < 0) {
+		close(fd);
+		return -1;
+	}
+#endif
+
+	return fd;
+}
@@ -24,6 +24,7 @@
  */
 
 #define _XOPEN_SOURCE 500
+#include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -32,6 +33,28 @@
 #include <wlr/xcursor.h>
 #include "xcursor/xcursor.h"
 
+struct wlr_xcursor_theme_entry {
+	char *name;
+	char *path;
+	size_t order; // scan order, the first of duplicate names wins
+	bool loaded;
+	struct xcursor_cache_entry *cached; // NULL until loaded or if invalid
+};
+
+/**
+ * A decoded cursor file, shared by all themes resolving to the same file and
+ * nominal image size.
+ */
+struct xcursor_cache_entry {
+	struct xcursor_cache_entry *next;
+	char *path;
+	unsigned int size;
+	struct wlr_xcursor *cursor;
+	size_t refs;
+};
+
+static struct xcursor_cache_entry *xcursor_cache = NULL;
+
 static void wlr_xcursor_destroy(struct wlr_xcursor *cursor) {
 	for (size_t i = 0; i < cursor->image_count; i++) {
 		free(cursor->images[i]->buffer);
@@ -184,32 +207,164 @@ static struct wlr_xcursor *wlr_xcursor_create_from_xcursor_images(
 	return cursor;
 }
 
-static void load_callback(XcursorImages *images, void *data) {
-	struct wlr_xcursor_theme *theme = data;
-	struct wlr_xcursor *cursor;
+static struct xcursor_cache_entry *xcursor_cache_get(const char *path,
+		const char *name, int size) {
+	unsigned int best_size = xcursor_file_best_size(path, size);
+	if (best_size == 0) {
+		return NULL;
+	}
+
+	struct xcursor_cache_entry *entry;
+	for (entry = xcursor_cache; entry != NULL; entry = entry->next) {
+		if (entry->size == best_size && strcmp(entry->path, path) == 0) {
+			entry->refs++;
+			return entry;
+		}
+	}
+
+	entry = calloc(1, sizeof(*entry));
+	if (entry == NULL) {
+		return NULL;
+	}
+	entry->path = strdup(path);
+	if (entry->path == NULL) {
+		goto err_free_entry;
+	}
 
-	if (wlr_xcursor_theme_get_cursor(theme, images->name)) {
-		XcursorImagesDestroy(images);
+	XcursorImages *images = xcursor_file_load_images(path, name, size);
+	if (images == NULL) {
+		goto err_free_path;
+	}
+	entry->cursor = wlr_xcursor_create_from_xcursor_images(images, NULL);
+	XcursorImagesDestroy(images);
+	if (entry->cursor == NULL) {
+		goto err_free_path;
+	}
+
+	entry->size = best_size;
+	entry->refs = 1;
+	entry->next = xcursor_cache;
+	xcursor_cache = entry;
+	return entry;
+
+err_free_path:
+	free(entry->path);
+err_free_entry:
+	free(entry);
+	return NULL;
+}
+
+static void xcursor_cache_unref(struct xcursor_cache_entry *entry) {
+	if (entry == NULL || --entry->refs > 0) {
 		return;
 	}
 
-	cursor = wlr_xcursor_create_from_xcursor_images(images, theme);
+	struct xcursor_cache_entry **link = &xcursor_cache;
+	while (*link != entry) {
+		link = &(*link)->next;
+	}
+	*link = entry->next;
 
-	if (cursor) {
-		theme->cursor_count++;
-		theme->cursors =
-			realloc(theme->cursors,
-				theme->cursor_count * sizeof(theme->cursors[0]));
+	wlr_xcursor_destroy(entry->cursor);
+	free(entry->path);
+	free(entry);
+}
 
-		if (theme->cursors == NULL) {
-			theme->cursor_count--;
-			free(cursor);
-		} else {
-			theme->cursors[theme->cursor_count - 1] = cursor;
+struct scan_data {
+	struct wlr_xcursor_theme *theme;
+	size_t cap;
+};
+
+static void scan_callback(const char *name, const char *path, void *data) {
+	struct scan_data *scan = data;
+	struct wlr_xcursor_theme *theme = scan->theme;
+
+	if (theme->entry_count == scan->cap) {
+		size_t cap = scan->cap == 0 ? 64 : scan->cap * 2;
+		struct wlr_xcursor_theme_entry *entries =
+			realloc(theme->entries, cap * sizeof(theme->entries[0]));
+		if (entries == NULL) {
+			return;
 		}
+		theme->entries = entries;
+		scan->cap = cap;
 	}
 
-	XcursorImagesDestroy(images);
+	struct wlr_xcursor_theme_entry *entry =
+		&theme->entries[theme->entry_count];
+	entry->name = strdup(name);
+	entry->path = strdup(path);
+	if (entry->name == NULL || entry->path == NULL) {
+		free(entry->name);
+		free(entry->path);
+		return;
+	}
+	entry->order = theme->entry_count;
+	entry->loaded = false;
+	entry->cached = NULL;
+	theme->entry_count++;
+}
+
+static int entry_name_cmp(const void *_a, const void *_b) {
+	const struct wlr_xcursor_theme_entry *a = _a, *b = _b;
+	return strcmp(a->name, b->name);
+}
+
+static int entry_cmp(const void *_a, const void *_b) {
+	const struct wlr_xcursor_theme_entry *a = _a, *b = _b;
+	int cmp = strcmp(a->name, b->name);
+	if (cmp != 0) {
+		return cmp;
+	}
+	return a->order < b->order ? -1 : a->order > b->order;
+}
+
+/**
+ * Sorts the entries by name and only keeps the first occurrence of each name,
+ * which takes precedence in the theme.
+ */
+static void theme_sort_entries(struct wlr_xcursor_theme *theme) {
+	if (theme->entry_count == 0) {
+		return;
+	}
+	qsort(theme->entries, theme->entry_count, sizeof(theme->entries[0]),
+		entry_cmp);
+
+	size_t len = 1;
+	for (size_t i = 1; i < theme->entry_count; ++i) {
+		struct wlr_xcursor_theme_entry *entry = &theme->entries[i];
+		if (strcmp(entry->name, theme->entries[len - 1].name) == 0) {
+			free(entry->name);
+			free(entry->path);
+			continue;
+		}
+		theme->entries[len++] = *entry;
+	}
+	theme->entry_count = len;
+}
+
+static struct wlr_xcursor *theme_load_entry(struct wlr_xcursor_theme *theme,
+		struct wlr_xcursor_theme_entry *entry) {
+	if (entry->loaded) {
+		return entry->cached ? entry->cached->cursor : NULL;
+	}
+	entry->loaded = true;
+
+	entry->cached = xcursor_cache_get(entry->path, entry->name, theme->size);
+	if (entry->cached == NULL) {
+		wlr_log(L_DEBUG, "Failed to load cursor '%s' from %s", entry->name,
+			entry->path);
+		return NULL;
+	}
+	struct wlr_xcursor *cursor = entry->cached->cursor;
+
+	struct wlr_xcursor **cursors = realloc(theme->cursors,
+		(theme->cursor_count + 1) * sizeof(theme->cursors[0]));
+	if (cursors != NULL) {
+		theme->cursors = cursors;
+		theme->cursors[theme->cursor_count++] = cursor;
+	}
+	return cursor;
 }
 
 struct wlr_xcursor_theme *wlr_xcursor_theme_load(const char *name, int size) {
@@ -231,21 +386,20 @@ struct wlr_xcursor_theme *wlr_xcursor_theme_load(const char *name, int size) {
 	theme->size = size;
 	theme->cursor_count = 0;
 	theme->cursors = NULL;
+	theme->entry_count = 0;
+	theme->entries = NULL;
 
-	xcursor_load_theme(name, size, load_callback, theme);
+	struct scan_data scan = { .theme = theme };
+	xcursor_scan_theme(name, scan_callback, &scan);
+	theme_sort_entries(theme);
 
-	if (theme->cursor_count == 0) {
+	if (theme->entry_count == 0) {
 		load_default_theme(theme);
-	}
-
-	wlr_log(L_DEBUG, "Loaded cursor theme '%s', available cursors:",
-			theme->name);
-	for (size_t i = 0; i < theme->cursor_count; ++i) {
-		struct wlr_xcursor *c = theme->cursors[i];
-		struct wlr_xcursor_image *i = c->images[0];
-		wlr_log(L_DEBUG, "%s (%u images) %dx%d+%d,%d",
-				c->name, c->image_count,
-				i->width, i->height, i->hotspot_x, i->hotspot_y);
+		wlr_log(L_DEBUG, "Loaded built-in cursor theme '%s' (%u cursors)",
+			theme->name, theme->cursor_count);
+	} else {
+		wlr_log(L_DEBUG, "Loaded cursor theme '%s' (%zu cursors)",
+			theme->name, theme->entry_count);
 	}
 
 	return theme;
@@ -256,12 +410,20 @@ out_error_name:
 }
 
 void wlr_xcursor_theme_destroy(struct wlr_xcursor_theme *theme) {
-	unsigned int i;
-
-	for (i = 0; i < theme->cursor_count; i++) {
-		wlr_xcursor_destroy(theme->cursors[i]);
+	if (theme->entry_count > 0) {
+		// Cursors loaded from files are owned by the cache
+		for (size_t i = 0; i < theme->entry_count; i++) {
+			xcursor_cache_unref(theme->entries[i].cached);
+			free(theme->entries[i].name);
+			free(theme->entries[i].path);
+		}
+	} else {
+		for (unsigned int i = 0; i < theme->cursor_count; i++) {
+			wlr_xcursor_destroy(theme->cursors[i]);
+		}
 	}
 
+	free(theme->entries);
 	free(theme->name);
 	free(theme->cursors);
 	free(theme);
@@ -269,8 +431,17 @@ void wlr_xcursor_theme_destroy(struct wlr_xcursor_theme *theme) {
 
 struct wlr_xcursor *wlr_xcursor_theme_get_cursor(struct wlr_xcursor_theme *theme,
 		const char *name) {
-	unsigned int i;
+	if (theme->entry_count > 0) {
+		struct wlr_xcursor_theme_entry key = { .name = (char *)name };
+		struct wlr_xcursor_theme_entry *entry = bsearch(&key, theme->entries,
+			theme->entry_count, sizeof(theme->entries[0]), entry_name_cmp);
+		if (entry == NULL) {
+			return NULL;
+		}
+		return theme_load_entry(theme, entry);
+	}
 
+	unsigned int i;
 	for (i = 0; i < theme->cursor_count; i++) {
 		if (strcmp(name, theme->cursors[i]->name) == 0) {
 			return theme->cursors[i];
@@ -968,3 +968,145 @@ xcursor_load_theme(const char *theme, int size,
 	if (inherits)
 		free(inherits);
 }
+
+static void
+scan_cursors_in_dir(const char *path,
+		    void (*scan_callback)(const char *, const char *, void *),
+		    void *user_data)
+{
+	DIR *dir = opendir(path);
+	struct dirent *ent;
+	char *full;
+
+	if (!dir)
+		return;
+
+	for (ent = readdir(dir); ent; ent = readdir(dir)) {
+		if (ent->d_type != DT_UNKNOWN &&
+		    (ent->d_type != DT_REG && ent->d_type != DT_LNK))
+			continue;
+
+		full = _XcursorBuildFullname(path, "", ent->d_name);
+		if (!full)
+			continue;
+
+		scan_callback(ent->d_name, full, user_data);
+		free(full);
+	}
+
+	closedir(dir);
+}
+
+/** List the cursor files of a theme without loading them
+ *
+ * This function walks the same directories as xcursor_load_theme(), in the
+ * same order, but only reports the name and path of each cursor file. No
+ * file is opened. A name may be reported more than once, the first
+ * occurrence is the one xcursor_load_theme() would have used.
+ *
+ * \param theme The name of theme that should be scanned
+ * \param scan_callback A callback function that will be called for each
+ * cursor file, with its name, its full path and the user data.
+ * \param user_data The data that should be passed to the scan callback
+ */
+void
+xcursor_scan_theme(const char *theme,
+		   void (*scan_callback)(const char *, const char *, void *),
+		   void *user_data)
+{
+	char *full, *dir;
+	char *inherits = NULL;
+	const char *path, *i;
+
+	if (!theme)
+		theme = "default";
+
+	for (path = XcursorLibraryPath();
+	     path;
+	     path = _XcursorNextPath(path)) {
+		dir = _XcursorBuildThemeDir(path, theme);
+		if (!dir)
+			continue;
+
+		full = _XcursorBuildFullname(dir, "cursors", "");
+
+		if (full) {
+			scan_cursors_in_dir(full, scan_callback, user_data);
+			free(full);
+		}
+
+		if (!inherits) {
+			full = _XcursorBuildFullname(dir, "", "index.theme");
+			if (full) {
+				inherits = _XcursorThemeInherits(full);
+				free(full);
+			}
+		}
+
+		free(dir);
+	}
+
+	for (i = inherits; i; i = _XcursorNextPath(i))
+		xcursor_scan_theme(i, scan_callback, user_data);
+
+	if (inherits)
+		free(inherits);
+}
+
+/** Get the nominal size of the images a cursor file holds for a size
+ *
+ * Only the file header is read. Returns 0 if the file is not a valid cursor
+ * file.
+ */
+unsigned int
+xcursor_file_best_size(const char *path, int size)
+{
+	FILE *f;
+	XcursorFile file;
+	XcursorFileHeader *fileHeader;
+	XcursorDim bestSize;
+	int nsize;
+
+	if (!path || size < 0)
+		return 0;
+
+	f = fopen(path, "r");
+	if (!f)
+		return 0;
+
+	_XcursorStdioFileInitialize(f, &file);
+	fileHeader = _XcursorReadFileHeader(&file);
+	fclose(f);
+	if (!fileHeader)
+		return 0;
+
+	bestSize = _XcursorFindBestSize(fileHeader, (XcursorDim) size, &nsize);
+	_XcursorFileHeaderDestroy(fileHeader);
+	return bestSize;
+}
+
+/** Load the images of a single cursor file
+ *
+ * The returned object is named after `name` and must be destroyed with
+ * XcursorImagesDestroy().
+ */
+XcursorImages *
+xcursor_file_load_images(const char *path, const char *name, int size)
+{
+	FILE *f;
+	XcursorImages *images;
+
+	if (!path)
+		return NULL;
+
+	f = fopen(path, "r");
+	if (!f)
+		return NULL;
+
+	images = XcursorFileLoadImages(f, size);
+	if (images)
+		XcursorImagesSetName(images, name);
+
+	fclose(f);
+	return images;
+}
@@ -10,6 +10,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/socket.h>
 #include <sys/types.h>
 #include <sys/wait.h>
@@ -31,7 +32,7 @@ static inline int clearenv(void) {
 #endif
 
 struct wlr_xwayland_cursor {
-	uint8_t *pixels;
+	uint8_t *pixels; // owned, the caller's buffer may not outlive the call
 	uint32_t stride;
 	uint32_t width;
 	uint32_t height;
@@ -39,6 +40,14 @@ struct wlr_xwayland_cursor {
 	int32_t hotspot_y;
 };
 
+static void xwayland_cursor_destroy(struct wlr_xwayland_cursor *cursor) {
+	if (cursor == NULL) {
+		return;
+	}
+	free(cursor->pixels);
+	free(cursor);
+}
+
 static void safe_close(int fd) {
 	if (fd >= 0) {
 		close(fd);
@@ -126,61 +135,95 @@ static void exec_xwayland(struct wlr_xwayland *wlr_xwayland) {
 	execvp("Xwayland", argv);
 }
 
-static void wlr_xwayland_finish(struct wlr_xwayland *wlr_xwayland) {
+/**
+ * Tears down the running Xwayland server, if any. The X11 display sockets are
+ * kept so that the server can be started again on the same display.
+ */
+static void xwayland_finish_server(struct wlr_xwayland *wlr_xwayland) {
 	if (!wlr_xwayland || wlr_xwayland->display == -1) {
 		return;
 	}
 
-	if (wlr_xwayland->cursor != NULL) {
-		free(wlr_xwayland->cursor);
-	}
-
 	xwm_destroy(wlr_xwayland->xwm);
+	wlr_xwayland->xwm = NULL;
 
 	if (wlr_xwayland->client) {
 		wl_list_remove(&wlr_xwayland->client_destroy.link);
 		wl_client_destroy(wlr_xwayland->client);
+		wlr_xwayland->client = NULL;
 	}
 	if (wlr_xwayland->sigusr1_source) {
 		wl_event_source_remove(wlr_xwayland->sigusr1_source);
+		wlr_xwayland->sigusr1_source = NULL;
 	}
 
-	safe_close(wlr_xwayland->x_fd[0]);
-	safe_close(wlr_xwayland->x_fd[1]);
 	safe_close(wlr_xwayland->wl_fd[0]);
 	safe_close(wlr_xwayland->wl_fd[1]);
 	safe_close(wlr_xwayland->wm_fd[0]);
 	safe_close(wlr_xwayland->wm_fd[1]);
+	wlr_xwayland->wl_fd[0] = wlr_xwayland->wl_fd[1] = -1;
+	wlr_xwayland->wm_fd[0] = wlr_xwayland->wm_fd[1] = -1;
+
+	/* We do not kill the Xwayland process, it dies to broken pipe
+	 * after we close our side of the wm/wl fds. This is more reliable
+	 * than trying to kill something that might no longer be Xwayland.
+	 */
+}
+
+static void wlr_xwayland_finish(struct wlr_xwayland *wlr_xwayland) {
+	if (!wlr_xwayland || wlr_xwayland->display == -1) {
+		return;
+	}
+
+	xwayland_finish_server(wlr_xwayland);
+
+	for (size_t i = 0; i < 2; ++i) {
+		if (wlr_xwayland->x_fd_read_event[i]) {
+			wl_event_source_remove(wlr_xwayland->x_fd_read_event[i]);
+			wlr_xwayland->x_fd_read_event[i] = NULL;
+		}
+		safe_close(wlr_xwayland->x_fd[i]);
+		wlr_xwayland->x_fd[i] = -1;
+	}
+
+	xwayland_cursor_destroy(wlr_xwayland->cursor);
+	wlr_xwayland->cursor = NULL;
 
 	wl_list_remove(&wlr_xwayland->display_destroy.link);
 
 	unlink_display_sockets(wlr_xwayland->display);
 	wlr_xwayland->display = -1;
 	unsetenv("DISPLAY");
-	/* We do not kill the Xwayland process, it dies to broken pipe
-	 * after we close our side of the wm/wl fds. This is more reliable
-	 * than trying to kill something that might no longer be Xwayland.
-	 */
 }
 
-static bool wlr_xwayland_start(struct wlr_xwayland *wlr_xwayland,
-	struct wl_display *wl_display, struct wlr_compositor *compositor);
+static bool xwayland_start_server(struct wlr_xwayland *wlr_xwayland);
+static bool xwayland_start_server_lazy(struct wlr_xwayland *wlr_xwayland);
 
 static void handle_client_destroy(struct wl_listener *listener, void *data) {
 	struct wlr_xwayland *wlr_xwayland =
 		wl_container_of(listener, wlr_xwayland, client_destroy);
+	bool was_ready = wlr_xwayland->xwm != NULL;
 
 	// Don't call client destroy: it's being destroyed already
 	wlr_xwayland->client = NULL;
 	wl_list_remove(&wlr_xwayland->client_destroy.link);
 
-	wlr_xwayland_finish(wlr_xwayland);
+	xwayland_finish_server(wlr_xwayland);
 
-	if (time(NULL) - wlr_xwayland->server_start > 5) {
+	// Xwayland exits on its own once the last X11 client is gone
+	bool restart = time(NULL) - wlr_xwayland->server_start > 5;
+	if (wlr_xwayland->lazy && (was_ready || restart)) {
+		wlr_log(L_INFO, "Xwayland exited, waiting for X11 clients");
+		if (xwayland_start_server_lazy(wlr_xwayland)) {
+			return;
+		}
+	} else if (restart) {
 		wlr_log(L_INFO, "Restarting Xwayland");
-		wlr_xwayland_start(wlr_xwayland, wlr_xwayland->wl_display,
-			wlr_xwayland->compositor);
+		if (xwayland_start_server(wlr_xwayland)) {
+			return;
+		}
 	}
+	wlr_xwayland_finish(wlr_xwayland);
 }
 
 static void handle_display_destroy(struct wl_listener *listener, void *data) {
@@ -226,12 +269,11 @@ static int xserver_handle_ready(int signal_number, void *data) {
 	wl_event_source_remove(wlr_xwayland->sigusr1_source);
 	wlr_xwayland->sigusr1_source = NULL;
 
+	// Keep the cursor around, the server may be started again later
 	if (wlr_xwayland->cursor != NULL) {
 		struct wlr_xwayland_cursor *cur = wlr_xwayland->cursor;
 		xwm_set_cursor(wlr_xwayland->xwm, cur->pixels, cur->stride, cur->width,
 			cur->height, cur->hotspot_x, cur->hotspot_y);
-		free(cur);
-		wlr_xwayland->cursor = NULL;
 	}
 
 	char display_name[16];
@@ -245,40 +287,28 @@ static int xserver_handle_ready(int signal_number, void *data) {
 	return 1; /* wayland event loop dispatcher's count */
 }
 
-static bool wlr_xwayland_start(struct wlr_xwayland *wlr_xwayland,
-		struct wl_display *wl_display, struct wlr_compositor *compositor) {
-	memset(wlr_xwayland, 0, offsetof(struct wlr_xwayland, seat));
-	wlr_xwayland->wl_display = wl_display;
-	wlr_xwayland->compositor = compositor;
-	wlr_xwayland->x_fd[0] = wlr_xwayland->x_fd[1] = -1;
-	wlr_xwayland->wl_fd[0] = wlr_xwayland->wl_fd[1] = -1;
-	wlr_xwayland->wm_fd[0] = wlr_xwayland->wm_fd[1] = -1;
-
-	wlr_xwayland->display_destroy.notify = handle_display_destroy;
-	wl_display_add_destroy_listener(wl_display, &wlr_xwayland->display_destroy);
-
-	wlr_xwayland->display = open_display_sockets(wlr_xwayland->x_fd);
-	if (wlr_xwayland->display < 0) {
-		wlr_xwayland_finish(wlr_xwayland);
-		return false;
-	}
+static bool xwayland_start_server(struct wlr_xwayland *wlr_xwayland) {
 	if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, wlr_xwayland->wl_fd) != 0 ||
 			socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, wlr_xwayland->wm_fd) != 0) {
 		wlr_log_errno(L_ERROR, "failed to create socketpair");
-		wlr_xwayland_finish(wlr_xwayland);
+		xwayland_finish_server(wlr_xwayland);
 		return false;
 	}
 
 	wlr_xwayland->server_start = time(NULL);
 
-	if (!(wlr_xwayland->client = wl_client_create(wl_display, wlr_xwayland->wl_fd[0]))) {
+	if (!(wlr_xwayland->client = wl_client_create(wlr_xwayland->wl_display,
+			wlr_xwayland->wl_fd[0]))) {
 		wlr_log_errno(L_ERROR, "wl_client_create failed");
-		wlr_xwayland_finish(wlr_xwayland);
+		xwayland_finish_server(wlr_xwayland);
 		return false;
 	}
 
-	// unset $DISPLAY while XWayland starts
-	unsetenv("DISPLAY");
+	// unset $DISPLAY while XWayland starts, unless clients are already
+	// connecting to it
+	if (!wlr_xwayland->lazy) {
+		unsetenv("DISPLAY");
+	}
 
 	wlr_xwayland->wl_fd[0] = -1; /* not ours anymore */
 
@@ -286,7 +316,8 @@ static bool wlr_xwayland_start(struct wlr_xwayland *wlr_xwayland,
 	wl_client_add_destroy_listener(wlr_xwayland->client,
 		&wlr_xwayland->client_destroy);
 
-	struct wl_event_loop *loop = wl_display_get_event_loop(wl_display);
+	struct wl_event_loop *loop =
+		wl_display_get_event_loop(wlr_xwayland->wl_display);
 	wlr_xwayland->sigusr1_source = wl_event_loop_add_signal(loop, SIGUSR1,
 		xserver_handle_ready, wlr_xwayland);
 
@@ -321,21 +352,85 @@ static bool wlr_xwayland_start(struct wlr_xwayland *wlr_xwayland,
 	}
 	if (wlr_xwayland->pid < 0) {
 		wlr_log_errno(L_ERROR, "fork failed");
-		wlr_xwayland_finish(wlr_xwayland);
+		xwayland_finish_server(wlr_xwayland);
 		return false;
 	}
 
-	/* close child fds */
-	close(wlr_xwayland->x_fd[0]);
-	close(wlr_xwayland->x_fd[1]);
+	/* close child fds, the X11 sockets are kept to restart the server on the
+	 * same display */
 	close(wlr_xwayland->wl_fd[1]);
 	close(wlr_xwayland->wm_fd[1]);
-	wlr_xwayland->x_fd[0] = wlr_xwayland->x_fd[1] = -1;
 	wlr_xwayland->wl_fd[1] = wlr_xwayland->wm_fd[1] = -1;
 
 	return true;
 }
 
+static int xwayland_handle_socket_connect(int fd, uint32_t mask, void *data) {
+	struct wlr_xwayland *wlr_xwayland = data;
+
+	// Xwayland accepts the pending connection once it is up
+	for (size_t i = 0; i < 2; ++i) {
+		wl_event_source_remove(wlr_xwayland->x_fd_read_event[i]);
+		wlr_xwayland->x_fd_read_event[i] = NULL;
+	}
+
+	wlr_log(L_DEBUG, "X11 client connected, starting Xwayland");
+	if (!xwayland_start_server(wlr_xwayland)) {
+		wlr_xwayland_finish(wlr_xwayland);
+	}
+	return 0;
+}
+
+/**
+ * Waits for an X11 client to connect to the display sockets before starting
+ * the server.
+ */
+static bool xwayland_start_server_lazy(struct wlr_xwayland *wlr_xwayland) {
+	struct wl_event_loop *loop =
+		wl_display_get_event_loop(wlr_xwayland->wl_display);
+	for (size_t i = 0; i < 2; ++i) {
+		wlr_xwayland->x_fd_read_event[i] = wl_event_loop_add_fd(loop,
+			wlr_xwayland->x_fd[i], WL_EVENT_READABLE,
+			xwayland_handle_socket_connect, wlr_xwayland);
+		if (!wlr_xwayland->x_fd_read_event[i]) {
+			wlr_log(L_ERROR, "Failed to listen on X11 socket");
+			return false;
+		}
+	}
+
+	char display_name[16];
+	snprintf(display_name, sizeof(display_name), ":%d", wlr_xwayland->display);
+	setenv("DISPLAY", display_name, true);
+
+	return true;
+}
+
+static bool wlr_xwayland_start(struct wlr_xwayland *wlr_xwayland,
+		struct wl_display *wl_display, struct wlr_compositor *compositor) {
+	wlr_xwayland->wl_display = wl_display;
+	wlr_xwayland->compositor = compositor;
+	wlr_xwayland->x_fd[0] = wlr_xwayland->x_fd[1] = -1;
+	wlr_xwayland->wl_fd[0] = wlr_xwayland->wl_fd[1] = -1;
+	wlr_xwayland->wm_fd[0] = wlr_xwayland->wm_fd[1] = -1;
+
+	wlr_xwayland->display_destroy.notify = handle_display_destroy;
+	wl_display_add_destroy_listener(wl_display, &wlr_xwayland->display_destroy);
+
+	wlr_xwayland->display = open_display_sockets(wlr_xwayland->x_fd);
+	if (wlr_xwayland->display < 0) {
+		wl_list_remove(&wlr_xwayland->display_destroy.link);
+		return false;
+	}
+
+	bool ok = wlr_xwayland->lazy ? xwayland_start_server_lazy(wlr_xwayland) :
+		xwayland_start_server(wlr_xwayland);
+	if (!ok) {
+		wlr_xwayland_finish(wlr_xwayland);
+		return false;
+	}
+	return true;
+}
+
 void wlr_xwayland_destroy(struct wlr_xwayland *wlr_xwayland) {
 	wlr_xwayland_set_seat(wlr_xwayland, NULL);
 	wlr_xwayland_finish(wlr_xwayland);
@@ -343,9 +438,13 @@ void wlr_xwayland_destroy(struct wlr_xwayland *wlr_xwayland) {
 }
 
 struct wlr_xwayland *wlr_xwayland_create(struct wl_display *wl_display,
-		struct wlr_compositor *compositor) {
+		struct wlr_compositor *compositor, bool lazy) {
 	struct wlr_xwayland *wlr_xwayland = calloc(1, sizeof(struct wlr_xwayland));
+	if (wlr_xwayland == NULL) {
+		return NULL;
+	}
 
+	wlr_xwayland->lazy = lazy;
 	wl_signal_init(&wlr_xwayland->events.new_surface);
 	wl_signal_init(&wlr_xwayland->events.ready);
 	if (wlr_xwayland_start(wlr_xwayland, wl_display, compositor)) {
@@ -361,21 +460,32 @@ void wlr_xwayland_set_cursor(struct wlr_xwayland *wlr_xwayland,
 	if (wlr_xwayland->xwm != NULL) {
 		xwm_set_cursor(wlr_xwayland->xwm, pixels, stride, width, height,
 			hotspot_x, hotspot_y);
-		return;
 	}
 
-	free(wlr_xwayland->cursor);
+	xwayland_cursor_destroy(wlr_xwayland->cursor);
+	wlr_xwayland->cursor = NULL;
 
-	wlr_xwayland->cursor = calloc(1, sizeof(struct wlr_xwayland_cursor));
-	if (wlr_xwayland->cursor == NULL) {
+	struct wlr_xwayland_cursor *cursor =
+		calloc(1, sizeof(struct wlr_xwayland_cursor));
+	if (cursor == NULL) {
+		wlr_log(L_ERROR, "Allocation failed");
+		return;
+	}
+	// The stride is in pixels
+	size_t size = (size_t)stride * height * 4;
+	cursor->pixels = malloc(size);
+	if (cursor->pixels == NULL) {
+		wlr_log(L_ERROR, "Allocation failed");
+		free(cursor);
 		return;
 	}
-	wlr_xwayland->cursor->pixels = pixels;
-	wlr_xwayland->cursor->stride = stride;
-	wlr_xwayland->cursor->width = width;
-	wlr_xwayland->cursor->height = height;
-	wlr_xwayland->cursor->hotspot_x = hotspot_x;
-	wlr_xwayland->cursor->hotspot_y = hotspot_y;
+	memcpy(cursor->pixels, pixels, size);
+	cursor->stride = stride;
+	cursor->width = width;
+	cursor->height = height;
+	cursor->hotspot_x = hotspot_x;
+	cursor->hotspot_y = hotspot_y;
+	wlr_xwayland->cursor = cursor;
 }
 
 static void wlr_xwayland_handle_seat_destroy(struct wl_listener *listener,
@@ -56,19 +56,123 @@ const char *atom_map[ATOM_LAST] = {
 	"TIMESTAMP",
 };
 
-/* General helpers */
-// TODO: replace this with hash table?
-static struct wlr_xwayland_surface *lookup_surface(struct wlr_xwm *xwm,
-		xcb_window_t window_id) {
-	struct wlr_xwayland_surface *surface;
-	wl_list_for_each(surface, &xwm->surfaces, link) {
-		if (surface->window_id == window_id) {
-			return surface;
+/* Surface tables */
+#define SURFACE_TABLE_MIN_LEN 64
+
+static bool surface_table_init(struct wlr_xwm_surface_table *table,
+		bool by_surface_id) {
+	table->buckets = calloc(SURFACE_TABLE_MIN_LEN, sizeof(struct wl_list));
+	if (table->buckets == NULL) {
+		return false;
+	}
+	table->len = SURFACE_TABLE_MIN_LEN;
+	table->count = 0;
+	table->by_surface_id = by_surface_id;
+	for (size_t i = 0; i < table->len; ++i) {
+		wl_list_init(&table->buckets[i]);
+	}
+	return true;
+}
+
+static void surface_table_finish(struct wlr_xwm_surface_table *table) {
+	free(table->buckets);
+	table->buckets = NULL;
+}
+
+static struct wl_list *surface_table_link(struct wlr_xwm_surface_table *table,
+		struct wlr_xwayland_surface *xsurface) {
+	return table->by_surface_id ?
+		&xsurface->unpaired_link : &xsurface->window_link;
+}
+
+static struct wlr_xwayland_surface *surface_table_from_link(
+		struct wlr_xwm_surface_table *table, struct wl_list *link) {
+	struct wlr_xwayland_surface *xsurface;
+	if (table->by_surface_id) {
+		return wl_container_of(link, xsurface, unpaired_link);
+	}
+	return wl_container_of(link, xsurface, window_link);
+}
+
+static uint32_t surface_table_key(struct wlr_xwm_surface_table *table,
+		struct wlr_xwayland_surface *xsurface) {
+	return table->by_surface_id ? xsurface->surface_id : xsurface->window_id;
+}
+
+static struct wl_list *surface_table_bucket(
+		struct wlr_xwm_surface_table *table, uint32_t key) {
+	// X11 resource IDs and Wayland object IDs are allocated sequentially, so
+	// the low bits are already well distributed: scramble them a little
+	key *= 2654435761u;
+	return &table->buckets[(key ^ (key >> 16)) & (table->len - 1)];
+}
+
+static void surface_table_grow(struct wlr_xwm_surface_table *table) {
+	size_t len = table->len * 2;
+	struct wl_list *buckets = calloc(len, sizeof(struct wl_list));
+	if (buckets == NULL) {
+		// Keep using the current buckets, lookups are only slower
+		wlr_log(L_ERROR, "Allocation failed");
+		return;
+	}
+	for (size_t i = 0; i < len; ++i) {
+		wl_list_init(&buckets[i]);
+	}
+
+	struct wl_list *old_buckets = table->buckets;
+	size_t old_len = table->len;
+	table->buckets = buckets;
+	table->len = len;
+	for (size_t i = 0; i < old_len; ++i) {
+		while (!wl_list_empty(&old_buckets[i])) {
+			struct wl_list *link = old_buckets[i].next;
+			struct wlr_xwayland_surface *xsurface =
+				surface_table_from_link(table, link);
+			wl_list_remove(link);
+			wl_list_insert(surface_table_bucket(table,
+				surface_table_key(table, xsurface)), link);
+		}
+	}
+	free(old_buckets);
+}
+
+static void surface_table_insert(struct wlr_xwm_surface_table *table,
+		struct wlr_xwayland_surface *xsurface) {
+	if (table->count >= table->len) {
+		surface_table_grow(table);
+	}
+	wl_list_insert(surface_table_bucket(table,
+		surface_table_key(table, xsurface)),
+		surface_table_link(table, xsurface));
+	++table->count;
+}
+
+static void surface_table_remove(struct wlr_xwm_surface_table *table,
+		struct wlr_xwayland_surface *xsurface) {
+	wl_list_remove(surface_table_link(table, xsurface));
+	--table->count;
+}
+
+static struct wlr_xwayland_surface *surface_table_lookup(
+		struct wlr_xwm_surface_table *table, uint32_t key) {
+	struct wl_list *bucket = surface_table_bucket(table, key);
+	struct wl_list *link;
+	for (link = bucket->next; link != bucket; link = link->next) {
+		struct wlr_xwayland_surface *xsurface =
+			surface_table_from_link(table, link);
+		if (surface_table_key(table, xsurface) == key) {
+			return xsurface;
 		}
 	}
 	return NULL;
 }
 
+/* General helpers */
+static struct wlr_xwayland_surface *lookup_surface(struct wlr_xwm *xwm,
+		xcb_window_t window_id) {
+	return surface_table_lookup(&xwm->windows, window_id);
+}
+
 static struct wlr_xwayland_surface *wlr_xwayland_surface_create(
 		struct wlr_xwm *xwm, xcb_window_t window_id, int16_t x, int16_t y,
 		uint16_t width, uint16_t height, bool override_redirect) {
@@ -97,6 +201,7 @@ static struct wlr_xwayland_surface *wlr_xwayland_surface_create(
 	surface->height = height;
 	surface->override_redirect = override_redirect;
 	wl_list_insert(&xwm->surfaces, &surface->link);
+	surface_table_insert(&xwm->windows, surface);
 	wl_list_init(&surface->children);
 	wl_list_init(&surface->parent_link);
 	wl_signal_init(&surface->events.destroy);
@@ -218,10 +323,11 @@ static void wlr_xwayland_surface_destroy(
 	}
 
 	wl_list_remove(&xsurface->link);
+	surface_table_remove(&xsurface->xwm->windows, xsurface);
 	wl_list_remove(&xsurface->parent_link);
 
 	if (xsurface->surface_id) {
-		wl_list_remove(&xsurface->unpaired_link);
+		surface_table_remove(&xsurface->xwm->unpaired_surfaces, xsurface);
 	}
 
 	if (xsurface->surface) {
@@ -492,15 +598,8 @@ static void read_surface_net_wm_state(struct wlr_xwm *xwm,
 }
 
 static void read_surface_property(struct wlr_xwm *xwm,
-		struct wlr_xwayland_surface *xsurface, xcb_atom_t property) {
-	xcb_get_property_cookie_t cookie = xcb_get_property(xwm->xcb_conn, 0,
-		xsurface->window_id, property, XCB_ATOM_ANY, 0, 2048);
-	xcb_get_property_reply_t *reply = xcb_get_property_reply(xwm->xcb_conn,
-		cookie, NULL);
-	if (reply == NULL) {
-		return;
-	}
-
+		struct wlr_xwayland_surface *xsurface, xcb_atom_t property,
+		xcb_get_property_reply_t *reply) {
 	if (property == XCB_ATOM_WM_CLASS) {
 		read_surface_class(xwm, xsurface, reply);
 	} else if (property == XCB_ATOM_WM_NAME ||
@@ -525,8 +624,68 @@ static void read_surface_property(struct wlr_xwm *xwm,
 	} else {
 		wlr_log(L_DEBUG, "unhandled x11 property %u", property);
 	}
+}
 
-	free(reply);
+/**
+ * Returns the index of a property read by the window manager, or -1 if its
+ * changes are ignored.
+ */
+static int surface_property_index(struct wlr_xwm *xwm, xcb_atom_t atom) {
+	const xcb_atom_t properties[] = {
+		XCB_ATOM_WM_CLASS,
+		XCB_ATOM_WM_NAME,
+		XCB_ATOM_WM_TRANSIENT_FOR,
+		xwm->atoms[WM_PROTOCOLS],
+		xwm->atoms[WM_HINTS],
+		xwm->atoms[WM_NORMAL_HINTS],
+		xwm->atoms[MOTIF_WM_HINTS],
+		xwm->atoms[NET_WM_STATE],
+		xwm->atoms[NET_WM_WINDOW_TYPE],
+		xwm->atoms[NET_WM_NAME],
+		xwm->atoms[NET_WM_PID],
+	};
+	const size_t len = sizeof(properties) / sizeof(properties[0]);
+	for (size_t i = 0; i < len; ++i) {
+		if (properties[i] == atom) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+struct property_request {
+	xcb_window_t window;
+	xcb_atom_t atom;
+	xcb_get_property_cookie_t cookie;
+};
+
+/**
+ * Fetches and reads several properties, possibly of different windows, with a
+ * single round-trip to the X server.
+ */
+static void read_surface_properties(struct wlr_xwm *xwm,
+		struct property_request *requests, size_t len) {
+	for (size_t i = 0; i < len; ++i) {
+		requests[i].cookie = xcb_get_property(xwm->xcb_conn, 0,
+			requests[i].window, requests[i].atom, XCB_ATOM_ANY, 0, 2048);
+	}
+
+	for (size_t i = 0; i < len; ++i) {
+		xcb_get_property_reply_t *reply = xcb_get_property_reply(xwm->xcb_conn,
+			requests[i].cookie, NULL);
+		if (reply == NULL) {
+			continue;
+		}
+
+		// Reading a property may emit signals, make sure the window is still
+		// there
+		struct wlr_xwayland_surface *xsurface =
+			lookup_surface(xwm, requests[i].window);
+		if (xsurface != NULL) {
+			read_surface_property(xwm, xsurface, requests[i].atom, reply);
+		}
+		free(reply);
+	}
 }
 
 static void handle_surface_commit(struct wlr_surface *wlr_surface,
@@ -555,22 +714,24 @@ static void xwm_map_shell_surface(struct wlr_xwm *xwm,
 	xsurface->surface = surface;
 
 	// read all surface properties
-	const xcb_atom_t props[] = {
-		XCB_ATOM_WM_CLASS,
-		XCB_ATOM_WM_NAME,
-		XCB_ATOM_WM_TRANSIENT_FOR,
-		xwm->atoms[WM_PROTOCOLS],
-		xwm->atoms[WM_HINTS],
-		xwm->atoms[WM_NORMAL_HINTS],
-		xwm->atoms[MOTIF_WM_HINTS],
-		xwm->atoms[NET_WM_STATE],
-		xwm->atoms[NET_WM_WINDOW_TYPE],
-		xwm->atoms[NET_WM_NAME],
-		xwm->atoms[NET_WM_PID],
+	struct property_request requests[] = {
+		{ .atom = XCB_ATOM_WM_CLASS },
+		{ .atom = XCB_ATOM_WM_NAME },
+		{ .atom = XCB_ATOM_WM_TRANSIENT_FOR },
+		{ .atom = xwm->atoms[WM_PROTOCOLS] },
+		{ .atom = xwm->atoms[WM_HINTS] },
+		{ .atom = xwm->atoms[WM_NORMAL_HINTS] },
+		{ .atom = xwm->atoms[MOTIF_WM_HINTS] },
+		{ .atom = xwm->atoms[NET_WM_STATE] },
+		{ .atom = xwm->atoms[NET_WM_WINDOW_TYPE] },
+		{ .atom = xwm->atoms[NET_WM_NAME] },
+		{ .atom = xwm->atoms[NET_WM_PID] },
 	};
-	for (size_t i = 0; i < sizeof(props)/sizeof(xcb_atom_t); i++) {
-		read_surface_property(xwm, xsurface, props[i]);
+	const size_t len = sizeof(requests) / sizeof(requests[0]);
+	for (size_t i = 0; i < len; i++) {
+		requests[i].window = xsurface->window_id;
 	}
+	read_surface_properties(xwm, requests, len);
 
 	wlr_surface_set_role_committed(xsurface->surface, handle_surface_commit,
 		xsurface);
@@ -699,7 +860,7 @@ static void xwm_handle_unmap_notify(struct wlr_xwm *xwm,
 		// Make sure we're not on the unpaired surface list or we
 		// could be assigned a surface during surface creation that
 		// was mapped before this unmap request.
-		wl_list_remove(&xsurface->unpaired_link);
+		surface_table_remove(&xwm->unpaired_surfaces, xsurface);
 		xsurface->surface_id = 0;
 	}
 
@@ -725,7 +886,44 @@ static void xwm_handle_property_notify(struct wlr_xwm *xwm,
 		return;
 	}
 
-	read_surface_property(xwm, xsurface, ev->atom);
+	int index = surface_property_index(xwm, ev->atom);
+	if (index < 0) {
+		wlr_log(L_DEBUG, "unhandled x11 property %u", ev->atom);
+		return;
+	}
+
+	// Properties are read once all pending events have been handled, so that
+	// repeated changes only cost one request
+	uint32_t bit = UINT32_C(1) << index;
+	if (xsurface->pending_properties & bit) {
+		return;
+	}
+	struct property_request *request = wl_array_add(&xwm->pending_properties,
+		sizeof(struct property_request));
+	if (request == NULL) {
+		wlr_log(L_ERROR, "Allocation failed");
+		return;
+	}
+	request->window = ev->window;
+	request->atom = ev->atom;
+	xsurface->pending_properties |= bit;
+}
+
+static void xwm_flush_pending_properties(struct wlr_xwm *xwm) {
+	struct property_request *requests = xwm->pending_properties.data;
+	size_t len = xwm->pending_properties.size /
+		sizeof(struct property_request);
+	// Changes notified from now on need to be read again
+	for (size_t i = 0; i < len; ++i) {
+		struct wlr_xwayland_surface *xsurface =
+			lookup_surface(xwm, requests[i].window);
+		if (xsurface != NULL) {
+			xsurface->pending_properties = 0;
+		}
+	}
+
+	read_surface_properties(xwm, requests, len);
+	xwm->pending_properties.size = 0;
 }
 
 static void xwm_handle_surface_id_message(struct wlr_xwm *xwm,
@@ -737,17 +935,21 @@ static void xwm_handle_surface_id_message(struct wlr_xwm *xwm,
 			ev->window);
 		return;
 	}
+	if (xsurface->surface_id) {
+		surface_table_remove(&xwm->unpaired_surfaces, xsurface);
+		xsurface->surface_id = 0;
+	}
+
 	/* Check if we got notified after wayland surface create event */
 	uint32_t id = ev->data.data32[0];
 	struct wl_resource *resource =
 		wl_client_get_object(xwm->xwayland->client, id);
 	if (resource) {
 		struct wlr_surface *surface = wlr_surface_from_resource(resource);
-		xsurface->surface_id = 0;
 		xwm_map_shell_surface(xwm, xsurface, surface);
 	} else {
 		xsurface->surface_id = id;
-		wl_list_insert(&xwm->unpaired_surfaces, &xsurface->unpaired_link);
+		surface_table_insert(&xwm->unpaired_surfaces, xsurface);
 	}
 }
 
@@ -957,7 +1159,16 @@ static int x11_event_handler(int fd, uint32_t mask, void *data) {
 	xcb_generic_event_t *event;
 	struct wlr_xwm *xwm = data;
 
-	while ((event = xcb_poll_for_event(xwm->xcb_conn))) {
+	while (true) {
+		if (!(event = xcb_poll_for_event(xwm->xcb_conn))) {
+			if (xwm->pending_properties.size == 0) {
+				break;
+			}
+			// xcb may queue new events while waiting for the replies, they
+			// need to be handled before returning
+			xwm_flush_pending_properties(xwm);
+			continue;
+		}
 		count++;
 
 		if (xwm->xwayland->user_event_handler &&
@@ -1012,6 +1223,9 @@ static int x11_event_handler(int fd, uint32_t mask, void *data) {
 		free(event);
 	}
 
+	// Left over if the user event handler interrupted the loop
+	xwm_flush_pending_properties(xwm);
+
 	if (count) {
 		xcb_flush(xwm->xcb_conn);
 	}
@@ -1031,15 +1245,13 @@ static void handle_compositor_new_surface(struct wl_listener *listener,
 	wlr_log(L_DEBUG, "New xwayland surface: %p", surface);
 
 	uint32_t surface_id = wl_resource_get_id(surface->resource);
-	struct wlr_xwayland_surface *xsurface;
-	wl_list_for_each(xsurface, &xwm->unpaired_surfaces, unpaired_link) {
-		if (xsurface->surface_id == surface_id) {
-			xwm_map_shell_surface(xwm, xsurface, surface);
-			xsurface->surface_id = 0;
-			wl_list_remove(&xsurface->unpaired_link);
-			xcb_flush(xwm->xcb_conn);
-			return;
-		}
+	struct wlr_xwayland_surface *xsurface =
+		surface_table_lookup(&xwm->unpaired_surfaces, surface_id);
+	if (xsurface != NULL) {
+		surface_table_remove(&xwm->unpaired_surfaces, xsurface);
+		xsurface->surface_id = 0;
+		xwm_map_shell_surface(xwm, xsurface, surface);
+		xcb_flush(xwm->xcb_conn);
 	}
 }
 
@@ -1131,9 +1343,9 @@ void xwm_destroy(struct wlr_xwm *xwm) {
 	wl_list_for_each_safe(xsurface, tmp, &xwm->surfaces, link) {
 		wlr_xwayland_surface_destroy(xsurface);
 	}
-	wl_list_for_each_safe(xsurface, tmp, &xwm->unpaired_surfaces, link) {
-		wlr_xwayland_surface_destroy(xsurface);
-	}
+	surface_table_finish(&xwm->windows);
+	surface_table_finish(&xwm->unpaired_surfaces);
+	wl_array_release(&xwm->pending_properties);
 	wl_list_remove(&xwm->compositor_new_surface.link);
 	wl_list_remove(&xwm->compositor_destroy.link);
 	xcb_disconnect(xwm->xcb_conn);
@@ -1351,7 +1563,14 @@ struct wlr_xwm *xwm_create(struct wlr_xwayland *wlr_xwayland) {
 
 	xwm->xwayland = wlr_xwayland;
 	wl_list_init(&xwm->surfaces);
-	wl_list_init(&xwm->unpaired_surfaces);
+	wl_array_init(&xwm->pending_properties);
+	if (!surface_table_init(&xwm->windows, false) ||
+			!surface_table_init(&xwm->unpaired_surfaces, true)) {
+		wlr_log(L_ERROR, "Allocation failed");
+		surface_table_finish(&xwm->windows);
+		free(xwm);
+		return NULL;
+	}
 
 	xwm->xcb_conn = xcb_connect_to_fd(wlr_xwayland->wm_fd[0], NULL);
 
@@ -1359,6 +1578,8 @@ struct wlr_xwm *xwm_create(struct wlr_xwayland *wlr_xwayland) {
 	if (rc) {
 		wlr_log(L_ERROR, "xcb connect failed: %d", rc);
 		close(wlr_xwayland->wm_fd[0]);
+		surface_table_finish(&xwm->windows);
+		surface_table_finish(&xwm->unpaired_surfaces);
 		free(xwm);
 		return NULL;
 	}